@@ -0,0 +1,167 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <array>
+#include <filesystem>
+#include <limits>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <fcntl.h>
+#ifndef _WIN32
+#include <unistd.h>
+#else
+#include <io.h>
+#include <sys/stat.h>
+#endif
+
+// =======================================================
+// Shared by the on-disk formats (LocalCharacterStore, ProgressJournal,
+// SessionSnapshot) and the signed session tokens: CRC-32, little helpers to
+// append/read plain values and length-prefixed strings, write + sync and
+// whole-file replacement.
+// Values are written in host byte order; the files never leave the machine.
+// =======================================================
+
+// CRC-32 (IEEE); pass the previous result as `crc` to continue over more data
+inline uint32_t Crc32(uint32_t crc, const void* data, size_t len)
+{
+    static const auto table = []{
+        std::array<uint32_t, 256> t{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[i] = c;
+        }
+        return t;
+    }();
+
+    crc ^= 0xFFFFFFFFu;
+    const auto* p = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < len; ++i) crc = table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFFu;
+}
+
+inline uint32_t Crc32(const void* data, size_t len) { return Crc32(0, data, len); }
+
+template <typename T>
+void PutPod(std::string& out, T v) { out.append(reinterpret_cast<const char*>(&v), sizeof(v)); }
+
+// Len-prefixed; longer strings are cut to what Len can count
+template <typename Len = uint32_t>
+void PutString(std::string& out, const std::string& s)
+{
+    const Len n = static_cast<Len>(std::min<size_t>(s.size(), std::numeric_limits<Len>::max()));
+    PutPod<Len>(out, n);
+    out.append(s, 0, n);
+}
+
+// bounds-checked reader; ok() turns false on the first overrun
+class BinaryReader
+{
+public:
+    BinaryReader(const char* p, size_t n) : p_(p), end_(p + n) {}
+
+    template <typename T>
+    T Get()
+    {
+        T v{};
+        if (static_cast<size_t>(end_ - p_) < sizeof(T)) { ok_ = false; return v; }
+        std::memcpy(&v, p_, sizeof(T));
+        p_ += sizeof(T);
+        return v;
+    }
+
+    template <typename Len = uint32_t>
+    std::string GetString()
+    {
+        const Len n = Get<Len>();
+        if (!ok_ || static_cast<size_t>(end_ - p_) < n) { ok_ = false; return {}; }
+        std::string s(p_, n);
+        p_ += n;
+        return s;
+    }
+
+    bool ok() const { return ok_; }
+    bool done() const { return p_ == end_; }
+
+private:
+    const char* p_;
+    const char* end_;
+    bool ok_ = true;
+};
+
+// write() until everything is out; false on any error
+inline bool WriteAll(int fd, const void* data, size_t len)
+{
+    if (fd < 0) return false;
+    const char* p = static_cast<const char*>(data);
+    while (len > 0)
+    {
+        const auto n = ::write(fd, p, static_cast<unsigned>(std::min<size_t>(len, 1u << 20)));
+        if (n <= 0) return false;
+        p += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// data (and the size needed to read it back) on disk
+inline bool SyncFd(int fd)
+{
+#if defined(_WIN32)
+    return ::_commit(fd) == 0;
+#elif defined(__linux__)
+    return ::fdatasync(fd) == 0;
+#else
+    return ::fsync(fd) == 0;
+#endif
+}
+
+// Replaces `path` with `data` so that a crash leaves either the old or the new
+// content: write <path>.tmp, sync it, rename it over `path`, sync the directory
+// (the rename itself is only durable then). False: `path` is untouched.
+// `mode` is the POSIX permission of a newly created file.
+inline bool ReplaceFileDurably(const std::string& path, std::string_view data,
+                               std::string* err = nullptr, int mode = 0644)
+{
+    const std::string tmpPath = path + ".tmp";
+#ifndef _WIN32
+    const int fd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, mode);
+#else
+    (void)mode;
+    const int fd = ::_open(tmpPath.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#endif
+    if (fd < 0) {
+        if (err) *err = "Cannot create " + tmpPath;
+        return false;
+    }
+    const bool written = WriteAll(fd, data.data(), data.size()) && SyncFd(fd);
+    ::close(fd);
+
+    std::error_code ec;
+    if (!written) {
+        std::filesystem::remove(tmpPath, ec);
+        if (err) *err = "Cannot write " + tmpPath;
+        return false;
+    }
+    std::filesystem::rename(tmpPath, path, ec);
+    if (ec) {
+        std::filesystem::remove(tmpPath, ec);
+        if (err) *err = "Cannot rename " + tmpPath + " to " + path;
+        return false;
+    }
+
+#ifndef _WIN32
+    // best effort: past the rename there is nothing to roll back, a failure
+    // only leaves the new name not yet durable
+    std::string dir = std::filesystem::path(path).parent_path().string();
+    if (dir.empty()) dir = ".";
+    const int dfd = ::open(dir.c_str(), O_RDONLY);
+    if (dfd >= 0) {
+        ::fsync(dfd);
+        ::close(dfd);
+    }
+#endif
+    return true;
+}
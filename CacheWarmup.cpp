@@ -0,0 +1,101 @@
+#include "CacheWarmup.h"
+#include <chrono>
+#include <string>
+#include <vector>
+#include "CharacterStore.h"
+#include "CharacterRepository.h"
+#include "LeaderboardService.h"
+#include "ProgressJournal.h"
+
+CacheWarmup::~CacheWarmup()
+{
+    Join();
+}
+
+void CacheWarmup::Start()
+{
+    if (th_.joinable() || IsReady()) return;
+    th_ = std::thread([this]{ Run(); });
+}
+
+bool CacheWarmup::WaitFor(int timeoutMs)
+{
+    std::unique_lock<std::mutex> lock(mtx_);
+    return cv_.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this]{ return IsReady(); });
+}
+
+void CacheWarmup::Join()
+{
+    if (th_.joinable()) th_.join();
+}
+
+CacheWarmupStats CacheWarmup::GetStats()
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    return stats_;
+}
+
+void CacheWarmup::Run()
+{
+    const auto t0 = std::chrono::steady_clock::now();
+    CacheWarmupStats s;
+
+    try
+    {
+        g_leaderboard.LoadFromDb();
+        s.leaderboardsLoaded = true;
+    }
+    catch (const std::exception& e)
+    {
+        // first /leaderboards request retries
+        DaraLog("WARMUP", std::string("Leaderboard load failed: ") + e.what());
+    }
+
+    // rows arrive grouped by user: a user is complete when the next one starts
+    std::string userEmail;
+    std::vector<Character> chars;
+    auto putUser = [&]
+    {
+        if (userEmail.empty()) return;
+        // journaled progress is newer than the store
+        g_progressJournal.Overlay(chars);
+        // logged in (and loaded) meanwhile: that copy is at least as new
+        if (CacheSetCharactersForUserIfAbsent(userEmail, std::move(chars)))
+            s.users++;
+        chars.clear();
+    };
+
+    try
+    {
+        g_characterStore->ForEachCharacterOfActiveUsers(
+            static_cast<int64_t>(DARA_WARMUP_ACTIVE_HOURS) * 3600, DARA_WARMUP_MAX_USERS,
+            [&](CharacterRecord&& r)
+            {
+                if (r.usereMail != userEmail) {
+                    putUser();
+                    userEmail = r.usereMail;
+                }
+                chars.push_back(RecordToCharacter(r));
+                s.characters++;
+            });
+        putUser();
+    }
+    catch (const std::exception& e)
+    {
+        // the users load on login as usual
+        DaraLog("WARMUP", std::string("Character preload failed: ") + e.what());
+    }
+
+    s.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    DaraLog("WARMUP", "Preloaded " + std::to_string(s.characters) + " characters of "
+        + std::to_string(s.users) + " recently active users"
+        + (s.leaderboardsLoaded ? " and the leaderboards" : "")
+        + " in " + std::to_string(s.ms) + "ms");
+
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stats_ = s;
+        ready_.store(true, std::memory_order_release);
+    }
+    cv_.notify_all();
+}
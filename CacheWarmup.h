@@ -0,0 +1,52 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "DaraConfig.h"
+
+struct CacheWarmupStats
+{
+    size_t users = 0;               // put into the character cache
+    size_t characters = 0;
+    bool leaderboardsLoaded = false;
+    double ms = 0.0;                // total warm-up time
+};
+
+// =======================================================
+// Startup warm-up, run next to the rest of the startup: builds the
+// leaderboard index and loads the characters of users active within
+// DARA_WARMUP_ACTIVE_HOURS (one query, at most DARA_WARMUP_MAX_USERS) into
+// the character cache, so the first logins after a restart hit the cache
+// instead of queueing one LoadUserCharacters job each.
+// IsReady() turns true once it finished (successfully or not).
+// =======================================================
+class CacheWarmup
+{
+public:
+    CacheWarmup() = default;
+    ~CacheWarmup();
+
+    CacheWarmup(const CacheWarmup&) = delete;
+    CacheWarmup& operator=(const CacheWarmup&) = delete;
+
+    // needs g_characterStore and the opened progress journal
+    void Start();
+    // true if finished within the timeout
+    bool WaitFor(int timeoutMs);
+    void Join();
+
+    bool IsReady() const { return ready_.load(std::memory_order_acquire); }
+    CacheWarmupStats GetStats();
+
+private:
+    void Run();
+
+    std::thread th_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::atomic<bool> ready_{false};
+    CacheWarmupStats stats_;
+};
+
+extern CacheWarmup g_warmup;
@@ -0,0 +1,375 @@
+#include "CharacterCache.h"
+#include <algorithm>
+#include <chrono>
+
+CharacterCache::CharacterCache(size_t shards, size_t maxBytes)
+{
+    shards = std::max<size_t>(shards, 1);
+    shards_.reserve(shards);
+    for (size_t i = 0; i < shards; ++i)
+        shards_.push_back(std::make_unique<Shard>());
+    maxBytesPerShard_ = std::max<size_t>(maxBytes / shards, 1);
+}
+
+uint64_t CharacterCache::NowMs()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+CharacterCache::Shard& CharacterCache::ShardFor(const std::string& userKey)
+{
+    return *shards_[std::hash<std::string>{}(userKey) % shards_.size()];
+}
+
+// =============================
+// Bookkeeping (shard lock held)
+// =============================
+
+size_t CharacterCache::EstimateBytes(const std::string& userKey, const UserEntry& e)
+{
+    // map node + LRU node each hold a copy of the key
+    size_t n = sizeof(UserEntry) + 2 * (userKey.size() + 64);
+    for (const Character& c : e.chars)
+    {
+        n += sizeof(Character)
+           + c.characterId.size() + c.characterName.size() + c.characterClass.size()
+           + c.avatar.size() + c.createdAtIso.size();
+        n += c.characterId.size() + 64;   // byId node
+    }
+    if (e.body) n += e.body->size();
+    return n;
+}
+
+CharacterCache::UserEntry* CharacterCache::TouchLocked(Shard& shard, const std::string& userKey)
+{
+    auto it = shard.users.find(userKey);
+    if (it == shard.users.end()) {
+        shard.misses++;
+        return nullptr;
+    }
+    shard.hits++;
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second.lru);
+    return &it->second;
+}
+
+CharacterCache::UserEntry& CharacterCache::GetOrCreateLocked(Shard& shard, const std::string& userKey)
+{
+    if (UserEntry* e = TouchLocked(shard, userKey)) return *e;
+
+    UserEntry& e = shard.users[userKey];
+    shard.lru.push_front(userKey);
+    e.lru = shard.lru.begin();
+    return e;
+}
+
+void CharacterCache::LinkDirtyLocked(Shard& shard, UserEntry& e)
+{
+    e.dirtyPrev = shard.dirtyTail;
+    e.dirtyNext = nullptr;
+    if (shard.dirtyTail) shard.dirtyTail->dirtyNext = &e;
+    else shard.dirtyHead = &e;
+    shard.dirtyTail = &e;
+
+    shard.dirtyUsers++;
+    dirtyUsers_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void CharacterCache::UnlinkDirtyLocked(Shard& shard, UserEntry& e)
+{
+    if (e.dirtyPrev) e.dirtyPrev->dirtyNext = e.dirtyNext;
+    else shard.dirtyHead = e.dirtyNext;
+    if (e.dirtyNext) e.dirtyNext->dirtyPrev = e.dirtyPrev;
+    else shard.dirtyTail = e.dirtyPrev;
+    e.dirtyPrev = e.dirtyNext = nullptr;
+
+    shard.dirtyUsers--;
+    dirtyUsers_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void CharacterCache::ChangedLocked(Shard& shard, UserEntry& e)
+{
+    e.byId.clear();
+    size_t dirty = 0;
+    uint64_t dirtySince = UINT64_MAX;
+    for (size_t i = 0; i < e.chars.size(); ++i) {
+        e.byId[e.chars[i].characterId] = i;
+        if (e.chars[i].dirty) {
+            ++dirty;
+            dirtySince = std::min(dirtySince, e.chars[i].dirtySinceMs);
+        }
+    }
+
+    // unlinked entries are appended, which keeps the list ordered by dirtySinceMs
+    if (dirty > 0 && e.dirty == 0) {
+        e.dirtySinceMs = dirtySince;
+        LinkDirtyLocked(shard, e);
+    } else if (dirty == 0 && e.dirty > 0) {
+        UnlinkDirtyLocked(shard, e);
+    }
+    e.dirty = dirty;
+
+    e.body.reset();
+    e.version = ++nextVersion_;
+
+    shard.bytes -= e.bytes;
+    e.bytes = EstimateBytes(*e.lru, e);
+    shard.bytes += e.bytes;
+
+    EvictLocked(shard, &e);
+}
+
+void CharacterCache::EvictLocked(Shard& shard, const UserEntry* keep)
+{
+    if (shard.bytes <= maxBytesPerShard_) return;
+
+    // oldest first; dirty users hold unsaved progress and stay
+    auto it = shard.lru.end();
+    while (shard.bytes > maxBytesPerShard_ && it != shard.lru.begin())
+    {
+        --it;
+        auto entry = shard.users.find(*it);
+        if (entry == shard.users.end() || entry->second.dirty > 0 || &entry->second == keep)
+            continue;
+
+        shard.bytes -= entry->second.bytes;
+        shard.users.erase(entry);
+        it = shard.lru.erase(it);
+        shard.evictions++;
+    }
+}
+
+// =============================
+// Public API
+// =============================
+
+bool CharacterCache::Has(const std::string& userKey)
+{
+    Shard& shard = ShardFor(userKey);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    return TouchLocked(shard, userKey) != nullptr;
+}
+
+void CharacterCache::SetUser(const std::string& userKey, std::vector<Character> chars)
+{
+    Shard& shard = ShardFor(userKey);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    UserEntry& e = GetOrCreateLocked(shard, userKey);
+
+    // progress not yet written is newer than what the DB returned
+    for (const Character& old : e.chars)
+    {
+        if (!old.dirty) continue;
+        auto same = std::find_if(chars.begin(), chars.end(),
+            [&](const Character& c){ return c.characterId == old.characterId; });
+        if (same != chars.end()) *same = old;
+    }
+    e.chars = std::move(chars);
+    ChangedLocked(shard, e);
+}
+
+bool CharacterCache::SetUserIfAbsent(const std::string& userKey, std::vector<Character> chars)
+{
+    Shard& shard = ShardFor(userKey);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    if (shard.users.count(userKey)) return false;
+
+    UserEntry& e = GetOrCreateLocked(shard, userKey);
+    e.chars = std::move(chars);
+    ChangedLocked(shard, e);
+    return true;
+}
+
+std::vector<Character> CharacterCache::CopyUser(const std::string& userKey)
+{
+    Shard& shard = ShardFor(userKey);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    UserEntry* e = TouchLocked(shard, userKey);
+    return e ? e->chars : std::vector<Character>{};
+}
+
+std::optional<Character> CharacterCache::FindCharacter(const std::string& userKey, const std::string& characterId)
+{
+    Shard& shard = ShardFor(userKey);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    UserEntry* e = TouchLocked(shard, userKey);
+    if (!e) return std::nullopt;
+
+    auto it = e->byId.find(characterId);
+    if (it == e->byId.end()) return std::nullopt;
+    return e->chars[it->second];
+}
+
+void CharacterCache::UpsertCharacter(const std::string& userKey, Character ch)
+{
+    Shard& shard = ShardFor(userKey);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    UserEntry& e = GetOrCreateLocked(shard, userKey);
+
+    auto it = e.byId.find(ch.characterId);
+    if (it != e.byId.end())
+        e.chars[it->second] = std::move(ch);
+    else
+        e.chars.insert(e.chars.begin(), std::move(ch));
+    ChangedLocked(shard, e);
+}
+
+bool CharacterCache::RemoveCharacter(const std::string& userKey, const std::string& characterId)
+{
+    Shard& shard = ShardFor(userKey);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    UserEntry* e = TouchLocked(shard, userKey);
+    if (!e) return false;
+
+    auto it = e->byId.find(characterId);
+    if (it == e->byId.end()) return false;
+    e->chars.erase(e->chars.begin() + static_cast<std::ptrdiff_t>(it->second));
+    ChangedLocked(shard, *e);
+    return true;
+}
+
+bool CharacterCache::ApplyRewards(const std::string& userKey, const std::string& characterId,
+                                  int addXp, int addCredits, int addPotions)
+{
+    Shard& shard = ShardFor(userKey);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    UserEntry* e = TouchLocked(shard, userKey);
+    if (!e) return false;
+
+    auto it = e->byId.find(characterId);
+    if (it == e->byId.end()) return false;
+
+    Character& ch = e->chars[it->second];
+    ch.xp += addXp;
+    ch.credits += addCredits;
+    ch.potions += addPotions;
+    if (!ch.dirty) {
+        ch.dirty = true;
+        ch.dirtySinceMs = NowMs();
+    }
+    ChangedLocked(shard, *e);
+    return true;
+}
+
+bool CharacterCache::RecordProgress(const std::string& userKey, const std::string& characterId,
+                                    int level, int xp, int credits, int potions, int highestWave)
+{
+    Shard& shard = ShardFor(userKey);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    UserEntry* e = TouchLocked(shard, userKey);
+    if (!e) return false;
+
+    auto it = e->byId.find(characterId);
+    if (it == e->byId.end()) return false;
+
+    Character& ch = e->chars[it->second];
+    if (ch.level == level && ch.xp == xp && ch.credits == credits
+        && ch.potions == potions && ch.highestWave >= highestWave)
+        return true; // nothing new to save
+
+    ch.level = level;
+    ch.xp = xp;
+    ch.credits = credits;
+    ch.potions = potions;
+    ch.highestWave = std::max(ch.highestWave, highestWave);
+    if (!ch.dirty) {
+        ch.dirty = true;
+        ch.dirtySinceMs = NowMs();
+    }
+    ChangedLocked(shard, *e);
+    return true;
+}
+
+std::shared_ptr<const std::string> CharacterCache::CharactersBody(const std::string& userKey, uint64_t* version)
+{
+    Shard& shard = ShardFor(userKey);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    UserEntry* e = TouchLocked(shard, userKey);
+    if (!e) return nullptr;
+
+    if (!e->body)
+    {
+        json arr = json::array();
+        for (const Character& ch : e->chars) arr.push_back(CharacterToListJson(ch));
+        e->body = std::make_shared<const std::string>(arr.dump());
+        shard.bodyBuilds++;
+
+        shard.bytes -= e->bytes;
+        e->bytes = EstimateBytes(*e->lru, *e);
+        shard.bytes += e->bytes;
+        EvictLocked(shard, e);
+    }
+    if (version) *version = e->version;
+    return e->body;
+}
+
+void CharacterCache::TakeDirtyLocked(Shard& shard, UserEntry& e, std::vector<DirtyToSave>& out)
+{
+    if (e.dirty == 0) return;
+
+    const std::string& email = *e.lru;
+    for (Character& ch : e.chars)
+    {
+        if (!ch.dirty) continue;
+        ch.dirty = false;
+        ch.dirtySinceMs = 0;
+        out.push_back({email, ch.characterId, ch.level, ch.xp, ch.credits, ch.potions, ch.highestWave});
+    }
+    e.dirty = 0;
+    UnlinkDirtyLocked(shard, e);
+}
+
+std::vector<DirtyToSave> CharacterCache::CollectDirty(uint64_t dirtySinceMs)
+{
+    std::vector<DirtyToSave> out;
+    for (auto& shardPtr : shards_)
+    {
+        Shard& shard = *shardPtr;
+        std::lock_guard<std::mutex> lock(shard.mtx);
+
+        // oldest first: stop at the first user dirty for less than the window
+        while (shard.dirtyHead && shard.dirtyHead->dirtySinceMs <= dirtySinceMs)
+            TakeDirtyLocked(shard, *shard.dirtyHead, out);
+
+        // now evictable again
+        EvictLocked(shard, nullptr);
+    }
+    return out;
+}
+
+std::vector<DirtyToSave> CharacterCache::CollectDirtyUser(const std::string& userKey)
+{
+    std::vector<DirtyToSave> out;
+    Shard& shard = ShardFor(userKey);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+
+    auto it = shard.users.find(userKey);
+    if (it != shard.users.end()) TakeDirtyLocked(shard, it->second, out);
+    return out;
+}
+
+void CharacterCache::ForEachUser(const std::function<void(const std::string&, const std::vector<Character>&)>& fn)
+{
+    for (auto& shard : shards_)
+    {
+        std::lock_guard<std::mutex> lock(shard->mtx);
+        for (const auto& [userKey, e] : shard->users) fn(userKey, e.chars);
+    }
+}
+
+CharacterCacheStats CharacterCache::GetStats()
+{
+    CharacterCacheStats s;
+    for (auto& shard : shards_)
+    {
+        std::lock_guard<std::mutex> lock(shard->mtx);
+        s.hits       += shard->hits;
+        s.misses     += shard->misses;
+        s.evictions  += shard->evictions;
+        s.bodyBuilds += shard->bodyBuilds;
+        s.users      += shard->users.size();
+        s.bytes      += shard->bytes;
+        s.dirtyUsers += shard->dirtyUsers;
+    }
+    return s;
+}
@@ -0,0 +1,135 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <optional>
+#include <functional>
+#include <unordered_map>
+#include <cstdint>
+#include "DaraConfig.h"
+#include "character.h"
+
+struct CharacterCacheStats
+{
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    uint64_t bodyBuilds = 0;    // /characters bodies serialized (the rest were served cached)
+    size_t users = 0;
+    size_t bytes = 0;           // estimated
+    size_t dirtyUsers = 0;      // pinned, never evicted
+};
+
+// =======================================================
+// In-memory character cache, keyed by user (email).
+// - striped: DARA_CHAR_CACHE_SHARDS shards, each with its own mutex and LRU
+// - per user: characters in DB order (newest first) + index by characterId,
+//   a version (changes on every modification, never reused) and the
+//   serialized /characters array, built on demand and kept until the next change
+// - LRU eviction once a shard exceeds its part of DARA_CHAR_CACHE_MAX_BYTES;
+//   users with dirty (unsaved) characters are never evicted
+// - users with dirty characters are linked into an intrusive per-shard list
+//   in the order they became dirty, so the checkpointer (CommitCacheToDB)
+//   finds everything older than its window without scanning the cache
+// =======================================================
+class CharacterCache
+{
+public:
+    explicit CharacterCache(size_t shards = DARA_CHAR_CACHE_SHARDS,
+                            size_t maxBytes = DARA_CHAR_CACHE_MAX_BYTES);
+
+    CharacterCache(const CharacterCache&) = delete;
+    CharacterCache& operator=(const CharacterCache&) = delete;
+
+    bool Has(const std::string& userKey);
+    // replaces the user's list (DB load); characters dirty in the cache are kept
+    void SetUser(const std::string& userKey, std::vector<Character> chars);
+    // sets the list only if the user is not cached (preloads: a cached entry is newer); true if set
+    bool SetUserIfAbsent(const std::string& userKey, std::vector<Character> chars);
+    std::vector<Character> CopyUser(const std::string& userKey);
+    std::optional<Character> FindCharacter(const std::string& userKey, const std::string& characterId);
+
+    // adds (newest first) or replaces a character; creates the user entry if needed
+    void UpsertCharacter(const std::string& userKey, Character ch);
+    bool RemoveCharacter(const std::string& userKey, const std::string& characterId);
+    // adds rewards and marks the character dirty; false if not cached
+    bool ApplyRewards(const std::string& userKey, const std::string& characterId,
+                      int addXp, int addCredits, int addPotions);
+    // in-game progress (absolute values, highestWave only grows); marks the
+    // character dirty if anything changed; false if not cached
+    bool RecordProgress(const std::string& userKey, const std::string& characterId,
+                        int level, int xp, int credits, int potions, int highestWave);
+
+    // serialized characters array for /characters, nullptr if the user is not cached
+    std::shared_ptr<const std::string> CharactersBody(const std::string& userKey, uint64_t* version = nullptr);
+
+    // dirty characters of users dirty since at or before `dirtySinceMs`
+    // (default: all); their dirty flags are cleared (see CollectDirtyCharacters)
+    std::vector<DirtyToSave> CollectDirty(uint64_t dirtySinceMs = UINT64_MAX);
+    std::vector<DirtyToSave> CollectDirtyUser(const std::string& userKey);
+    size_t DirtyUsers() const { return dirtyUsers_.load(std::memory_order_relaxed); }
+
+    // clock of Character::dirtySinceMs
+    static uint64_t NowMs();
+
+    // debugging only (holds each shard lock while calling fn)
+    void ForEachUser(const std::function<void(const std::string&, const std::vector<Character>&)>& fn);
+
+    CharacterCacheStats GetStats();
+
+private:
+    struct UserEntry
+    {
+        std::vector<Character> chars;                        // DB order, newest first
+        std::unordered_map<std::string, size_t> byId;        // characterId -> index in chars
+        uint64_t version = 0;
+        std::shared_ptr<const std::string> body;             // nullptr = build on next request
+        size_t dirty = 0;                                    // characters with dirty set
+        size_t bytes = 0;
+        std::list<std::string>::iterator lru;                // position in Shard::lru
+
+        // intrusive dirty list (Shard::dirtyHead), linked while dirty > 0
+        uint64_t dirtySinceMs = 0;
+        UserEntry* dirtyPrev = nullptr;
+        UserEntry* dirtyNext = nullptr;
+    };
+
+    struct Shard
+    {
+        std::mutex mtx;
+        std::unordered_map<std::string, UserEntry> users;
+        std::list<std::string> lru;                          // front = most recently used
+        UserEntry* dirtyHead = nullptr;                      // oldest dirty user first
+        UserEntry* dirtyTail = nullptr;
+        size_t bytes = 0;
+        size_t dirtyUsers = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        uint64_t bodyBuilds = 0;
+    };
+
+    Shard& ShardFor(const std::string& userKey);
+    // entry or nullptr; counts a hit/miss and refreshes the LRU position
+    UserEntry* TouchLocked(Shard& shard, const std::string& userKey);
+    UserEntry& GetOrCreateLocked(Shard& shard, const std::string& userKey);
+    // after any change: reindex, drop the body, bump version, re-account, evict
+    void ChangedLocked(Shard& shard, UserEntry& e);
+    void EvictLocked(Shard& shard, const UserEntry* keep);
+    void LinkDirtyLocked(Shard& shard, UserEntry& e);
+    void UnlinkDirtyLocked(Shard& shard, UserEntry& e);
+    // clears the dirty flags of e (unlinks it) and appends them to out
+    void TakeDirtyLocked(Shard& shard, UserEntry& e, std::vector<DirtyToSave>& out);
+
+    static size_t EstimateBytes(const std::string& userKey, const UserEntry& e);
+
+    std::vector<std::unique_ptr<Shard>> shards_;
+    size_t maxBytesPerShard_;
+    std::atomic<uint64_t> nextVersion_{0};
+    std::atomic<size_t> dirtyUsers_{0};
+};
+
+extern CharacterCache g_charCache;
@@ -0,0 +1,69 @@
+#include "CharacterCheckpointer.h"
+#include "CharacterCache.h"
+#include "CharacterRepository.h"
+
+CharacterCheckpointer::~CharacterCheckpointer()
+{
+    Stop();
+}
+
+void CharacterCheckpointer::Start()
+{
+    bool expected = false;
+    if (!running_.compare_exchange_strong(expected, true))
+        return; // already running
+
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stop_ = false;
+    }
+    th_ = std::thread([this]{ Run(); });
+}
+
+void CharacterCheckpointer::Stop()
+{
+    if (!running_.exchange(false)) return;
+
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stop_ = true;
+    }
+    cv_.notify_one();
+    if (th_.joinable()) th_.join();
+
+    // shutdown: nothing dirty stays behind (the DB worker flushes it on Stop)
+    CommitCacheToDB(true);
+}
+
+void CharacterCheckpointer::NotifyDirty()
+{
+    if (g_charCache.DirtyUsers() < static_cast<size_t>(DARA_CHECKPOINT_MAX_DIRTY_USERS)) return;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        wake_ = true;
+    }
+    cv_.notify_one();
+}
+
+void CharacterCheckpointer::Run()
+{
+    std::unique_lock<std::mutex> lock(mtx_);
+    while (!stop_)
+    {
+        cv_.wait_for(lock, std::chrono::milliseconds(DARA_CHECKPOINT_INTERVAL_MS),
+                     [this]{ return stop_ || wake_; });
+        if (stop_) break;
+        wake_ = false;
+
+        lock.unlock();
+        try
+        {
+            CommitCacheToDB();
+        }
+        catch (const std::exception& e)
+        {
+            DaraLog("DB", std::string("Checkpoint failed: ") + e.what());
+        }
+        lock.lock();
+    }
+}
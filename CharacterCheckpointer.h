@@ -0,0 +1,37 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "DaraConfig.h"
+
+// Periodic checkpoint of dirty cached characters (CommitCacheToDB) every
+// DARA_CHECKPOINT_INTERVAL_MS, early once too many users are dirty, and a
+// final forced one on Stop(). Must be stopped before the DB worker.
+class CharacterCheckpointer
+{
+public:
+    CharacterCheckpointer() = default;
+    ~CharacterCheckpointer();
+
+    CharacterCheckpointer(const CharacterCheckpointer&) = delete;
+    CharacterCheckpointer& operator=(const CharacterCheckpointer&) = delete;
+
+    void Start();
+    void Stop();
+
+    // a character became dirty; wakes the thread once the batch threshold is hit
+    void NotifyDirty();
+
+private:
+    void Run();
+
+    std::thread th_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+    bool wake_ = false;
+    std::atomic<bool> running_{false};
+};
+
+extern CharacterCheckpointer g_checkpointer;
@@ -1,89 +1,435 @@
 #include <condition_variable>
 #include <mutex>
 #include <chrono>
+#include <vector>
+#include <algorithm>
 #include "CharacterDbWorker.h"
 #include "CharacterRepository.h"
+#include "LeaderboardService.h"
+#include "ProgressJournal.h"
 #include "character.h"
 
 
 
-// full implementation here (Run(), queue, etc.)
+CharacterDbWorker::CharacterDbWorker(size_t threads)
+{
+    shards_.reserve(std::max<size_t>(threads, 1));
+    for (size_t i = 0; i < std::max<size_t>(threads, 1); ++i)
+        shards_.push_back(std::make_unique<Shard>());
+}
+
 void CharacterDbWorker::Start()
 {
-    running_ = true;
-    th_ = std::thread([this]{ Run(); });
+    bool expected = false;
+    if (!running_.compare_exchange_strong(expected, true))
+        return; // already running
+
+    for (auto& shard : shards_)
+    {
+        Shard* s = shard.get();
+        s->th = std::thread([this, s]{ Run(*s); });
+    }
+    DaraLog("DB", "Started " + std::to_string(shards_.size()) + " DB worker threads");
 }
 
 void CharacterDbWorker::Stop()
 {
-    q_.Stop();
-    if (th_.joinable()) th_.join();
+    for (auto& shard : shards_) shard->q.Stop();
+    for (auto& shard : shards_)
+        if (shard->th.joinable()) shard->th.join();
     running_ = false;
 }
 
-void CharacterDbWorker::RequestLoadUser(const std::string& email)
+CharacterDbWorker::Shard& CharacterDbWorker::ShardForUser(std::string_view email)
+{
+    return *shards_[std::hash<std::string_view>{}(email) % shards_.size()];
+}
+
+CharacterDbWorker::Shard& CharacterDbWorker::ShardForCharacter(int characterId)
+{
+    return *shards_[std::hash<int>{}(characterId) % shards_.size()];
+}
+
+// =============================
+// Single-flight loads
+// =============================
+
+void CharacterDbWorker::RequestLoadUser(const std::string& email, std::function<void(bool ok)> done)
+{
+    bool knownEmpty = false;
+    {
+        std::lock_guard<std::mutex> lock(loadMtx_);
+        loadStats_.requests++;
+
+        auto neg = noCharactersUntil_.find(email);
+        if (neg != noCharactersUntil_.end())
+        {
+            if (std::chrono::steady_clock::now() < neg->second) {
+                knownEmpty = true;
+                loadStats_.negativeHits++;
+            } else {
+                noCharactersUntil_.erase(neg);
+            }
+        }
+
+        if (!knownEmpty)
+        {
+            auto [it, inserted] = inflightLoads_.try_emplace(email);
+            if (done) it->second.push_back(std::move(done));
+            if (!inserted) {
+                loadStats_.joined++;
+                return;
+            }
+            loadStats_.dbLoads++;
+        }
+    }
+
+    if (knownEmpty)
+    {
+        // the cache may have dropped the (empty) entry meanwhile
+        CacheSetCharactersForUserIfAbsent(email, {});
+        if (done) done(true);
+        return;
+    }
+
+    DbJob j{EDbJobType::LoadUserCharacters, email};
+    j.done = [this, email](bool ok){ CompleteLoad(email, ok); };
+    PushLoad(j);   // a rejected job completes (false) right away
+}
+
+void CharacterDbWorker::CompleteLoad(const std::string& email, bool ok)
+{
+    std::vector<std::function<void(bool)>> waiters;
+    {
+        std::lock_guard<std::mutex> lock(loadMtx_);
+        auto it = inflightLoads_.find(email);
+        if (it == inflightLoads_.end()) return;
+        waiters.swap(it->second);
+        inflightLoads_.erase(it);
+    }
+    for (auto& w : waiters) w(ok);
+}
+
+void CharacterDbWorker::RememberNoCharacters(const std::string& email)
+{
+    const auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(loadMtx_);
+
+    // keep the map from growing with one-time visitors
+    if (noCharactersUntil_.size() >= 1024)
+        std::erase_if(noCharactersUntil_, [&](const auto& e){ return e.second <= now; });
+    noCharactersUntil_[email] = now + std::chrono::milliseconds(DARA_DB_NEGATIVE_CACHE_MS);
+}
+
+void CharacterDbWorker::ForgetNoCharacters(const std::string& email)
 {
-    q_.Push(DbJob{EDbJobType::LoadUserCharacters, email});
+    std::lock_guard<std::mutex> lock(loadMtx_);
+    noCharactersUntil_.erase(email);
+}
+
+CharacterLoadStats CharacterDbWorker::GetLoadStats()
+{
+    std::lock_guard<std::mutex> lock(loadMtx_);
+    return loadStats_;
+}
+
+bool CharacterDbWorker::PushLoad(DbJob& j)
+{
+    // never block the HTTP thread: a full queue means the DB is far behind
+    if (ShardForUser(j.userEmail).q.Push(j, EDbLane::Interactive, EDbOverflowPolicy::Reject))
+        return true;
+
+    DaraLog("DB", "Load for " + j.userEmail + " rejected, DB queue full");
+    if (j.done) j.done(false);
+    return false;
 }
 
 void CharacterDbWorker::RequestSaveCharacter(const std::string& characterId,
                               int level, int xp, int credits, int potions, int highestWave)
 {
-    DbJob j;
-    j.type = EDbJobType::SaveCharacter;
-    j.characterId = characterId;
-    j.level=level; j.xp=xp; j.credits=credits; j.potions=potions;
-    j.highestWave= highestWave;
-    q_.Push(std::move(j));
-
+    QueueSave(characterId, level, xp, credits, potions, highestWave);
 }
 void CharacterDbWorker::RequestSavePlayerCharacter(const std::string& email,
                             const std::string& characterId,
                             int level,int xp,int credits,int potions, int highestWave)
 {
-    DbJob j;
-    j.type = EDbJobType::SavePlayerCharacter;
-    j.userEmail = email;
-    j.characterId = characterId;
-    j.level=level; j.xp=xp; j.credits=credits; j.potions=potions;
-    j.highestWave= highestWave;
-    q_.Push(std::move(j));
+    (void)email; // rows are keyed by characterId
+    QueueSave(characterId, level, xp, credits, potions, highestWave);
+}
+
+// =============================
+// Write-behind save buffer
+// =============================
+
+void CharacterDbWorker::QueueSave(const std::string& characterId,
+                              int level, int xp, int credits, int potions, int highestWave)
+{
+    // cache ids are strings, the DB id is the numeric CharacterId
+    if (characterId.empty() || !std::isdigit((unsigned char)characterId[0])) {
+        DaraLog("DB", "Save ignored, characterId not numeric: " + characterId);
+        return;
+    }
+    const int dbId = std::stoi(characterId);
+    Shard& shard = ShardForCharacter(dbId);
+
+    const auto now = std::chrono::steady_clock::now();
+    bool wakeWorker = false;
+    bool dropped = false;
+    int droppedId = 0;
+    {
+        std::lock_guard<std::mutex> lock(shard.saveMtx);
+        if (shard.pendingSaves.empty())
+            shard.oldestPending = now;
+
+        // DB stalled and the buffer is full: the least recently updated
+        // character loses its buffered save (it is re-saved on its next change)
+        if (shard.pendingSaves.size() >= static_cast<size_t>(DARA_DB_SAVE_BUFFER_MAX)
+            && shard.pendingSaves.find(dbId) == shard.pendingSaves.end())
+        {
+            auto oldest = std::min_element(shard.pendingSaves.begin(), shard.pendingSaves.end(),
+                [](const auto& a, const auto& b){ return a.second.lastUpdate < b.second.lastUpdate; });
+            droppedId = oldest->first;
+            shard.pendingSaves.erase(oldest);
+            dropped = true;
+        }
+
+        auto [it, inserted] = shard.pendingSaves.try_emplace(dbId);
+        PendingSave& p = it->second;
+        p.lastUpdate = now;
+        if (inserted) {
+            p.row.characterId = dbId;
+            p.row.highestWave = highestWave;
+        } else {
+            p.requests++;
+            p.row.highestWave = std::max(p.row.highestWave, highestWave);
+        }
+        // latest state wins
+        p.row.level   = level;
+        p.row.xp      = xp;
+        p.row.credits = credits;
+        p.row.potions = potions;
+
+        if (!shard.flushRequested && shard.pendingSaves.size() >= static_cast<size_t>(DARA_DB_FLUSH_MAX_ROWS)) {
+            shard.flushRequested = true;
+            wakeWorker = true;
+        }
+    }
+    saveRequests_.fetch_add(1, std::memory_order_relaxed);
+    if (dropped) {
+        droppedSaves_.fetch_add(1, std::memory_order_relaxed);
+        DaraLog("DB", "Save buffer full, dropped buffered save of characterId=" + std::to_string(droppedId));
+    }
+    if (wakeWorker) {
+        // a full background lane already holds flush requests for this shard
+        DbJob j{EDbJobType::FlushSaves, {}};
+        shard.q.Push(j, EDbLane::Background, EDbOverflowPolicy::Coalesce);
+    }
+}
+
+bool CharacterDbWorker::SaveFlushDue(Shard& shard)
+{
+    std::lock_guard<std::mutex> lock(shard.saveMtx);
+    return !shard.pendingSaves.empty()
+        && std::chrono::steady_clock::now() - shard.oldestPending >= std::chrono::milliseconds(DARA_DB_FLUSH_INTERVAL_MS);
+}
+
+void CharacterDbWorker::FlushSaves(Shard& shard)
+{
+    std::lock_guard<std::mutex> flushLock(shard.flushMtx);
+
+    std::vector<CharacterSave> rows;
+    uint64_t requests = 0;
+    {
+        std::lock_guard<std::mutex> lock(shard.saveMtx);
+        shard.flushing.swap(shard.pendingSaves);   // flushing is empty here (flushMtx)
+        shard.flushRequested = false;
+        rows.reserve(shard.flushing.size());
+        for (const auto& [id, p] : shard.flushing) {
+            rows.push_back(p.row);
+            requests += p.requests;
+        }
+    }
+    if (rows.empty()) return;
+    // fixed row order: concurrent flushers never lock rows in opposite order
+    std::sort(rows.begin(), rows.end(),
+              [](const CharacterSave& a, const CharacterSave& b){ return a.characterId < b.characterId; });
+
+    const auto t0 = std::chrono::steady_clock::now();
+    try
+    {
+        UpdateCharactersBatch(rows);
+    }
+    catch (const std::exception& e)
+    {
+        DaraLog("DB", std::string("Save flush failed, retrying later: ") + e.what());
+
+        // put the batch back; anything queued meanwhile is newer and wins
+        {
+            std::lock_guard<std::mutex> lock(shard.saveMtx);
+            if (shard.pendingSaves.empty())
+                shard.oldestPending = std::chrono::steady_clock::now();
+            for (auto& [id, p] : shard.flushing) {
+                auto [it, inserted] = shard.pendingSaves.try_emplace(id, std::move(p));
+                if (!inserted) {
+                    it->second.requests += p.requests;
+                    it->second.row.highestWave = std::max(it->second.row.highestWave, p.row.highestWave);
+                }
+            }
+            shard.flushing.clear();
+        }
+        std::lock_guard<std::mutex> lock(statsMtx_);
+        stats_.failedFlushes++;
+        return;
+    }
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    {
+        std::lock_guard<std::mutex> lock(shard.saveMtx);
+        shard.flushing.clear();
+        shard.flushesDone++;
+    }
+    g_leaderboard.ApplySaves(rows);
+    g_progressJournal.MarkSaved(rows);
+
+    double ratio = 0.0;
+    {
+        std::lock_guard<std::mutex> lock(statsMtx_);
+        stats_.flushes++;
+        stats_.rowsWritten += rows.size();
+        stats_.requestsFlushed += requests;
+        stats_.lastFlushMs = ms;
+        stats_.maxFlushMs = std::max(stats_.maxFlushMs, ms);
+        stats_.totalFlushMs += ms;
+        ratio = stats_.CoalescingRatio();
+    }
+
+    DaraLog("DB", "Flushed " + std::to_string(rows.size()) + " characters (" + std::to_string(requests)
+        + " save requests) in " + std::to_string(ms) + "ms, coalescing ratio "
+        + std::to_string(ratio));
+}
+
+std::vector<uint64_t> CharacterDbWorker::FlushesDone()
+{
+    std::vector<uint64_t> done;
+    done.reserve(shards_.size());
+    for (auto& shard : shards_)
+    {
+        std::lock_guard<std::mutex> lock(shard->saveMtx);
+        done.push_back(shard->flushesDone);
+    }
+    return done;
+}
+
+bool CharacterDbWorker::OverlayBufferedSaves(std::vector<Character>& chars, const std::vector<uint64_t>& flushesBefore)
+{
+    bool current = true;
+    for (auto& ch : chars)
+    {
+        if (ch.characterId.empty() || !std::isdigit((unsigned char)ch.characterId[0])) continue;
+        const int dbId = std::stoi(ch.characterId);
+        const size_t idx = std::hash<int>{}(dbId) % shards_.size();   // ShardForCharacter
+        Shard& shard = *shards_[idx];
+
+        std::lock_guard<std::mutex> lock(shard.saveMtx);
+        // pending is newer than the batch in flight, which is newer than the DB
+        auto it = shard.pendingSaves.find(dbId);
+        if (it == shard.pendingSaves.end()) {
+            it = shard.flushing.find(dbId);
+            if (it == shard.flushing.end()) {
+                // a batch may have been written after the read and left `flushing` since
+                if (shard.flushesDone != flushesBefore[idx]) current = false;
+                continue;
+            }
+        }
+        const CharacterSave& row = it->second.row;
+        ch.level       = row.level;
+        ch.xp          = row.xp;
+        ch.credits     = row.credits;
+        ch.potions     = row.potions;
+        ch.highestWave = std::max(ch.highestWave, row.highestWave);
+    }
+    return current;
 }
 
-void CharacterDbWorker::Run()
+CharacterSaveStats CharacterDbWorker::GetSaveStats()
 {
+    CharacterSaveStats s;
+    {
+        std::lock_guard<std::mutex> lock(statsMtx_);
+        s = stats_;
+    }
+    s.requests = saveRequests_.load(std::memory_order_relaxed);
+    s.droppedSaves = droppedSaves_.load(std::memory_order_relaxed);
+    for (auto& shard : shards_)
+    {
+        std::lock_guard<std::mutex> lock(shard->saveMtx);
+        s.pending += shard->pendingSaves.size();
+    }
+    return s;
+}
+
+DbQueueStats CharacterDbWorker::GetQueueStats()
+{
+    DbQueueStats total;
+    double waitMsSum = 0.0;
+    for (auto& shard : shards_)
+    {
+        const DbQueueStats s = shard->q.GetStats();
+        total.pushed           += s.pushed;
+        total.popped           += s.popped;
+        total.rejected         += s.rejected;
+        total.coalesced        += s.coalesced;
+        total.depthInteractive += s.depthInteractive;
+        total.depthBackground  += s.depthBackground;
+        total.maxQueueWaitMs    = std::max(total.maxQueueWaitMs, s.maxQueueWaitMs);
+        waitMsSum              += s.avgQueueWaitMs * static_cast<double>(s.popped);
+    }
+    total.avgQueueWaitMs = total.popped ? waitMsSum / static_cast<double>(total.popped) : 0.0;
+    return total;
+}
+
+void CharacterDbWorker::Run(Shard& shard)
+{
+    // wake up often enough to honour the flush interval
+    const auto poll = std::chrono::milliseconds(std::max(50, DARA_DB_FLUSH_INTERVAL_MS / 4));
+
     while (true)
     {
         DbJob job;
-        if (!q_.PopWait(job)) break;
+        if (!shard.q.PopWaitFor(job, poll))
+        {
+            if (shard.q.IsStopped()) break;
+            if (SaveFlushDue(shard)) FlushSaves(shard);
+            continue;
+        }
 
         try
         {
             if (job.type == EDbJobType::LoadUserCharacters)
             {
-                auto chars = DbGetCharactersAsGameCharacters(job.userEmail);
+                // read-your-writes without flushing: the user's buffered (or in
+                // flight) saves are laid over the rows read. Reread if a flush of
+                // one of their shards finished during the read; rare, and bounded
+                std::vector<Character> chars;
+                for (int attempt = 0; ; ++attempt)
+                {
+                    const std::vector<uint64_t> flushesBefore = FlushesDone();
+                    chars = DbGetCharactersAsGameCharacters(job.userEmail);
+                    if (OverlayBufferedSaves(chars, flushesBefore)) break;
+                    if (attempt >= 2) {
+                        DaraLog("DB", "Characters of " + job.userEmail + " may miss a save written during the load");
+                        break;
+                    }
+                }
+                // saves dropped from a full buffer: journaled progress is newer than the DB
+                g_progressJournal.Overlay(chars);
+                if (chars.empty()) RememberNoCharacters(job.userEmail);
                 CacheSetCharactersForUser(job.userEmail, std::move(chars));
                 DaraLog("DB", "Loaded characters for " + job.userEmail);
                 if (job.done) job.done(true);
             }
-            else if (job.type == EDbJobType::SavePlayerCharacter)
-            {
-                // You currently have UpdateCharacter(int characterId, ...)
-                // but your cache uses string characterId. Convert:
-                if (job.characterId.empty() || !std::isdigit((unsigned char)job.characterId[0]))
-                    throw std::runtime_error("SavePlayerCharacter: characterId not numeric: " + job.characterId);
-                int dbId = std::stoi(job.characterId); // works only if characterId is numeric string
-                UpdateCharacter(dbId, job.level, job.xp, job.credits, job.potions, job.highestWave);
-                DaraLog("DB", "Saved characterId=" + job.characterId);
-            } else if (job.type == EDbJobType::SaveCharacter)
+            else if (job.type == EDbJobType::FlushSaves)
             {
-                // You currently have UpdateCharacter(int characterId, ...)
-                // but your cache uses string characterId. Convert:
-                if (job.characterId.empty() || !std::isdigit((unsigned char)job.characterId[0]))
-                    throw std::runtime_error("SaveCharacter: characterId not numeric: " + job.characterId);
-                int dbId = std::stoi(job.characterId); // works only if characterId is numeric string
-                UpdateCharacter(dbId, job.level, job.xp, job.credits, job.potions, job.highestWave);
-                DaraLog("DB", "Saved characterId=" + job.characterId);
+                FlushSaves(shard);
             }
         }
         catch (const std::exception& e)
@@ -91,31 +437,36 @@ void CharacterDbWorker::Run()
             DaraLog("DB", std::string("DB worker error: ") + e.what());
               if (job.done) job.done(false);
         }
+
+        if (SaveFlushDue(shard)) FlushSaves(shard);
     }
+
+    // shutdown: nothing buffered gets lost
+    FlushSaves(shard);
 }
 
 bool CharacterDbWorker::LoadUserBlocking(const std::string& email, int timeoutMs)
 {
-    std::mutex m;
-    std::condition_variable cv;
-    bool finished = false;
-    bool ok = false;
-
-    DbJob j;
-    j.type = EDbJobType::LoadUserCharacters;
-    j.userEmail = email;
-    j.done = [&](bool success)
+    // shared with the load: after a timeout the worker still calls back
+    struct Wait
     {
-        std::lock_guard<std::mutex> lock(m);
-        ok = success;
-        finished = true;
-        cv.notify_one();
+        std::mutex m;
+        std::condition_variable cv;
+        bool finished = false;
+        bool ok = false;
     };
+    auto w = std::make_shared<Wait>();
 
-    q_.Push(std::move(j));
+    RequestLoadUser(email, [w](bool success)
+    {
+        std::lock_guard<std::mutex> lock(w->m);
+        w->ok = success;
+        w->finished = true;
+        w->cv.notify_one();
+    });
 
-    std::unique_lock<std::mutex> lock(m);
-    cv.wait_for(lock, std::chrono::milliseconds(timeoutMs), [&]{ return finished; });
+    std::unique_lock<std::mutex> lock(w->m);
+    w->cv.wait_for(lock, std::chrono::milliseconds(timeoutMs), [&]{ return w->finished; });
 
-    return finished && ok;
-}
\ No newline at end of file
+    return w->finished && w->ok;
+}
@@ -1,17 +1,71 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <thread>
 #include <atomic>
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <functional>
 #include "DbJobQueue.h"
+#include "CharacterRepository.h"
 
+// write-behind metrics (see CharacterDbWorker::GetSaveStats)
+struct CharacterSaveStats
+{
+    uint64_t requests = 0;          // RequestSave* calls accepted
+    uint64_t requestsFlushed = 0;   // of those, written (coalesced into rows)
+    uint64_t rowsWritten = 0;
+    uint64_t flushes = 0;
+    uint64_t failedFlushes = 0;
+    uint64_t droppedSaves = 0;      // evicted from a full buffer (DARA_DB_SAVE_BUFFER_MAX)
+    size_t pending = 0;             // characters currently buffered
+    double lastFlushMs = 0.0;
+    double maxFlushMs = 0.0;
+    double totalFlushMs = 0.0;
+
+    // save requests per row actually written
+    double CoalescingRatio() const { return rowsWritten ? double(requestsFlushed) / double(rowsWritten) : 0.0; }
+};
+
+// single-flight loads (see CharacterDbWorker::GetLoadStats)
+struct CharacterLoadStats
+{
+    uint64_t requests = 0;       // RequestLoadUser / LoadUserBlocking calls
+    uint64_t dbLoads = 0;        // of those, turned into a DB job
+    uint64_t joined = 0;         // attached to a load already in flight
+    uint64_t negativeHits = 0;   // answered by the "no characters" cache
+};
+
+// DB jobs run on DARA_DB_WORKER_THREADS shards. A user's loads always hash to
+// the same shard (FIFO per user) and a character's saves always land in the
+// same shard's buffer, whose writes are serialized (ordered per character);
+// different users proceed in parallel. Each shard serves interactive jobs
+// before background flushes (see EDbLane).
 class CharacterDbWorker
 {
 public:
+    explicit CharacterDbWorker(size_t threads = DARA_DB_WORKER_THREADS);
+
+    CharacterDbWorker(const CharacterDbWorker&) = delete;
+    CharacterDbWorker& operator=(const CharacterDbWorker&) = delete;
+
     void Start();
     void Stop();
 
-    void RequestLoadUser(const std::string& email);
+    // Single-flight: while a load for `email` is in flight, further requests
+    // attach to it instead of queueing another job; `done` (optional) runs
+    // on a worker thread once the load finished (or was rejected).
+    // A user found without characters is not reloaded for DARA_DB_NEGATIVE_CACHE_MS.
+    void RequestLoadUser(const std::string& email, std::function<void(bool ok)> done = {});
+    // the user just got characters (e.g. created one): drop the negative entry
+    void ForgetNoCharacters(const std::string& email);
+    // Saves are write-behind: buffered per characterId (latest state wins,
+    // highestWave keeps the max) and flushed by the worker every
+    // DARA_DB_FLUSH_INTERVAL_MS or once DARA_DB_FLUSH_MAX_ROWS are buffered.
     void RequestSaveCharacter(const std::string& characterId,
                               int level, int xp, int credits, int potions, int highestWave);
     void RequestSavePlayerCharacter(const std::string& email,
@@ -19,9 +73,65 @@ public:
                               int level, int xp, int credits, int potions, int highestWave);
     bool LoadUserBlocking(const std::string& email, int timeoutMs);
 
+    CharacterSaveStats GetSaveStats();
+    CharacterLoadStats GetLoadStats();
+    // summed over all shards: depth, queue wait, rejected loads, coalesced flushes
+    DbQueueStats GetQueueStats();
+
 private:
-    void Run();
-    DbJobQueue q_;
-    std::thread th_;
+    struct PendingSave
+    {
+        CharacterSave row;
+        uint32_t requests = 1;   // save requests merged into this row
+        std::chrono::steady_clock::time_point lastUpdate{};
+    };
+
+    struct Shard
+    {
+        DbJobQueue q;
+        std::thread th;
+
+        // ---- guarded by saveMtx ----
+        std::mutex saveMtx;
+        std::unordered_map<int, PendingSave> pendingSaves;
+        // swapped out of pendingSaves and being written; loads still see it
+        std::unordered_map<int, PendingSave> flushing;
+        uint64_t flushesDone = 0;   // bumped when a written batch leaves `flushing`
+        std::chrono::steady_clock::time_point oldestPending{};
+        bool flushRequested = false;
+
+        // held while this shard's buffer is swapped out and written, so two
+        // flushes of the same characters never overtake each other
+        std::mutex flushMtx;
+    };
+
+    Shard& ShardForUser(std::string_view email);
+    Shard& ShardForCharacter(int characterId);
+
+    void Run(Shard& shard);
+    bool PushLoad(DbJob& j);
+    void CompleteLoad(const std::string& email, bool ok);
+    void RememberNoCharacters(const std::string& email);
+    void QueueSave(const std::string& characterId,
+                   int level, int xp, int credits, int potions, int highestWave);
+    bool SaveFlushDue(Shard& shard);
+    void FlushSaves(Shard& shard);
+    // lays buffered / in-flight saves over freshly read rows; false if a flush
+    // of one of their shards finished since `flushesBefore` (the read may be stale)
+    bool OverlayBufferedSaves(std::vector<Character>& chars, const std::vector<uint64_t>& flushesBefore);
+    std::vector<uint64_t> FlushesDone();
+
+    std::vector<std::unique_ptr<Shard>> shards_;
     std::atomic<bool> running_{false};
+
+    // ---- single-flight loads, guarded by loadMtx_ ----
+    std::mutex loadMtx_;
+    std::unordered_map<std::string, std::vector<std::function<void(bool)>>> inflightLoads_;
+    std::unordered_map<std::string, std::chrono::steady_clock::time_point> noCharactersUntil_;
+    CharacterLoadStats loadStats_;
+
+    std::atomic<uint64_t> saveRequests_{0};
+    std::atomic<uint64_t> droppedSaves_{0};
+    std::mutex statsMtx_;
+    CharacterSaveStats stats_;  // flush side
 };
@@ -4,8 +4,15 @@
 #include "character.h"
 
 
-void CommitCacheToDB();
+// Checkpoint: hands dirty cached characters to the DB worker (write-behind).
+// force=false: only users dirty for DARA_CHECKPOINT_MAX_AGE_MS, or all of them
+// once DARA_CHECKPOINT_MAX_DIRTY_USERS are dirty; force=true: everything.
+void CommitCacheToDB(bool force = false);
+// one user right away (player left the game)
+void CommitUserToDB(const std::string& userKey);
 void CacheSetCharactersForUser(const std::string& userKey, std::vector<Character> chars);
+// atomic "set unless cached": false if the user was cached already (that entry is kept)
+bool CacheSetCharactersForUserIfAbsent(const std::string& userKey, std::vector<Character> chars);
 bool HasCharactersCachedForUser(const std::string& userKey);
 
 std::optional<Character> CreateCharacterForUserAndCache(
@@ -44,6 +51,7 @@ static Character RecordToCharacter(const CharacterRecord& r)
     c.xp             = r.xp;
     c.credits        = r.credits;
     c.potions        = r.potions;
+    c.highestWave    = r.highestWave;
     c.createdAtIso   = r.storeTime; // or a proper ISO conversion
     return c;
 }
@@ -60,6 +68,19 @@ int CreateCharacter(const std::string& userId,
                     const std::string& avatar);
 
 void UpdateCharacter(int characterId, int level, int xp, int credits, int potions, int highestWave);
+
+// one row of a batched save (see CharacterDbWorker write-behind)
+struct CharacterSave
+{
+    int characterId = 0;
+    int level = 0;
+    int xp = 0;
+    int credits = 0;
+    int potions = 0;
+    int highestWave = 0;   // merged with GREATEST() like UpdateCharacter
+};
+// all rows in one transaction, DARA_DB_FLUSH_BATCH_ROWS per multi-row UPDATE; throws on error (rolled back)
+void UpdateCharactersBatch(const std::vector<CharacterSave>& rows);
 bool RemoveCharacter(std::string userKey, std::string characterId);
 
 
@@ -111,7 +132,6 @@ struct BestListsResult
     std::vector<MyPlace> myPlaces;
 };
 
-BestListsResult DbGetBestListsAndMyPlaces(const std::string& userEmail);
 json GetLeaderBoardsJson(const std::string eMail, int &status);
 
 
@@ -0,0 +1,59 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <cstdint>
+#include "CharacterRepository.h"
+
+// one character as the leaderboards need it (LeaderboardService::LoadFromDb)
+struct CharacterRankRow
+{
+    int characterId = 0;
+    std::string characterName;
+    std::string userEmail;
+    std::string avatar;
+    int highestWave = 0;
+    int level = 0;
+    int credits = 0;
+    int potions = 0;
+    int64_t ageSec = 0;        // seconds since the last save (StoreTime)
+};
+
+// =======================================================
+// Persistence backend behind CharacterRepository.
+// - MySqlCharacterStore: the Characters table via g_dbPool
+// - LocalCharacterStore: embedded single-file store (--no-persistence)
+// Implementations are thread-safe; errors are thrown (sql::SQLException /
+// std::runtime_error), the batch update is all-or-nothing.
+// =======================================================
+class ICharacterStore
+{
+public:
+    virtual ~ICharacterStore() = default;
+
+    virtual const char* Name() const = 0;
+
+    // returns the new CharacterId
+    virtual int CreateCharacter(const std::string& userId,
+                                const std::string& userEmail,
+                                const std::string& characterName,
+                                const std::string& characterClass,
+                                const std::string& avatar) = 0;
+    // newest first
+    virtual std::vector<CharacterRecord> GetCharactersForUser(const std::string& userEmail) = 0;
+    // unknown (deleted) ids are skipped; highestWave keeps the max
+    virtual void UpdateCharactersBatch(const std::vector<CharacterSave>& rows) = 0;
+    // true if the user had that character
+    virtual bool RemoveCharacter(const std::string& userId, int characterId) = 0;
+    // all characters of the (at most maxUsers, most recent first) users that saved
+    // within activeWithinSec; grouped by user, newest character first
+    virtual void ForEachCharacterOfActiveUsers(int64_t activeWithinSec, size_t maxUsers,
+                                               const std::function<void(CharacterRecord&&)>& fn) = 0;
+
+    // leaderboards
+    virtual std::vector<CharacterRankRow> GetRankRows() = 0;
+};
+
+// selected in main() from ServerOptions::noPersistence
+extern std::unique_ptr<ICharacterStore> g_characterStore;
@@ -6,6 +6,8 @@
 #include "MobTemplateStore.h"
 #include "CharacterRepository.h"
 #include "CharacterDbWorker.h"
+#include "character.h"
+#include "ProgressJournal.h"
 
 extern MobTemplateStore g_mobTemplates;
 extern CharacterDbWorker g_dbWorker;
@@ -111,7 +113,8 @@ void CombatDirector::AddOrUpdatePlayer(const std::string& playerName)
     Cv.notify_all();
 }
 
-void CombatDirector::AddOrUpdatePlayer(const std::string& playerName, Character selectedCharacter)
+void CombatDirector::AddOrUpdatePlayer(const std::string& playerName, Character selectedCharacter,
+                                       const std::string& ownerKey)
 {
     std::lock_guard<std::mutex> lock(CacheMutex);
 
@@ -140,6 +143,7 @@ void CombatDirector::AddOrUpdatePlayer(const std::string& playerName, Character
 
         p->InitName(playerName);
         p->InitId(selectedCharacter.characterId);
+        p->InitOwnerKey(ownerKey);
 
         p->InitLevel(selectedCharacter.level);
         p->InitXP(selectedCharacter.xp);
@@ -161,6 +165,7 @@ void CombatDirector::AddOrUpdatePlayer(const std::string& playerName, Character
     auto& p = it->second;
     p->InitName(playerName);
     p->InitId(selectedCharacter.characterId);
+    p->InitOwnerKey(ownerKey);
     p->InitLevel(selectedCharacter.level);
     p->InitXP(selectedCharacter.xp);
     p->InitCredits(selectedCharacter.credits);
@@ -275,9 +280,28 @@ bool CombatDirector::ApplyDamageToPlayerLocked(const std::string& playerName, fl
 
 
 
+void CombatDirector::RecordPlayerProgressLocked(Combatant& p)
+{
+    g_progressJournal.Append(p.GetId(), p.GetLevel(), p.GetXP(), p.GetCredits(), p.GetPotionAmount(), Wave);
+
+    // not cached (no owner / user evicted): fall back to the worker's write-behind buffer
+    if (!CacheRecordProgress(p.GetOwnerKey(), p.GetId(), p.GetLevel(), p.GetXP(), p.GetCredits(), p.GetPotionAmount(), Wave))
+        g_dbWorker.RequestSaveCharacter(p.GetId(), p.GetLevel(), p.GetXP(), p.GetCredits(), p.GetPotionAmount(), Wave);
+}
+
+void CombatDirector::CheckpointLeavingPlayerLocked(const std::string& playerName)
+{
+    auto it = Players.find(playerName);
+    if (it == Players.end() || !it->second) return;
+
+    RecordPlayerProgressLocked(*it->second);
+    CommitUserToDB(it->second->GetOwnerKey());
+}
+
 void CombatDirector::RemovePlayer(const std::string& playerName)
 {
     std::lock_guard<std::mutex> lk(CacheMutex);
+    CheckpointLeavingPlayerLocked(playerName);
     Players.erase(playerName);
     PendingActions.erase(playerName);
     BufferedActions.erase(playerName);
@@ -497,13 +521,7 @@ void CombatDirector::RegenMobs()
 
 void CombatDirector::ResolverLoop()
 {
-    static int dbUpdateCounter=0;
-    dbUpdateCounter++;
-    if(dbUpdateCounter>10){
-        CommitCacheToDB();
-        dbUpdateCounter=0;
-    }
-
+    // dirty characters are checkpointed by CharacterCheckpointer (g_checkpointer)
     while (Running.load())
     {
         std::vector<PlayerAction> actions;
@@ -902,9 +920,9 @@ void CombatDirector::RewardPlayersForMobDeath(
 
         if (Rand01(rng) < r.lootChance)
             MaybeGiveLoot(rng, p, mobName);
-        // only save if something changed or XP  has changed by 20 %
-        if (p.GetLevel()>CurrentLevel || p.GetXP()>CurrentXP*1.2 || p.GetPotionAmount()>CurrentPotions || p.GetCredits()>CurrentCredits){
-            g_dbWorker.RequestSaveCharacter(p.GetId(), p.GetLevel(), p.GetXP(), p.GetCredits(), p.GetPotionAmount(), Wave);
+        // only record if something changed; the checkpointer batches the DB writes
+        if (p.GetLevel()>CurrentLevel || p.GetXP()>CurrentXP || p.GetPotionAmount()>CurrentPotions || p.GetCredits()>CurrentCredits){
+            RecordPlayerProgressLocked(p);
         }
 
     }
@@ -1047,31 +1065,24 @@ void CombatDirector::BuildSpawnInfoMsg(std::string mobName, std::string  difficu
     InfoMsg= mobName+ " spawned. Danger Level: "+difficulty+" Attck Type:"+attackType;
 }
 
-static std::string MakeMobInstanceId(const std::string& templateId)
-{
-    std::string uuid = GenerateUUID();           // you already have this
-    return templateId + "-" + uuid.substr(0, 4); // short but unique enough for UI
-}
-
-void CombatDirector::SpawnMob(const std::string& templateId, int lane, int slot)
+void CombatDirector::SpawnMob(std::string_view templateId, int lane, int slot)
 {
     if (templateId.empty()) return;
 
     // IMPORTANT: assume CacheMutex already held by caller (ResolveMobs)
 
-    // Create instance from template (still using templateId to look up stats)
-    auto mob = g_mobTemplates.CreateMobInstancePtr(templateId, lane, slot);
-    if (!mob) return;
+    // recycled from this room's pool and reset from the template in place;
+    // if a hot reload removed the template meanwhile it just goes back to the pool
+    auto mob = MobInstances.Acquire();
+    if (!g_mobTemplates.Acquire()->InitMobInstance(*mob, templateId, lane, slot)) return;
 
-    // Assign instance id to the mob itself (add field + setter if missing)
-    const std::string instanceId = MakeMobInstanceId(templateId);
-    mob->SetInstanceId(instanceId);        // you add this
-    mob->SetTemplateId(templateId);        // optional but very useful
+    // cheap sequential instance id, unique within this room
+    MobInstances.AssignInstanceId(*mob, templateId);
 
     BuildSpawnInfoMsg(mob->GetName(), mob->GetDifficulty(), mob->GetAttackType());
 
     // Use instanceId as map key (no collision)
-    Mobs.emplace(instanceId, std::move(mob));
+    Mobs.emplace(mob->GetInstanceId(), std::move(mob));
 }
 
 
@@ -1086,27 +1097,28 @@ void CombatDirector::ResolveSpawnMobs()
     DaraLog("TURN", "Wave: " + std::to_string(Wave)+ " Turn: "+std::to_string(CurrentTurnId));
 
     if(!FilledSlotArray[0][slot] && ShallMobSpawn(CurrentTurnId) && !Players.empty() && MobToSpawnInWave>0){
-        std::string mobId;
+        // picks return views into this snapshot (no copies per spawn); holding
+        // it keeps them valid even if the templates are hot-reloaded meanwhile
+        const MobTemplateStore::SnapshotPtr templates = g_mobTemplates.Acquire();
         // do I need to spawn special stuff like a bomb?
         if(GetRandomFloat(0.f,1000.f)>(900.f-Wave)){
             int BombForWave= Wave/10+1000+1;
-            mobId = g_mobTemplates.PickRandomBossForWave(BombForWave);
-            if(mobId.empty()){
+            const std::string_view bombId = templates->PickRandomBombForWave(BombForWave);
+            if(bombId.empty()){
                 DaraLog("ERROR", "No Bomb found for "+ std::to_string(BombForWave));
             }else{
-                SpawnMob(mobId, 0, slot);
+                SpawnMob(bombId, 0, slot);
             }
         }
         
-        if (MobToSpawnInWave <= 1) {
-            mobId = g_mobTemplates.PickRandomBossForWave(Wave);
-        }else{
-            mobId = g_mobTemplates.PickRandomMobIdForWave(Wave);
-        }
+        // waves beyond the highest defined one fall back to it inside the store
+        std::string_view mobId = (MobToSpawnInWave <= 1)
+            ? templates->PickRandomBossForWave(Wave)
+            : templates->PickRandomMobIdForWave(Wave);
         MobToSpawnInWave--;
         if (mobId.empty()) {
             //throw std::runtime_error("No mob templates loaded");
-            mobId = g_mobTemplates.PickRandomMobId();
+            mobId = templates->PickRandomMobId();
             DaraLog("ERROR", "End of possible mob waves... you should add more");
         }
         SpawnMob(mobId, 0, slot);
@@ -1154,53 +1166,78 @@ void CombatDirector::ResolveMobs(const json& aiJson,
     if (!Mobs.empty())
         outTurnLog.push_back("Mobs act (placeholder).");
 
-    // Build a list of alive players (shared_ptrs)
-    std::vector<std::shared_ptr<Combatant>> alivePlayers;
+    // Alive players and acting mobs in name order, so a turn resolves the same
+    // way for the same rng sequence regardless of hash order (replays).
+    std::vector<std::pair<std::string_view, Combatant*>> alivePlayers;
     alivePlayers.reserve(Players.size());
     for (const auto& [playerName, p] : Players)
     {
         if (p && p->GetHP() > 0)
-            alivePlayers.push_back(p);
+            alivePlayers.emplace_back(playerName, p.get());
     }
 
     if (alivePlayers.empty())
         return;
 
+    std::vector<std::pair<std::string_view, Combatant*>> actingMobs;
+    actingMobs.reserve(Mobs.size());
+    for (const auto& [mobName, mob] : Mobs)
+    {
+        if (mob) actingMobs.emplace_back(mobName, mob.get());
+    }
+
+    auto byName = [](const auto& a, const auto& b){ return a.first < b.first; };
+    std::sort(alivePlayers.begin(), alivePlayers.end(), byName);
+    std::sort(actingMobs.begin(), actingMobs.end(), byName);
+
     static thread_local std::mt19937 rng{std::random_device{}()};
     std::uniform_int_distribution<size_t> pick(0, alivePlayers.size() - 1);
 
     float kDamage = 5.0f;
 
-    for (auto& [mobName, mob] : Mobs)
+    // 1) every mob computes its damage into a per-target accumulator
+    struct PendingDamage
     {
-        if (!mob) continue;
-        // Optional: skip dead mobs
-        // if (mob->GetHP() <= 0) continue;
-
-        auto target = alivePlayers[pick(rng)];
-        if (!target) continue;
+        float damage = 0.f;
+        int hits = 0;
+    };
+    std::vector<PendingDamage> pending(alivePlayers.size());
 
-        // Apply damage directly (NO second CacheMutex lock!)
+    for (const auto& [mobName, mob] : actingMobs)
+    {
         if(mob->ShouldAttack()){
-            if(DARA_DEBUG_MOBCOMBAT)DaraLog("COMBAT", mob->GetName()+" should attack randomly " + target->GetName()+" Mob AttackType:"+mob->GetAttackType());
-            mob->MobAttack(target);
-            ApplyDamageToPlayerLocked(target->GetName(), kDamage);
+            const size_t t = pick(rng);
+            const auto& [targetName, target] = alivePlayers[t];
+            if(DARA_DEBUG_MOBCOMBAT)DaraLog("COMBAT", mob->GetName()+" should attack randomly " + std::string(targetName)+" Mob AttackType:"+mob->GetAttackType());
+
+            const float dmg = mob->ComputeMobAttackDamage(*target) + kDamage;
+            pending[t].damage += dmg;
+            pending[t].hits++;
 
             // Log globally (turn log)
-            std::string logMsg= mobName + " attacks " + target->GetName() +
-                " for " + std::to_string((int)kDamage) + " dmg.";
-            outTurnLog.push_back(logMsg);
+            outTurnLog.push_back(std::string(mobName) + " attacks " + std::string(targetName) +
+                " for " + std::to_string((int)dmg) + " dmg.");
 
-            if(DARA_DEBUG_COMBAT) DaraLog("MobAttack", logMsg);
+            if(DARA_DEBUG_COMBAT) DaraLog("MobAttack", outTurnLog.back());
         }
         if(mob->ShouldExplode()){
-            for (const auto& explTarget : alivePlayers) {
-                if (!explTarget) continue;
-                mob->Explode(explTarget);
-
+            // AoE: every alive player takes a hit
+            for (size_t t = 0; t < alivePlayers.size(); ++t) {
+                pending[t].damage += mob->ComputeExplosionDamage(*alivePlayers[t].second);
+                pending[t].hits++;
             }
+            mob->MarkExploded();
         }
     }
+
+    // 2) one batched apply: a single clamp + condition update per player
+    for (size_t t = 0; t < alivePlayers.size(); ++t)
+    {
+        if (pending[t].hits == 0) continue;
+        alivePlayers[t].second->ApplyDamage(pending[t].damage);
+        if(DARA_DEBUG_MOBCOMBAT) DaraLog("COMBAT", "ApplyDamageToPlayer "+std::string(alivePlayers[t].first)+" "
+            +std::to_string(pending[t].damage)+" from "+std::to_string(pending[t].hits)+" hits");
+    }
     // second time as bombs could have exploded and are dead now
     // ResolveDeadMobs();  
 }
@@ -1386,6 +1423,7 @@ void CombatDirector::KickInactivePlayersLocked()
     for (const auto& name : toRemove)
     {
         DaraLog("LOGOUT", "Inactive timeout → removing " + name);
+        CheckpointLeavingPlayerLocked(name);
         Players.erase(name);
         PendingActions.erase(name);
         BufferedActions.erase(name);
@@ -3,6 +3,7 @@
 #include <unordered_map>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <mutex>
 #include <condition_variable>
 #include <chrono>
@@ -15,6 +16,7 @@
 #include "combatant.h"
 #include "DaraConfig.h"
 #include "character.h"
+#include "MobPool.h"
 
 enum class EGamePhase
 {
@@ -65,7 +67,9 @@ public:
 
     // Player/mob management (call when joining/leaving/spawning)
     void AddOrUpdatePlayer(const std::string& playerName);
-    void AddOrUpdatePlayer(const std::string& playerName, Character selectedCharacter);
+    // ownerKey: character cache key (email) of the user, progress is checkpointed there
+    void AddOrUpdatePlayer(const std::string& playerName, Character selectedCharacter,
+                           const std::string& ownerKey = {});
     bool ApplyDamageToPlayer(const std::string& playerName, float dmg);
     bool ApplyDamageToPlayerLocked(const std::string& playerName, float dmg);
     void RemovePlayer(const std::string& playerName);
@@ -73,7 +77,7 @@ public:
     json GetPlayerStateJson(const std::string& playerName) const;
 
     void AddOrUpdateMob(const std::string& mobName);
-    void SpawnMob(const std::string& mobId, int lane, int slot);
+    void SpawnMob(std::string_view mobId, int lane, int slot);
 
     bool ApplyDamageToMob(const std::string& mobName, float dmg, std::string* err);
     void RemoveMob(const std::string& mobName);
@@ -169,6 +173,11 @@ private:
 
     void KickInactivePlayersLocked();
 
+    // progress (incl. current Wave) goes to the character cache for the checkpointer;
+    // on leave it is handed to the DB worker right away
+    void RecordPlayerProgressLocked(Combatant& p);
+    void CheckpointLeavingPlayerLocked(const std::string& playerName);
+
 
 
 private:
@@ -187,6 +196,7 @@ private:
 
     std::unordered_map<std::string, std::shared_ptr<Combatant>> Players;
     std::unordered_map<std::string, std::shared_ptr<Combatant>> Mobs;
+    MobPool MobInstances; // owns every mob object of this room, see MobPool.h
 
     bool FilledSlotArray[MAX_LANES][MAX_SLOTS];
     int OpenSlotAmount=0;
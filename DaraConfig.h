@@ -1,6 +1,10 @@
 #pragma once
 #include <iostream>
 #include <iomanip>
+#include <string>
+#include <string_view>
+#include <chrono>
+#include <ctime>
 
 inline constexpr int WEBSERVER_PORT= 9050;
 inline constexpr int PLAYERS_EXPECTED= 1;
@@ -25,12 +29,107 @@ inline constexpr int DARA_DEBUG_FULLSTATE= 0;
 inline constexpr int DARA_MAX_MOBS= 4;
 inline constexpr int DARA_MOBS_WAVE1= 5;
 inline constexpr int DARA_MAX_MOBS_PERWAVE= 15;
+inline constexpr int DARA_MOB_POOL_PREWARM= 16; // mob objects per room allocated up front
 
 inline constexpr int DARA_TURN_TIMEOUT= 3000;
 inline constexpr int DARA_GAMEOVER_PAUSE=10000;
 inline constexpr int DARA_WAVECOMPLETED_PAUSE=5; // in turns not in seconds;
 
 
+// MySQL connection pool (DbConnectionPool)
+inline constexpr int DARA_DB_POOL_SIZE= 8;           // >= DARA_DB_WORKER_THREADS + request threads querying directly
+inline constexpr int DARA_DB_POOL_ACQUIRE_TIMEOUT_MS= 2000;
+inline constexpr int DARA_DB_POOL_VALIDATE_IDLE_SEC= 30;    // isValid() before reusing a connection idle this long
+inline constexpr int DARA_DB_RECONNECT_BACKOFF_MIN_MS= 250;
+inline constexpr int DARA_DB_RECONNECT_BACKOFF_MAX_MS= 30000;
+
+// CharacterDbWorker: jobs and saves are sharded over this many threads by user/character key
+inline constexpr int DARA_DB_WORKER_THREADS= 4;
+
+// per shard job queue (DbJobQueue), rounded up to a power of two
+inline constexpr int DARA_DB_QUEUE_CAPACITY= 1024;            // interactive lane (loads), full = rejected
+inline constexpr int DARA_DB_BACKGROUND_QUEUE_CAPACITY= 16;   // background lane (flush requests), full = coalesced
+
+// write-behind character saves (CharacterDbWorker)
+inline constexpr int DARA_DB_FLUSH_INTERVAL_MS= 2000;   // oldest buffered save waits at most this long
+inline constexpr int DARA_DB_FLUSH_MAX_ROWS= 64;        // flush early once this many characters are buffered
+inline constexpr int DARA_DB_FLUSH_BATCH_ROWS= 32;      // rows per multi-row UPDATE
+inline constexpr int DARA_DB_SAVE_BUFFER_MAX= 10000;    // per shard; beyond it (DB stalled) the oldest buffered save is dropped
+
+// character cache (CharacterCache): striped locks, LRU eviction above the cap (dirty users stay)
+inline constexpr int DARA_CHAR_CACHE_SHARDS= 16;
+inline constexpr size_t DARA_CHAR_CACHE_MAX_BYTES= 64u * 1024 * 1024;
+
+// checkpointer (CharacterCheckpointer): dirty cached characters reach the DB worker
+// after at most DARA_CHECKPOINT_MAX_AGE_MS (+ one interval). Progress is already
+// durable in the journal, so this only bounds how far MySQL lags behind
+inline constexpr int DARA_CHECKPOINT_INTERVAL_MS= 1000;
+inline constexpr int DARA_CHECKPOINT_MAX_AGE_MS= 30000;
+inline constexpr int DARA_CHECKPOINT_MAX_DIRTY_USERS= 256;   // checkpoint everything right away beyond this
+
+// embedded character store (LocalCharacterStore, --no-persistence): the log is
+// rewritten once it is this large and mostly superseded records
+inline constexpr size_t DARA_LOCAL_STORE_COMPACT_BYTES= 16u * 1024 * 1024;
+
+// local progress journal (ProgressJournal): group commit (write + fsync) interval,
+// i.e. the progress a crash can lose; rewritten with the unsaved states beyond the size
+inline constexpr std::string_view DARA_JOURNAL_PATH= "progress.journal";
+inline constexpr int DARA_JOURNAL_SYNC_MS= 50;
+inline constexpr size_t DARA_JOURNAL_COMPACT_BYTES= 4u * 1024 * 1024;
+
+// character loads: one in flight per user, "has no characters" is remembered this long
+inline constexpr int DARA_DB_NEGATIVE_CACHE_MS= 5000;
+// login does not wait for the character prefetch; clients re-poll /characters this often
+inline constexpr int DARA_CHARACTERS_POLL_MS= 250;
+
+// startup warm-up (CacheWarmup): characters of users active this recently are
+// preloaded; server.listen waits at most DARA_WARMUP_WAIT_MS for it, /ready says when done
+inline constexpr int DARA_WARMUP_ACTIVE_HOURS= 24;
+inline constexpr size_t DARA_WARMUP_MAX_USERS= 5000;
+inline constexpr int DARA_WARMUP_WAIT_MS= 5000;
+
+// session store (SessionStore): shared-locked reads, copy-on-write updates per shard
+inline constexpr int DARA_SESSION_SHARDS= 64;
+// session sweeper (SessionSweeper): expired sessions are removed this often, at
+// most DARA_SESSION_SWEEP_BATCH per shard and round (the rest go next round)
+inline constexpr int DARA_SESSION_SWEEP_INTERVAL_MS= 5000;
+inline constexpr int DARA_SESSION_SWEEP_BATCH= 256;
+// session snapshot (SessionSnapshot): written by the sweeper this often when the
+// store changed, and on shutdown; reloaded before listen
+inline constexpr std::string_view DARA_SESSION_SNAPSHOT_PATH= "sessions.snapshot";
+inline constexpr int DARA_SESSION_SNAPSHOT_INTERVAL_MS= 30000;
+
+// Google signing keys (GoogleKeyCache): refreshed in the background at this share
+// of the JWKS max-age; a failed refresh retries every DARA_JWKS_RETRY_MS and the
+// old keys stay in use for DARA_JWKS_MAX_STALE_SEC past max-age
+inline constexpr int DARA_JWKS_REFRESH_AT_PERCENT= 80;
+inline constexpr int DARA_JWKS_RETRY_MS= 5000;
+inline constexpr int DARA_JWKS_MAX_STALE_SEC= 24 * 3600;
+inline constexpr int DARA_JWKS_KID_REFRESH_MIN_MS= 10000;   // unknown kid: early refresh at most this often
+// verified Google ID tokens (auth.cpp): claims cached by token hash until exp, LRU beyond this
+inline constexpr size_t DARA_ID_TOKEN_CACHE_MAX= 10000;
+
+// HTTP request pipeline (RequestPipeline): requests slower than this are logged
+inline constexpr int DARA_HTTP_SLOW_MS= 250;
+// HTTP workers (HttpLoadControl): connections beyond the queue go to the overflow workers.
+// MySQL-backed routes run at most DARA_HTTP_SLOW_ROUTES_MAX at once, DARA_HTTP_SLOW_ROUTES_QUEUE more
+// wait up to DARA_HTTP_SLOW_ROUTES_WAIT_MS, the rest get 503 + Retry-After
+inline constexpr int DARA_HTTP_THREADS= 32;   // a keep-alive connection holds one while open
+inline constexpr int DARA_HTTP_QUEUE_MAX= 256;
+inline constexpr int DARA_HTTP_KEEP_ALIVE_TIMEOUT_SEC= 2;   // an idle connection gives its worker back after this
+// worker queue full: DARA_HTTP_OVERFLOW_THREADS answer up to DARA_HTTP_OVERFLOW_QUEUE_MAX more
+// connections with 503 + Retry-After, beyond that they are closed unanswered
+inline constexpr int DARA_HTTP_OVERFLOW_THREADS= 2;
+inline constexpr int DARA_HTTP_OVERFLOW_QUEUE_MAX= 256;
+inline constexpr int DARA_HTTP_SLOW_ROUTES_MAX= 4;
+inline constexpr int DARA_HTTP_SLOW_ROUTES_QUEUE= 8;
+inline constexpr int DARA_HTTP_SLOW_ROUTES_WAIT_MS= 1000;
+inline constexpr int DARA_HTTP_RETRY_AFTER_SEC= 1;
+
+// in-memory leaderboards (LeaderboardService)
+inline constexpr int DARA_LEADERBOARD_TOP_N= 3;
+inline constexpr int DARA_LEADERBOARD_WEEK_SEC= 7 * 24 * 3600;   // "weekly" = saved within this window
+
 inline constexpr std::string_view DARA_DEAD_AVATAR_PLAYER = "Dead";
 inline constexpr std::string_view DARA_DEAD_AVATAR_MOB= "Dead";
 inline constexpr std::string_view DARA_MOB_STORE= "mobs/mobdb.json";
@@ -0,0 +1,234 @@
+#include <mysql_driver.h>
+#include <mysql_connection.h>
+#include <cppconn/prepared_statement.h>
+#include <cppconn/exception.h>
+
+#include <cstdlib>
+#include <exception>
+#include <stdexcept>
+#include <algorithm>
+#include "DbConnectionPool.h"
+
+// =============================
+// Lease
+// =============================
+
+DbConnectionPool::Lease::Lease(DbConnectionPool* pool, std::unique_ptr<PooledConnection> conn)
+    : Pool(pool), Conn(std::move(conn)), UncaughtAtStart(std::uncaught_exceptions())
+{
+}
+
+DbConnectionPool::Lease::Lease(Lease&& other) noexcept
+    : Pool(other.Pool), Conn(std::move(other.Conn)), UncaughtAtStart(other.UncaughtAtStart)
+{
+    other.Pool = nullptr;
+}
+
+DbConnectionPool::Lease::~Lease()
+{
+    if (!Pool || !Conn) return;
+
+    // unwinding from a query: the error may be a dead connection ("server has
+    // gone away"), so only keep it if it still answers
+    bool healthy = true;
+    if (std::uncaught_exceptions() > UncaughtAtStart)
+        healthy = IsValid(*Conn);
+
+    Pool->Release(std::move(Conn), healthy);
+}
+
+sql::PreparedStatement* DbConnectionPool::Lease::Prepare(const std::string& sqlText)
+{
+    auto it = Conn->statements.find(sqlText);
+    if (it != Conn->statements.end()) {
+        it->second->clearParameters();
+        return it->second.get();
+    }
+
+    std::unique_ptr<sql::PreparedStatement> stmt(Conn->con->prepareStatement(sqlText));
+    sql::PreparedStatement* raw = stmt.get();
+    Conn->statements.emplace(sqlText, std::move(stmt));
+    return raw;
+}
+
+// =============================
+// Pool
+// =============================
+
+DbConnectionPool::DbConnectionPool()
+    : MaxConnections(DARA_DB_POOL_SIZE)
+    , AcquireTimeout(DARA_DB_POOL_ACQUIRE_TIMEOUT_MS)
+    , ValidateAfterIdle(DARA_DB_POOL_VALIDATE_IDLE_SEC)
+{
+}
+
+DbConnectionPool::~DbConnectionPool()
+{
+    Shutdown();
+}
+
+void DbConnectionPool::Shutdown()
+{
+    std::vector<std::unique_ptr<PooledConnection>> idle;
+    {
+        std::lock_guard<std::mutex> lk(Mutex);
+        idle.swap(Idle);
+        Open -= idle.size();
+    }
+    // statements before their connection
+    for (auto& c : idle) c->statements.clear();
+}
+
+size_t DbConnectionPool::OpenConnections() const
+{
+    std::lock_guard<std::mutex> lk(Mutex);
+    return Open;
+}
+
+size_t DbConnectionPool::IdleConnections() const
+{
+    std::lock_guard<std::mutex> lk(Mutex);
+    return Idle.size();
+}
+
+static std::string GetEnvOrThrow(const char* key)
+{
+    const char* val = std::getenv(key);
+    if (!val || !*val)
+        throw std::runtime_error(std::string("Missing env var: ") + key);
+    return val;
+}
+
+void DbConnectionPool::LoadConfigLocked()
+{
+    if (ConfigLoaded) return;
+    Host   = GetEnvOrThrow("DARA_DB_HOST");   // e.g. tcp://127.0.0.1:3306
+    User   = GetEnvOrThrow("DARA_DB_USER");
+    Pass   = GetEnvOrThrow("DARA_DB_PASS");
+    Schema = GetEnvOrThrow("DARA_DB_NAME");   // e.g. darawebgame
+    ConfigLoaded = true;
+}
+
+bool DbConnectionPool::IsValid(PooledConnection& conn)
+{
+    try {
+        return conn.con && !conn.con->isClosed() && conn.con->isValid();
+    }
+    catch (...) {
+        return false;
+    }
+}
+
+std::unique_ptr<DbConnectionPool::PooledConnection> DbConnectionPool::Connect()
+{
+    // config is immutable once loaded, reading it without the lock is fine
+    try
+    {
+        sql::mysql::MySQL_Driver* driver = sql::mysql::get_mysql_driver_instance();
+
+        auto conn = std::make_unique<PooledConnection>();
+        conn->con.reset(driver->connect(Host, User, Pass));
+        conn->con->setSchema(Schema);
+        conn->con->setAutoCommit(true);
+        conn->lastUsed = std::chrono::steady_clock::now();
+        return conn;
+    }
+    catch (const sql::SQLException& e)
+    {
+        DaraLog("DB", std::string("Connect failed: ") + e.what() +
+                      " | MySQL error code=" + std::to_string(e.getErrorCode()) +
+                      " | SQLState=" + e.getSQLStateCStr());
+        throw; // rethrow so caller knows it failed
+    }
+}
+
+DbConnectionPool::Lease DbConnectionPool::Acquire()
+{
+    using clock = std::chrono::steady_clock;
+    const auto deadline = clock::now() + AcquireTimeout;
+
+    std::unique_lock<std::mutex> lk(Mutex);
+    LoadConfigLocked();
+
+    while (true)
+    {
+        // 1) reuse an idle connection (most recently used first)
+        if (!Idle.empty())
+        {
+            std::unique_ptr<PooledConnection> conn = std::move(Idle.back());
+            Idle.pop_back();
+            lk.unlock();
+
+            if (clock::now() - conn->lastUsed < ValidateAfterIdle || IsValid(*conn))
+                return Lease(this, std::move(conn));
+
+            DaraLog("DB", "Dropping stale pooled connection");
+            conn.reset();
+            lk.lock();
+            --Open;
+            continue;
+        }
+
+        // 2) open a new one if we are below the limit
+        if (Open < MaxConnections)
+        {
+            const auto now = clock::now();
+            if (now < RetryAfter) {
+                const auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(RetryAfter - now);
+                throw std::runtime_error("DB unavailable, reconnect backoff for another "
+                                         + std::to_string(wait.count()) + "ms");
+            }
+
+            ++Open;
+            lk.unlock();
+            try
+            {
+                auto conn = Connect();
+                lk.lock();
+                Backoff = std::chrono::milliseconds(DARA_DB_RECONNECT_BACKOFF_MIN_MS);
+                RetryAfter = {};
+                DaraLog("DB", "Opened pooled connection (" + std::to_string(Open) + "/"
+                              + std::to_string(MaxConnections) + ") db=" + Schema);
+                lk.unlock();
+                return Lease(this, std::move(conn));
+            }
+            catch (...)
+            {
+                lk.lock();
+                --Open;
+                RetryAfter = clock::now() + Backoff;
+                DaraLog("DB", "Reconnect backoff " + std::to_string(Backoff.count()) + "ms");
+                Backoff = std::min(Backoff * 2, std::chrono::milliseconds(DARA_DB_RECONNECT_BACKOFF_MAX_MS));
+                Cv.notify_one();
+                throw;
+            }
+        }
+
+        // 3) all connections leased: wait for a release
+        if (Cv.wait_until(lk, deadline) == std::cv_status::timeout
+            && Idle.empty() && Open >= MaxConnections)
+        {
+            throw std::runtime_error("DB pool exhausted (" + std::to_string(MaxConnections)
+                                     + " connections busy)");
+        }
+    }
+}
+
+void DbConnectionPool::Release(std::unique_ptr<PooledConnection> conn, bool healthy)
+{
+    if (healthy)
+    {
+        conn->lastUsed = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lk(Mutex);
+        Idle.push_back(std::move(conn));
+    }
+    else
+    {
+        DaraLog("DB", "Dropping broken pooled connection");
+        conn->statements.clear();
+        conn.reset();
+        std::lock_guard<std::mutex> lk(Mutex);
+        --Open;
+    }
+    Cv.notify_one();
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <unordered_map>
+#include "DaraConfig.h"
+
+namespace sql {
+class Connection;
+class PreparedStatement;
+}
+
+// =======================================================
+// Bounded pool of MySQL connections (DARA_DB_* env vars).
+// - at most DARA_DB_POOL_SIZE connections, Acquire() waits for a free one
+// - a connection idle for longer than DARA_DB_POOL_VALIDATE_IDLE_SEC is checked
+//   with isValid() before it is handed out, dead ones are replaced
+// - failed connects back off exponentially, so a down DB is not hammered
+// - every connection keeps its prepared statements (keyed by SQL text)
+// Errors are thrown (std::runtime_error / sql::SQLException) like the
+// repository functions always did.
+// =======================================================
+class DbConnectionPool
+{
+    struct PooledConnection
+    {
+        std::unique_ptr<sql::Connection> con;
+        std::unordered_map<std::string, std::unique_ptr<sql::PreparedStatement>> statements;
+        std::chrono::steady_clock::time_point lastUsed;
+    };
+
+public:
+    // RAII handle: the connection goes back to the pool when the lease dies.
+    // If it dies because of an exception and the connection is no longer
+    // valid, it is dropped instead.
+    class Lease
+    {
+    public:
+        Lease(Lease&& other) noexcept;
+        Lease& operator=(Lease&&) = delete;
+        ~Lease();
+
+        sql::Connection* operator->() const { return Conn->con.get(); }
+        sql::Connection* Get() const { return Conn->con.get(); }
+
+        // cached prepared statement for this connection; parameters are cleared,
+        // the pointer stays owned by the pool
+        sql::PreparedStatement* Prepare(const std::string& sqlText);
+
+    private:
+        friend class DbConnectionPool;
+        Lease(DbConnectionPool* pool, std::unique_ptr<PooledConnection> conn);
+
+        DbConnectionPool* Pool = nullptr;
+        std::unique_ptr<PooledConnection> Conn;
+        int UncaughtAtStart = 0;
+    };
+
+    DbConnectionPool();
+    ~DbConnectionPool();
+
+    DbConnectionPool(const DbConnectionPool&) = delete;
+    DbConnectionPool& operator=(const DbConnectionPool&) = delete;
+
+    // throws if no connection could be obtained within DARA_DB_POOL_ACQUIRE_TIMEOUT_MS,
+    // the DB is in reconnect backoff, or connecting fails
+    Lease Acquire();
+
+    // closes idle connections (call before the mysql driver goes away)
+    void Shutdown();
+
+    size_t OpenConnections() const;
+    size_t IdleConnections() const;
+
+private:
+    std::unique_ptr<PooledConnection> Connect();
+    void Release(std::unique_ptr<PooledConnection> conn, bool healthy);
+    static bool IsValid(PooledConnection& conn);
+    void LoadConfigLocked();
+
+    const size_t MaxConnections;
+    const std::chrono::milliseconds AcquireTimeout;
+    const std::chrono::seconds ValidateAfterIdle;
+
+    mutable std::mutex Mutex;
+    std::condition_variable Cv;
+    std::vector<std::unique_ptr<PooledConnection>> Idle;
+    size_t Open = 0; // idle + leased + connecting
+
+    // reconnect backoff
+    std::chrono::milliseconds Backoff{DARA_DB_RECONNECT_BACKOFF_MIN_MS};
+    std::chrono::steady_clock::time_point RetryAfter{};
+
+    // read once from the environment
+    bool ConfigLoaded = false;
+    std::string Host, User, Pass, Schema;
+};
+
+extern DbConnectionPool g_dbPool;
@@ -1,29 +1,215 @@
 #include "DbJobQueue.h"
+#include <thread>
 
-void DbJobQueue::Push(DbJob j)
+// =============================
+// Ring
+// =============================
+
+static size_t RoundUpPow2(size_t v)
+{
+    size_t p = 2;
+    while (p < v) p <<= 1;
+    return p;
+}
+
+DbJobQueue::Ring::Ring(size_t capacity)
+{
+    const size_t n = RoundUpPow2(capacity);
+    cells_ = std::make_unique<Cell[]>(n);
+    mask_ = n - 1;
+    for (size_t i = 0; i < n; ++i)
+        cells_[i].seq.store(i, std::memory_order_relaxed);
+}
+
+bool DbJobQueue::Ring::TryPush(DbJob& j)
 {
+    size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+    while (true)
     {
-        std::lock_guard<std::mutex> lock(mtx_);
-        q_.push(std::move(j));
+        Cell& cell = cells_[pos & mask_];
+        const size_t seq = cell.seq.load(std::memory_order_acquire);
+        const intptr_t dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+        if (dif == 0)
+        {
+            // claim the slot, then publish it
+            if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                cell.job = std::move(j);
+                cell.seq.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if (dif < 0)
+        {
+            return false; // full
+        }
+        else
+        {
+            pos = enqueuePos_.load(std::memory_order_relaxed);
+        }
     }
-    cv_.notify_one();
 }
 
-bool DbJobQueue::PopWait(DbJob& out)
+bool DbJobQueue::Ring::TryPop(DbJob& out)
 {
-    std::unique_lock<std::mutex> lock(mtx_);
-    cv_.wait(lock, [&]{ return stop_ || !q_.empty(); });
-    if (stop_ && q_.empty()) return false;
-    out = std::move(q_.front());
-    q_.pop();
+    const size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+    Cell& cell = cells_[pos & mask_];
+    const size_t seq = cell.seq.load(std::memory_order_acquire);
+    if (static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1) < 0)
+        return false; // empty (or the producer has not published yet)
+
+    out = std::move(cell.job);
+    cell.job = DbJob{}; // drop captured state now, not when the slot is reused
+    cell.seq.store(pos + mask_ + 1, std::memory_order_release);
+    dequeuePos_.store(pos + 1, std::memory_order_relaxed);
     return true;
 }
 
-void DbJobQueue::Stop()
+size_t DbJobQueue::Ring::Depth() const
+{
+    const size_t enq = enqueuePos_.load(std::memory_order_relaxed);
+    const size_t deq = dequeuePos_.load(std::memory_order_relaxed);
+    return enq > deq ? enq - deq : 0;
+}
+
+// =============================
+// Queue
+// =============================
+
+DbJobQueue::DbJobQueue(size_t interactiveCapacity, size_t backgroundCapacity)
+    : interactive_(interactiveCapacity)
+    , background_(backgroundCapacity)
+{
+}
+
+void DbJobQueue::WakeConsumer()
+{
+    // only whoever flips idle -> busy releases, so the semaphore never exceeds 1
+    if (consumerIdle_.exchange(false, std::memory_order_acq_rel))
+        wake_.release();
+}
+
+bool DbJobQueue::Push(DbJob& j, EDbLane lane, EDbOverflowPolicy policy)
+{
+    // registered before the stop check (both seq_cst): either Stop() comes
+    // first and we reject, or the consumer's final drain waits for this push
+    pushing_.fetch_add(1, std::memory_order_seq_cst);
+    if (stop_.load(std::memory_order_seq_cst)) {
+        pushing_.fetch_sub(1, std::memory_order_release);
+        rejected_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    j.enqueuedAt = std::chrono::steady_clock::now();
+    Ring& ring = (lane == EDbLane::Interactive) ? interactive_ : background_;
+    const bool pushed = ring.TryPush(j);
+    pushing_.fetch_sub(1, std::memory_order_release);
+    if (!pushed)
+    {
+        if (policy == EDbOverflowPolicy::Coalesce) {
+            coalesced_.fetch_add(1, std::memory_order_relaxed);
+            WakeConsumer();
+            return true;
+        }
+        rejected_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    pushed_.fetch_add(1, std::memory_order_relaxed);
+    WakeConsumer();
+    return true;
+}
+
+bool DbJobQueue::TryPop(DbJob& out)
+{
+    const bool preferBackground = interactiveBurst_ >= kMaxInteractiveBurst;
+    bool fromBackground = false;
+    bool got = false;
+    if (preferBackground)
+    {
+        got = fromBackground = background_.TryPop(out);
+        if (!got) got = interactive_.TryPop(out);
+    }
+    else
+    {
+        got = interactive_.TryPop(out);
+        if (!got) got = fromBackground = background_.TryPop(out);
+    }
+    if (!got) return false;
+
+    interactiveBurst_ = fromBackground ? 0 : interactiveBurst_ + 1;
+    popped_.fetch_add(1, std::memory_order_relaxed);
+
+    const uint64_t waitUs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - out.enqueuedAt).count());
+    waitUsTotal_.fetch_add(waitUs, std::memory_order_relaxed);
+    if (waitUs > waitUsMax_.load(std::memory_order_relaxed))
+        waitUsMax_.store(waitUs, std::memory_order_relaxed); // single consumer
+    return true;
+}
+
+bool DbJobQueue::PopWait(DbJob& out)
 {
+    while (true)
     {
-        std::lock_guard<std::mutex> lock(mtx_);
-        stop_ = true;
+        if (PopWaitFor(out, std::chrono::milliseconds(1000))) return true;
+        if (IsStopped()) return false;
     }
-    cv_.notify_all();
+}
+
+bool DbJobQueue::PopWaitFor(DbJob& out, std::chrono::milliseconds timeout)
+{
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (true)
+    {
+        if (TryPop(out)) return true;
+        if (stop_.load(std::memory_order_seq_cst)) {
+            // drain what was published before Stop(), including pushes that
+            // passed their stop check just before it
+            while (pushing_.load(std::memory_order_acquire) > 0) std::this_thread::yield();
+            return TryPop(out);
+        }
+
+        // announce we sleep, then look once more so a push in between is not missed
+        consumerIdle_.store(true, std::memory_order_seq_cst);
+        const bool got = TryPop(out);
+        if (got || IsStopped())
+        {
+            // a producer may already have flipped idle and owes us a release
+            if (!consumerIdle_.exchange(false, std::memory_order_acq_rel)) wake_.acquire();
+            if (got) return true;
+            continue;   // stopped: the final drain above
+        }
+
+        const bool woken = wake_.try_acquire_until(deadline);
+        if (!woken)
+        {
+            if (!consumerIdle_.exchange(false, std::memory_order_acq_rel)) wake_.acquire();
+            if (TryPop(out)) return true;
+            if (!IsStopped()) return false;
+            continue;
+        }
+        // woken: loop and pop (a producer's job may still be publishing, retry)
+        std::this_thread::yield();
+    }
+}
+
+void DbJobQueue::Stop()
+{
+    stop_.store(true, std::memory_order_seq_cst);
+    WakeConsumer();
+}
+
+DbQueueStats DbJobQueue::GetStats() const
+{
+    DbQueueStats s;
+    s.pushed    = pushed_.load(std::memory_order_relaxed);
+    s.popped    = popped_.load(std::memory_order_relaxed);
+    s.rejected  = rejected_.load(std::memory_order_relaxed);
+    s.coalesced = coalesced_.load(std::memory_order_relaxed);
+    s.depthInteractive = interactive_.Depth();
+    s.depthBackground  = background_.Depth();
+    s.avgQueueWaitMs = s.popped ? waitUsTotal_.load(std::memory_order_relaxed) / 1000.0 / s.popped : 0.0;
+    s.maxQueueWaitMs = waitUsMax_.load(std::memory_order_relaxed) / 1000.0;
+    return s;
 }
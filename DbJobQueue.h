@@ -1,16 +1,33 @@
 #pragma once
 #include <string>
-#include <queue>
-#include <mutex>
-#include <condition_variable>
+#include <memory>
+#include <atomic>
+#include <semaphore>
 #include <utility>
 #include <functional>
+#include <chrono>
+#include <cstdint>
+#include "DaraConfig.h"
 
+// saves are not queued as jobs, they are coalesced by CharacterDbWorker
 enum class EDbJobType
 {
     LoadUserCharacters,
-    SaveCharacter,
-    SavePlayerCharacter
+    FlushSaves          // write the buffered saves now (size threshold hit)
+};
+
+// interactive = someone waits for it (login, /characters), background = flushes
+enum class EDbLane
+{
+    Interactive,
+    Background
+};
+
+// what Push does when the lane is full
+enum class EDbOverflowPolicy
+{
+    Reject,     // Push returns false, the caller reports the error (loads)
+    Coalesce    // job is redundant with one already queued (flushes): dropped, Push returns true
 };
 
 struct DbJob
@@ -18,27 +35,92 @@ struct DbJob
     EDbJobType type;
     std::string userEmail;
 
-    // for SavePlayerCharacter:
-    std::string characterId= "unknown characterId";
-    int level = 0;
-    int xp = 0;
-    int credits = 0;
-    int potions = 0;
-    int highestWave= 0;
-
     std::function<void(bool ok)> done={}; 
+
+    std::chrono::steady_clock::time_point enqueuedAt{}; // set by Push
+};
+
+struct DbQueueStats
+{
+    uint64_t pushed = 0;
+    uint64_t popped = 0;
+    uint64_t rejected = 0;         // Reject policy, lane full
+    uint64_t coalesced = 0;        // Coalesce policy, lane full
+    size_t depthInteractive = 0;
+    size_t depthBackground = 0;
+    double avgQueueWaitMs = 0.0;   // enqueue -> dequeue
+    double maxQueueWaitMs = 0.0;
 };
 
+// =======================================================
+// Bounded MPSC job queue: two lock-free rings (Vyukov-style sequence cells),
+// many producers, one consumer thread. Producers never take a lock; the
+// consumer sleeps on a semaphore that is only released when it is idle.
+// =======================================================
 class DbJobQueue
 {
 public:
-    void Push(DbJob j);
+    DbJobQueue(size_t interactiveCapacity = DARA_DB_QUEUE_CAPACITY,
+               size_t backgroundCapacity = DARA_DB_BACKGROUND_QUEUE_CAPACITY);
+
+    DbJobQueue(const DbJobQueue&) = delete;
+    DbJobQueue& operator=(const DbJobQueue&) = delete;
+
+    // false = rejected (lane full and policy Reject, or stopped); the job is untouched then
+    bool Push(DbJob& j, EDbLane lane = EDbLane::Interactive,
+              EDbOverflowPolicy policy = EDbOverflowPolicy::Reject);
+
+    // consumer thread only
     bool PopWait(DbJob& out);
+    // false on timeout or once stopped and drained
+    bool PopWaitFor(DbJob& out, std::chrono::milliseconds timeout);
+
     void Stop();
+    bool IsStopped() const { return stop_.load(std::memory_order_acquire); }
+
+    DbQueueStats GetStats() const;
 
 private:
-    std::queue<DbJob> q_;
-    std::mutex mtx_;
-    std::condition_variable cv_;
-    bool stop_ = false;
-};
\ No newline at end of file
+    class Ring
+    {
+    public:
+        explicit Ring(size_t capacity);
+        bool TryPush(DbJob& j);
+        bool TryPop(DbJob& out);   // single consumer
+        size_t Depth() const;
+
+    private:
+        struct Cell
+        {
+            std::atomic<size_t> seq;
+            DbJob job;
+        };
+        std::unique_ptr<Cell[]> cells_;
+        size_t mask_;
+        alignas(64) std::atomic<size_t> enqueuePos_{0};
+        alignas(64) std::atomic<size_t> dequeuePos_{0};
+    };
+
+    // interactive first; after kMaxInteractiveBurst in a row a waiting
+    // background job gets its turn so flushes cannot starve
+    static constexpr int kMaxInteractiveBurst = 8;
+    bool TryPop(DbJob& out);
+    void WakeConsumer();
+
+    Ring interactive_;
+    Ring background_;
+    int interactiveBurst_ = 0;     // consumer only
+
+    std::atomic<bool> stop_{false};
+    std::atomic<int> pushing_{0};   // producers between their stop check and the push
+    std::atomic<bool> consumerIdle_{false};
+    std::binary_semaphore wake_{0};
+
+    // counters
+    std::atomic<uint64_t> pushed_{0};
+    std::atomic<uint64_t> popped_{0};
+    std::atomic<uint64_t> rejected_{0};
+    std::atomic<uint64_t> coalesced_{0};
+    std::atomic<uint64_t> waitUsTotal_{0};
+    std::atomic<uint64_t> waitUsMax_{0};
+};
@@ -0,0 +1,297 @@
+#include "GoogleKeyCache.h"
+
+#include <cpr/cpr.h>
+#include "json.hpp"
+
+// jwt-cpp (you must add this dependency)
+#include <jwt-cpp/jwt.h>
+
+#include <algorithm>
+#include <regex>
+#include <sstream>
+#include <cstdlib>
+#include <vector>
+#include <openssl/rsa.h>
+#include <openssl/pem.h>
+#include <openssl/bn.h>
+using json = nlohmann::json;
+
+static std::string GetEnvOrDefault(const char* name, const std::string& def)
+{
+    const char* v = std::getenv(name);
+    if (!v || !*v) return def;
+    return std::string(v);
+}
+
+// Optional:
+//   GOOGLE_JWKS_URL=https://www.googleapis.com/oauth2/v3/certs
+static std::string GoogleJwksUrl()
+{
+    return GetEnvOrDefault("GOOGLE_JWKS_URL", "https://www.googleapis.com/oauth2/v3/certs");
+}
+
+// --- base64url decode helper ---
+static std::string Base64UrlToBase64(std::string s) {
+    for (auto& c : s) { if (c == '-') c = '+'; else if (c == '_') c = '/'; }
+    while (s.size() % 4) s.push_back('=');
+    return s;
+}
+
+static std::vector<unsigned char> Base64Decode(const std::string& b64) {
+    BIO* bmem = BIO_new_mem_buf(b64.data(), (int)b64.size());
+    BIO* b64bio = BIO_new(BIO_f_base64());
+    BIO_set_flags(b64bio, BIO_FLAGS_BASE64_NO_NL);
+    bmem = BIO_push(b64bio, bmem);
+
+    std::vector<unsigned char> out(b64.size());
+    int len = BIO_read(bmem, out.data(), (int)out.size());
+    BIO_free_all(bmem);
+
+    if (len <= 0) return {};
+    out.resize(len);
+    return out;
+}
+
+static std::string JwkNeToPem(const std::string& n_b64url, const std::string& e_b64url) {
+    auto n_bin = Base64Decode(Base64UrlToBase64(n_b64url));
+    auto e_bin = Base64Decode(Base64UrlToBase64(e_b64url));
+    if (n_bin.empty() || e_bin.empty()) return {};
+
+    BIGNUM* n = BN_bin2bn(n_bin.data(), (int)n_bin.size(), nullptr);
+    BIGNUM* e = BN_bin2bn(e_bin.data(), (int)e_bin.size(), nullptr);
+    if (!n || !e) { if(n) BN_free(n); if(e) BN_free(e); return {}; }
+
+    RSA* rsa = RSA_new();
+    if (!rsa) { BN_free(n); BN_free(e); return {}; }
+
+    // RSA_set0_key takes ownership of n,e
+    if (RSA_set0_key(rsa, n, e, nullptr) != 1) {
+        RSA_free(rsa); // frees n,e too if set0 succeeded; here it didn't, so:
+        BN_free(n); BN_free(e);
+        return {};
+    }
+
+    BIO* mem = BIO_new(BIO_s_mem());
+    // write as SubjectPublicKeyInfo (-----BEGIN PUBLIC KEY-----)
+    if (PEM_write_bio_RSA_PUBKEY(mem, rsa) != 1) {
+        BIO_free(mem);
+        RSA_free(rsa);
+        return {};
+    }
+
+    char* data = nullptr;
+    long len = BIO_get_mem_data(mem, &data);
+    std::string pem(data, (size_t)len);
+
+    BIO_free(mem);
+    RSA_free(rsa);
+    return pem;
+}
+
+static int ParseMaxAgeSeconds(const cpr::Response& r)
+{
+    // Parse Cache-Control: public, max-age=XXXX, must-revalidate, ...
+    auto it = r.header.find("cache-control");
+    if (it == r.header.end()) return 300; // default fallback: 5 minutes
+
+    std::smatch m;
+    std::regex re(R"(max-age\s*=\s*(\d+))", std::regex::icase);
+    if (std::regex_search(it->second, m, re) && m.size() >= 2)
+    {
+        try { return std::stoi(m[1].str()); }
+        catch (...) { return 300; }
+    }
+    return 300;
+}
+
+static std::string X5cToPemCert(const std::string& x5cBase64)
+{
+    // Convert x5c base64 to PEM cert format
+    // (wrap lines at 64 chars for readability)
+    std::ostringstream oss;
+    oss << "-----BEGIN CERTIFICATE-----\n";
+    for (size_t i = 0; i < x5cBase64.size(); i += 64)
+        oss << x5cBase64.substr(i, 64) << "\n";
+    oss << "-----END CERTIFICATE-----\n";
+    return oss.str();
+}
+
+// =======================================================
+// GoogleKeyCache
+// =======================================================
+
+GoogleKeyCache::~GoogleKeyCache()
+{
+    Stop();
+}
+
+void GoogleKeyCache::Start()
+{
+    bool expected = false;
+    if (!running_.compare_exchange_strong(expected, true))
+        return; // already running
+
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stop_ = false;
+    }
+    th_ = std::thread([this]{ Run(); });
+}
+
+void GoogleKeyCache::Stop()
+{
+    if (!running_.exchange(false)) return;
+
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stop_ = true;
+    }
+    cv_.notify_one();
+    if (th_.joinable()) th_.join();
+}
+
+std::shared_ptr<const GoogleKeyCache::KeySet> GoogleKeyCache::Current()
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    return keys_;
+}
+
+GoogleKeyCache::KeyPtr GoogleKeyCache::Find(const std::string& kid)
+{
+    const auto now = std::chrono::steady_clock::now();
+    std::shared_ptr<const KeySet> keys = Current();
+
+    // past max-age the set is served while the thread revalidates, up to the stale limit
+    if (keys && now - keys->fetchedAt <= keys->maxAge + std::chrono::seconds(DARA_JWKS_MAX_STALE_SEC))
+    {
+        auto it = keys->byKid.find(kid);
+        if (it != keys->byKid.end()) return it->second;
+    }
+
+    // rotation (or a set too stale to use): wake the refresh thread, rate
+    // limited. Without any set the thread is retrying already
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stats_.unknownKids++;
+        if (!keys || now - lastKidRefresh_ < std::chrono::milliseconds(DARA_JWKS_KID_REFRESH_MIN_MS))
+            return nullptr;
+        lastKidRefresh_ = now;
+        refreshRequested_ = true;
+    }
+    cv_.notify_one();
+    return nullptr;
+}
+
+bool GoogleKeyCache::HasKeys()
+{
+    return Current() != nullptr;
+}
+
+GoogleKeyCacheStats GoogleKeyCache::GetStats()
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    GoogleKeyCacheStats s = stats_;
+    if (keys_)
+    {
+        const auto age = std::chrono::steady_clock::now() - keys_->fetchedAt;
+        s.keys = keys_->byKid.size();
+        s.ageSec = std::chrono::duration<double>(age).count();
+        s.stale = age > keys_->maxAge;
+    }
+    return s;
+}
+
+std::chrono::steady_clock::time_point GoogleKeyCache::Refresh()
+{
+    std::string err;
+
+    try
+    {
+        const std::string url = GoogleJwksUrl();
+
+        cpr::Response r = cpr::Get(
+            cpr::Url{url},
+            cpr::Timeout{8000}
+        );
+
+        if (r.status_code != 200)
+            err = "Failed to fetch Google certs (HTTP " + std::to_string(r.status_code) + ")";
+
+        json j;
+        if (err.empty())
+        {
+            j = json::parse(r.text);
+            if (!j.contains("keys") || !j["keys"].is_array())
+                err = "Google certs response missing 'keys'";
+        }
+
+        auto next = std::make_shared<KeySet>();
+        if (err.empty())
+        {
+            for (const auto& key : j["keys"])
+            {
+                if (!key.contains("kid") || !key["kid"].is_string()) continue;
+                const std::string kid = key["kid"].get<std::string>();
+
+                // 1) Prefer x5c if present, 2) fallback: n/e
+                std::string pem;
+                if (key.contains("x5c") && key["x5c"].is_array() && !key["x5c"].empty() && key["x5c"][0].is_string())
+                    pem = X5cToPemCert(key["x5c"][0].get<std::string>());
+                else if (key.contains("n") && key.contains("e") && key["n"].is_string() && key["e"].is_string())
+                    pem = JwkNeToPem(key["n"].get<std::string>(), key["e"].get<std::string>());
+                if (pem.empty()) continue;
+
+                // parsed once here; verification copies the key handle
+                try {
+                    next->byKid[kid] = std::make_shared<const jwt::algorithm::rs256>(pem, "", "", "");
+                } catch (const std::exception& e) {
+                    DaraLog("AUTH", "Skipping unusable Google key " + kid + ": " + e.what());
+                }
+            }
+            if (next->byKid.empty())
+                err = "Google certs parsed but no usable keys found";
+        }
+
+        if (err.empty())
+        {
+            next->fetchedAt = std::chrono::steady_clock::now();
+            next->maxAge = std::chrono::seconds(std::max(ParseMaxAgeSeconds(r), 1));
+            const size_t count = next->byKid.size();
+            // ahead of expiry, but not in a loop on a tiny max-age
+            const auto refreshAt = next->fetchedAt + std::max<std::chrono::steady_clock::duration>(
+                next->maxAge * DARA_JWKS_REFRESH_AT_PERCENT / 100, std::chrono::milliseconds(DARA_JWKS_RETRY_MS));
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                keys_ = std::move(next);
+                stats_.refreshes++;
+            }
+            DaraLog("AUTH", "Loaded " + std::to_string(count) + " Google signing keys");
+            return refreshAt;
+        }
+    }
+    catch (const std::exception& e)
+    {
+        err = std::string("RefreshGoogleCerts exception: ") + e.what();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stats_.failedRefreshes++;
+    }
+    DaraLog("AUTH", err + (HasKeys() ? " (serving the previous keys)" : ""));
+    return std::chrono::steady_clock::now() + std::chrono::milliseconds(DARA_JWKS_RETRY_MS);
+}
+
+void GoogleKeyCache::Run()
+{
+    std::unique_lock<std::mutex> lock(mtx_);
+    while (!stop_)
+    {
+        lock.unlock();
+        const auto next = Refresh();
+        lock.lock();
+
+        refreshRequested_ = false;
+        cv_.wait_until(lock, next, [this]{ return stop_ || refreshRequested_; });
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include "DaraConfig.h"
+
+namespace jwt::algorithm { struct rs256; }
+
+struct GoogleKeyCacheStats
+{
+    size_t keys = 0;
+    uint64_t refreshes = 0;         // successful fetches
+    uint64_t failedRefreshes = 0;
+    uint64_t unknownKids = 0;       // lookups that missed (each may request a refresh)
+    double ageSec = -1.0;           // since the last successful fetch, -1 = never
+    bool stale = false;             // past max-age, still served while revalidating
+};
+
+// =======================================================
+// Google signing keys (JWKS, GOOGLE_JWKS_URL)
+// Keys are parsed once per fetch into ready verifiers (no PEM parse per
+// login) and published as one immutable set. A background thread fetches
+// them at startup and again at DARA_JWKS_REFRESH_AT_PERCENT of the response's
+// max-age, so logins never wait for the network and only this thread ever
+// fetches (single flight). A failed refresh keeps serving the old set
+// (stale-while-revalidate) for up to DARA_JWKS_MAX_STALE_SEC past max-age and
+// retries every DARA_JWKS_RETRY_MS. An unknown kid (rotation) wakes the
+// thread early, at most every DARA_JWKS_KID_REFRESH_MIN_MS.
+// =======================================================
+class GoogleKeyCache
+{
+public:
+    using KeyPtr = std::shared_ptr<const jwt::algorithm::rs256>;
+
+    GoogleKeyCache() = default;
+    ~GoogleKeyCache();
+
+    GoogleKeyCache(const GoogleKeyCache&) = delete;
+    GoogleKeyCache& operator=(const GoogleKeyCache&) = delete;
+
+    void Start();
+    void Stop();
+
+    // never blocks on the network; nullptr if kid is unknown (a refresh is
+    // requested, the caller should tell the client to retry) or no usable set
+    KeyPtr Find(const std::string& kid);
+    bool HasKeys();
+
+    GoogleKeyCacheStats GetStats();
+
+private:
+    struct KeySet
+    {
+        std::unordered_map<std::string, KeyPtr> byKid;
+        std::chrono::steady_clock::time_point fetchedAt;
+        std::chrono::seconds maxAge{0};
+    };
+
+    void Run();
+    // fetch + parse outside the lock, publish under it; returns the next refresh time
+    std::chrono::steady_clock::time_point Refresh();
+    std::shared_ptr<const KeySet> Current();
+
+    std::thread th_;
+    std::atomic<bool> running_{false};
+
+    // ---- guarded by mtx_ ----
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+    bool refreshRequested_ = false;
+    std::chrono::steady_clock::time_point lastKidRefresh_{};
+    std::shared_ptr<const KeySet> keys_;
+    GoogleKeyCacheStats stats_;
+};
+
+extern GoogleKeyCache g_googleKeys;
@@ -0,0 +1,269 @@
+#include "HttpWorkerPool.h"
+#include <thread>
+#include <vector>
+#include <deque>
+#include <chrono>
+#include <functional>
+
+HttpLoadControl g_httpLoad;
+
+static_assert(DARA_HTTP_SLOW_ROUTES_MAX + DARA_HTTP_SLOW_ROUTES_QUEUE < DARA_HTTP_THREADS,
+              "Slow routes must leave workers for gameplay");
+
+static constexpr size_t kSlowMax   = DARA_HTTP_SLOW_ROUTES_MAX;
+static constexpr size_t kSlowQueue = DARA_HTTP_SLOW_ROUTES_QUEUE;
+
+// set on the overflow workers' threads (HttpLoadControl::OnOverflowWorker)
+static thread_local bool t_overflowWorker = false;
+
+static void StoreMax(std::atomic<uint64_t>& m, uint64_t v)
+{
+    uint64_t cur = m.load(std::memory_order_relaxed);
+    while (v > cur && !m.compare_exchange_weak(cur, v, std::memory_order_relaxed)) {}
+}
+
+static uint64_t ElapsedUs(std::chrono::steady_clock::time_point since)
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - since).count());
+}
+
+// =============================
+// Worker pool
+// =============================
+
+// httplib's ThreadPool plus queue wait / depth accounting, and a small
+// overflow pool whose connections are only answered 503
+class HttpWorkerPool final : public httplib::TaskQueue
+{
+public:
+    HttpWorkerPool(HttpLoadControl& load, size_t threads, size_t maxQueued,
+                   size_t overflowThreads, size_t maxOverflow)
+        : load_(load), maxQueued_(maxQueued), maxOverflow_(maxOverflow)
+    {
+        load_.threads_.store(threads, std::memory_order_relaxed);
+        threads_.reserve(threads + overflowThreads);
+        for (size_t i = 0; i < threads; ++i)
+            threads_.emplace_back([this]{ Work(); });
+        for (size_t i = 0; i < overflowThreads; ++i)
+            threads_.emplace_back([this]{ t_overflowWorker = true; Overflow(); });
+    }
+
+    HttpWorkerPool(const HttpWorkerPool&) = delete;
+    HttpWorkerPool& operator=(const HttpWorkerPool&) = delete;
+
+    bool enqueue(std::function<void()> fn) override
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            if (jobs_.size() >= maxQueued_) {
+                if (overflow_.size() >= maxOverflow_) {
+                    // httplib closes the socket
+                    load_.rejected_.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+                overflow_.push_back(std::move(fn));
+                load_.overflowed_.fetch_add(1, std::memory_order_relaxed);
+                overflowCv_.notify_one();
+                return true;
+            }
+            jobs_.push_back({ std::move(fn), std::chrono::steady_clock::now() });
+            const size_t depth = jobs_.size();
+            load_.queued_.store(depth, std::memory_order_relaxed);
+            if (depth > load_.queuedPeak_.load(std::memory_order_relaxed))
+                load_.queuedPeak_.store(depth, std::memory_order_relaxed);   // under mtx_
+        }
+        load_.connections_.fetch_add(1, std::memory_order_relaxed);
+        cv_.notify_one();
+        return true;
+    }
+
+    void shutdown() override
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        overflowCv_.notify_all();
+        for (auto& t : threads_) t.join();
+        load_.threads_.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    struct Job
+    {
+        std::function<void()> fn;
+        std::chrono::steady_clock::time_point enqueuedAt;
+    };
+
+    void Work()
+    {
+        while (true)
+        {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                cv_.wait(lock, [this]{ return stop_ || !jobs_.empty(); });
+                // queued connections are still served on shutdown
+                if (jobs_.empty()) break;
+                job = std::move(jobs_.front());
+                jobs_.pop_front();
+                load_.queued_.store(jobs_.size(), std::memory_order_relaxed);
+            }
+
+            const uint64_t waitUs = ElapsedUs(job.enqueuedAt);
+            load_.started_.fetch_add(1, std::memory_order_relaxed);
+            load_.waitUsTotal_.fetch_add(waitUs, std::memory_order_relaxed);
+            StoreMax(load_.waitUsMax_, waitUs);
+
+            load_.busy_.fetch_add(1, std::memory_order_relaxed);
+            job.fn();
+            load_.busy_.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    // serves the connection like any worker; the pre-routing stage answers
+    // every request on this thread 503 + Retry-After and closes
+    void Overflow()
+    {
+        while (true)
+        {
+            std::function<void()> fn;
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                overflowCv_.wait(lock, [this]{ return stop_ || !overflow_.empty(); });
+                if (overflow_.empty()) break;
+                fn = std::move(overflow_.front());
+                overflow_.pop_front();
+            }
+            fn();
+        }
+    }
+
+    HttpLoadControl& load_;
+    const size_t maxQueued_;
+    const size_t maxOverflow_;
+
+    std::vector<std::thread> threads_;
+    std::deque<Job> jobs_;
+    std::deque<std::function<void()>> overflow_;
+    bool stop_ = false;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::condition_variable overflowCv_;
+};
+
+// =============================
+// Load control
+// =============================
+
+httplib::TaskQueue* HttpLoadControl::NewTaskQueue()
+{
+    return new HttpWorkerPool(*this, DARA_HTTP_THREADS, DARA_HTTP_QUEUE_MAX,
+                              DARA_HTTP_OVERFLOW_THREADS, DARA_HTTP_OVERFLOW_QUEUE_MAX);
+}
+
+bool HttpLoadControl::OnOverflowWorker()
+{
+    return t_overflowWorker;
+}
+
+void HttpLoadControl::SetRouteClass(const std::string& path, ERouteClass c)
+{
+    routes_[path] = c;
+}
+
+ERouteClass HttpLoadControl::ClassOf(const std::string& path) const
+{
+    auto it = routes_.find(path);
+    return it == routes_.end() ? ERouteClass::Default : it->second;
+}
+
+bool HttpLoadControl::AdmitSlow()
+{
+    std::unique_lock<std::mutex> lock(slowMtx_);
+    if (slowActive_ < kSlowMax && slowWaiting_ == 0) {
+        ++slowActive_;
+        return true;
+    }
+
+    // waiting holds a worker: not while connections queue for one
+    if (slowWaiting_ >= kSlowQueue || Saturated()) {
+        shed_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    ++slowWaiting_;
+    const bool admitted = slowCv_.wait_for(lock, std::chrono::milliseconds(DARA_HTTP_SLOW_ROUTES_WAIT_MS),
+                                           [this]{ return slowActive_ < kSlowMax; });
+    --slowWaiting_;
+    if (!admitted) {
+        shed_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    ++slowActive_;
+    return true;
+}
+
+void HttpLoadControl::ReleaseSlow()
+{
+    {
+        std::lock_guard<std::mutex> lock(slowMtx_);
+        --slowActive_;
+    }
+    slowCv_.notify_one();
+}
+
+HttpLoadControl::ClassCounters& HttpLoadControl::CountersFor(ERouteClass c)
+{
+    switch (c)
+    {
+    case ERouteClass::Gameplay: return gameplay_;
+    case ERouteClass::Slow:     return slow_;
+    default:                    return other_;
+    }
+}
+
+void HttpLoadControl::RecordRequest(ERouteClass c, double ms)
+{
+    ClassCounters& cc = CountersFor(c);
+    const uint64_t us = static_cast<uint64_t>(ms * 1000.0);
+    cc.requests.fetch_add(1, std::memory_order_relaxed);
+    cc.usTotal.fetch_add(us, std::memory_order_relaxed);
+    StoreMax(cc.usMax, us);
+}
+
+HttpRouteClassStats HttpLoadControl::Snapshot(const ClassCounters& c)
+{
+    HttpRouteClassStats s;
+    s.requests = c.requests.load(std::memory_order_relaxed);
+    s.avgMs = s.requests ? c.usTotal.load(std::memory_order_relaxed) / 1000.0 / s.requests : 0.0;
+    s.maxMs = c.usMax.load(std::memory_order_relaxed) / 1000.0;
+    return s;
+}
+
+HttpLoadStats HttpLoadControl::GetStats() const
+{
+    HttpLoadStats s;
+    s.threads     = threads_.load(std::memory_order_relaxed);
+    s.busy        = busy_.load(std::memory_order_relaxed);
+    s.queued      = queued_.load(std::memory_order_relaxed);
+    s.queuedPeak  = queuedPeak_.load(std::memory_order_relaxed);
+    s.connections = connections_.load(std::memory_order_relaxed);
+    s.overflowConnections = overflowed_.load(std::memory_order_relaxed);
+    s.rejectedConnections = rejected_.load(std::memory_order_relaxed);
+    const uint64_t started = started_.load(std::memory_order_relaxed);
+    s.avgQueueWaitMs = started ? waitUsTotal_.load(std::memory_order_relaxed) / 1000.0 / started : 0.0;
+    s.maxQueueWaitMs = waitUsMax_.load(std::memory_order_relaxed) / 1000.0;
+    {
+        std::lock_guard<std::mutex> lock(slowMtx_);
+        s.slowActive  = slowActive_;
+        s.slowWaiting = slowWaiting_;
+    }
+    s.shed     = shed_.load(std::memory_order_relaxed);
+    s.gameplay = Snapshot(gameplay_);
+    s.slow     = Snapshot(slow_);
+    s.other    = Snapshot(other_);
+    return s;
+}
@@ -0,0 +1,128 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+#include "httplib.h"
+#include "DaraConfig.h"
+
+// how a route is admitted when the server is loaded
+enum class ERouteClass
+{
+    Default,    // not limited
+    Gameplay,   // /action, /state: never limited
+    Slow        // may wait on MySQL: at most DARA_HTTP_SLOW_ROUTES_MAX at once, shed beyond
+};
+
+struct HttpRouteClassStats
+{
+    uint64_t requests = 0;
+    double avgMs = 0.0;    // pre-routing -> post-routing (handler included)
+    double maxMs = 0.0;
+};
+
+struct HttpLoadStats
+{
+    size_t threads = 0;
+    size_t busy = 0;                     // workers serving a connection
+    size_t queued = 0;                   // connections waiting for a worker
+    size_t queuedPeak = 0;
+    uint64_t connections = 0;
+    uint64_t overflowConnections = 0;    // queue full: answered 503 by an overflow worker
+    uint64_t rejectedConnections = 0;    // overflow queue full too: closed unanswered
+    double avgQueueWaitMs = 0.0;         // accept -> worker
+    double maxQueueWaitMs = 0.0;
+    size_t slowActive = 0;
+    size_t slowWaiting = 0;
+    uint64_t shed = 0;                   // Slow requests answered 503
+    HttpRouteClassStats gameplay;
+    HttpRouteClassStats slow;
+    HttpRouteClassStats other;
+};
+
+// =======================================================
+// Admission control for the HTTP server.
+// httplib hands its task queue whole connections, before a request is read,
+// so the worker pool (NewTaskQueue) can only bound them: DARA_HTTP_THREADS
+// workers, at most DARA_HTTP_QUEUE_MAX connections waiting. Beyond that,
+// DARA_HTTP_OVERFLOW_THREADS overflow workers read each request and answer it
+// 503 + Retry-After (the pipeline checks OnOverflowWorker); only past
+// DARA_HTTP_OVERFLOW_QUEUE_MAX more is a connection closed unanswered.
+// A keep-alive connection holds its worker until it closes, so while
+// connections wait (Saturated) every response carries Connection: close.
+// Priority is applied per request in the pre-routing stage instead: Slow
+// routes take one of DARA_HTTP_SLOW_ROUTES_MAX slots, waiting for one at most
+// DARA_HTTP_SLOW_ROUTES_WAIT_MS, and are shed with 503 + Retry-After once that
+// queue is full or connections already wait for a worker. A stalled DB thus
+// holds at most DARA_HTTP_SLOW_ROUTES_MAX + DARA_HTTP_SLOW_ROUTES_QUEUE workers and the
+// remaining ones keep serving /action and /state.
+// =======================================================
+class HttpLoadControl
+{
+public:
+    HttpLoadControl() = default;
+
+    HttpLoadControl(const HttpLoadControl&) = delete;
+    HttpLoadControl& operator=(const HttpLoadControl&) = delete;
+
+    // for server.new_task_queue (httplib owns the pool); the pool reports here
+    httplib::TaskQueue* NewTaskQueue();
+
+    // path (exact, as registered); call before listen
+    void SetRouteClass(const std::string& path, ERouteClass c);
+    ERouteClass ClassOf(const std::string& path) const;
+
+    // Slow slot; false = shed, answer 503. Every true needs a ReleaseSlow
+    bool AdmitSlow();
+    void ReleaseSlow();
+
+    // connections are waiting for a worker
+    bool Saturated() const { return queued_.load(std::memory_order_relaxed) > 0; }
+    // the calling thread serves an overflow connection: answer 503 and close
+    static bool OnOverflowWorker();
+
+    void RecordRequest(ERouteClass c, double ms);
+    HttpLoadStats GetStats() const;
+
+private:
+    friend class HttpWorkerPool;
+
+    struct ClassCounters
+    {
+        std::atomic<uint64_t> requests{0};
+        std::atomic<uint64_t> usTotal{0};
+        std::atomic<uint64_t> usMax{0};
+    };
+    ClassCounters& CountersFor(ERouteClass c);
+    static HttpRouteClassStats Snapshot(const ClassCounters& c);
+
+    // filled before listen, read-only afterwards
+    std::unordered_map<std::string, ERouteClass> routes_;
+
+    // Slow admission
+    mutable std::mutex slowMtx_;
+    std::condition_variable slowCv_;
+    size_t slowActive_ = 0;
+    size_t slowWaiting_ = 0;
+    std::atomic<uint64_t> shed_{0};
+
+    // worker pool, written by HttpWorkerPool
+    std::atomic<size_t> threads_{0};
+    std::atomic<size_t> busy_{0};
+    std::atomic<size_t> queued_{0};
+    std::atomic<size_t> queuedPeak_{0};
+    std::atomic<uint64_t> connections_{0};
+    std::atomic<uint64_t> overflowed_{0};
+    std::atomic<uint64_t> rejected_{0};
+    std::atomic<uint64_t> started_{0};       // taken by a worker
+    std::atomic<uint64_t> waitUsTotal_{0};
+    std::atomic<uint64_t> waitUsMax_{0};
+
+    ClassCounters gameplay_;
+    ClassCounters slow_;
+    ClassCounters other_;
+};
+
+extern HttpLoadControl g_httpLoad;
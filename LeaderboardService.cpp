@@ -0,0 +1,440 @@
+#include <memory>
+#include <chrono>
+#include <mutex>
+#include <algorithm>
+#include "LeaderboardService.h"
+#include "CharacterStore.h"
+
+// =============================
+// RankIndex
+// =============================
+
+uint32_t RankIndex::NextPrio()
+{
+    // xorshift32, priorities only need to be well spread
+    rng_ ^= rng_ << 13;
+    rng_ ^= rng_ >> 17;
+    rng_ ^= rng_ << 5;
+    return rng_;
+}
+
+void RankIndex::Split(uint32_t t, const Key& k, uint32_t& l, uint32_t& r)
+{
+    if (t == kNil) { l = r = kNil; return; }
+    if (Before(nodes_[t].key, k))
+    {
+        Split(nodes_[t].right, k, nodes_[t].right, r);
+        l = t;
+    }
+    else
+    {
+        Split(nodes_[t].left, k, l, nodes_[t].left);
+        r = t;
+    }
+    Update(t);
+}
+
+void RankIndex::SplitAt(uint32_t t, uint32_t count, uint32_t& l, uint32_t& r)
+{
+    if (t == kNil) { l = r = kNil; return; }
+    const uint32_t leftSize = SizeOf(nodes_[t].left);
+    if (leftSize < count)
+    {
+        SplitAt(nodes_[t].right, count - leftSize - 1, nodes_[t].right, r);
+        l = t;
+    }
+    else
+    {
+        SplitAt(nodes_[t].left, count, l, nodes_[t].left);
+        r = t;
+    }
+    Update(t);
+}
+
+uint32_t RankIndex::Merge(uint32_t l, uint32_t r)
+{
+    if (l == kNil) return r;
+    if (r == kNil) return l;
+    if (nodes_[l].prio > nodes_[r].prio)
+    {
+        nodes_[l].right = Merge(nodes_[l].right, r);
+        Update(l);
+        return l;
+    }
+    nodes_[r].left = Merge(l, nodes_[r].left);
+    Update(r);
+    return r;
+}
+
+void RankIndex::Insert(Key k)
+{
+    uint32_t n;
+    if (!free_.empty()) {
+        n = free_.back();
+        free_.pop_back();
+        nodes_[n] = Node{k, NextPrio()};
+    } else {
+        n = static_cast<uint32_t>(nodes_.size());
+        nodes_.push_back(Node{k, NextPrio()});
+    }
+
+    uint32_t l, r;
+    Split(root_, k, l, r);
+    root_ = Merge(Merge(l, n), r);
+}
+
+void RankIndex::Erase(Key k)
+{
+    uint32_t l, r, mid;
+    Split(root_, k, l, r);
+    SplitAt(r, 1, mid, r);   // k is the first key of r
+    if (mid != kNil) free_.push_back(mid);
+    root_ = Merge(l, r);
+}
+
+int RankIndex::Rank(Key k) const
+{
+    size_t before = 0;
+    uint32_t t = root_;
+    while (t != kNil)
+    {
+        if (Before(nodes_[t].key, k)) {
+            before += SizeOf(nodes_[t].left) + 1;
+            t = nodes_[t].right;
+        } else {
+            t = nodes_[t].left;
+        }
+    }
+    return static_cast<int>(before) + 1;
+}
+
+RankIndex::Key RankIndex::Select(size_t pos) const
+{
+    uint32_t t = root_;
+    while (t != kNil)
+    {
+        const size_t leftSize = SizeOf(nodes_[t].left);
+        if (pos < leftSize) {
+            t = nodes_[t].left;
+        } else if (pos == leftSize) {
+            return nodes_[t].key;
+        } else {
+            pos -= leftSize + 1;
+            t = nodes_[t].right;
+        }
+    }
+    return Key{};
+}
+
+void RankIndex::Clear()
+{
+    nodes_.clear();
+    free_.clear();
+    root_ = kNil;
+}
+
+// =============================
+// LeaderboardService
+// =============================
+
+int64_t LeaderboardService::NowSec()
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+void LeaderboardService::LoadFromDb()
+{
+    std::lock_guard<std::mutex> loadLock(loadMtx_);
+    {
+        std::unique_lock<std::shared_mutex> lock(mtx_);
+        recording_ = true;
+        duringLoad_.clear();
+    }
+
+    // no lock across the query: readers keep the current index and save
+    // batches committed meanwhile are recorded, then replayed on the new one
+    const auto t0 = std::chrono::steady_clock::now();
+    std::vector<CharacterRankRow> rows;
+    try {
+        rows = g_characterStore->GetRankRows();
+    } catch (...) {
+        std::unique_lock<std::shared_mutex> lock(mtx_);
+        recording_ = false;
+        duringLoad_.clear();
+        throw;
+    }
+
+    LeaderboardService fresh;
+    // age instead of the timestamp itself: immune to clock skew between DB and server
+    const int64_t now = NowSec();
+    for (CharacterRankRow& r : rows)
+    {
+        Entry e;
+        e.characterName = std::move(r.characterName);
+        e.userEmail     = std::move(r.userEmail);
+        e.avatar        = std::move(r.avatar);
+        e.values[static_cast<size_t>(ELeaderboardMetric::Wave)]    = r.highestWave;
+        e.values[static_cast<size_t>(ELeaderboardMetric::Level)]   = r.level;
+        e.values[static_cast<size_t>(ELeaderboardMetric::Credits)] = r.credits;
+        e.values[static_cast<size_t>(ELeaderboardMetric::Potions)] = r.potions;
+        e.storeTime = now - r.ageSec;
+        fresh.InsertLocked(r.characterId, std::move(e));
+    }
+
+    size_t characters, weekly;
+    {
+        std::unique_lock<std::shared_mutex> lock(mtx_);
+        std::swap(entries_, fresh.entries_);
+        std::swap(idsByEmail_, fresh.idsByEmail_);
+        std::swap(all_, fresh.all_);
+        std::swap(week_, fresh.week_);
+        std::swap(weeklyByTime_, fresh.weeklyByTime_);
+
+        for (auto& change : duringLoad_) change();
+        duringLoad_.clear();
+        recording_ = false;
+
+        ExpireWeeklyLocked(NowSec() - DARA_LEADERBOARD_WEEK_SEC);
+        loaded_.store(true, std::memory_order_release);
+        characters = entries_.size();
+        weekly = weeklyByTime_.size();
+    }
+
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    DaraLog("LEADERBOARDS", "Loaded " + std::to_string(characters) + " characters ("
+        + std::to_string(weekly) + " weekly) in " + std::to_string(ms) + "ms");
+}
+
+void LeaderboardService::RecordLocked(std::function<void()> change)
+{
+    if (recording_) duringLoad_.push_back(std::move(change));
+}
+
+void LeaderboardService::InsertLocked(int characterId, Entry e)
+{
+    EraseLocked(characterId);
+
+    for (size_t m = 0; m < kMetrics; ++m)
+        all_[m].Insert({e.values[m], characterId});
+
+    // entered as weekly, the next expiry pass sorts out old ones
+    for (size_t m = 0; m < kMetrics; ++m)
+        week_[m].Insert({e.values[m], characterId});
+    weeklyByTime_.emplace(e.storeTime, characterId);
+    e.weekly = true;
+
+    idsByEmail_[e.userEmail].insert(characterId);
+    entries_.emplace(characterId, std::move(e));
+}
+
+void LeaderboardService::EraseLocked(int characterId)
+{
+    auto it = entries_.find(characterId);
+    if (it == entries_.end()) return;
+
+    const Entry& e = it->second;
+    for (size_t m = 0; m < kMetrics; ++m)
+        all_[m].Erase({e.values[m], characterId});
+    if (e.weekly) {
+        for (size_t m = 0; m < kMetrics; ++m)
+            week_[m].Erase({e.values[m], characterId});
+        weeklyByTime_.erase({e.storeTime, characterId});
+    }
+
+    auto byEmail = idsByEmail_.find(e.userEmail);
+    if (byEmail != idsByEmail_.end()) {
+        byEmail->second.erase(characterId);
+        if (byEmail->second.empty()) idsByEmail_.erase(byEmail);
+    }
+    entries_.erase(it);
+}
+
+void LeaderboardService::Touch(int characterId, Entry& e, int64_t now)
+{
+    if (e.weekly) {
+        weeklyByTime_.erase({e.storeTime, characterId});
+    } else {
+        for (size_t m = 0; m < kMetrics; ++m)
+            week_[m].Insert({e.values[m], characterId});
+        e.weekly = true;
+    }
+    e.storeTime = now;
+    weeklyByTime_.emplace(now, characterId);
+}
+
+bool LeaderboardService::HasExpiredLocked(int64_t cutoff) const
+{
+    return !weeklyByTime_.empty() && weeklyByTime_.begin()->first < cutoff;
+}
+
+void LeaderboardService::ExpireWeeklyLocked(int64_t cutoff)
+{
+    while (HasExpiredLocked(cutoff))
+    {
+        const int characterId = weeklyByTime_.begin()->second;
+        weeklyByTime_.erase(weeklyByTime_.begin());
+
+        Entry& e = entries_.at(characterId);
+        for (size_t m = 0; m < kMetrics; ++m)
+            week_[m].Erase({e.values[m], characterId});
+        e.weekly = false;
+    }
+}
+
+void LeaderboardService::OnCharacterCreated(int characterId, const std::string& characterName,
+                                            const std::string& userEmail, const std::string& avatar)
+{
+    // same start values as the cached Character (CreateCharacterForUserAndCache)
+    Entry e;
+    e.characterName = characterName;
+    e.userEmail = userEmail;
+    e.avatar = avatar;
+    e.values[static_cast<size_t>(ELeaderboardMetric::Level)] = 1;
+    e.storeTime = NowSec();
+
+    std::unique_lock<std::shared_mutex> lock(mtx_);
+    // the query may already have read the new row (and saves on top of it)
+    RecordLocked([this, characterId, e]{ if (!entries_.count(characterId)) InsertLocked(characterId, e); });
+    if (IsLoaded()) InsertLocked(characterId, std::move(e));
+}
+
+void LeaderboardService::OnCharacterRemoved(int characterId)
+{
+    std::unique_lock<std::shared_mutex> lock(mtx_);
+    RecordLocked([this, characterId]{ EraseLocked(characterId); });
+    if (IsLoaded()) EraseLocked(characterId);
+}
+
+void LeaderboardService::ApplySaves(const std::vector<CharacterSave>& rows)
+{
+    if (rows.empty()) return;
+
+    const int64_t now = NowSec();
+    std::unique_lock<std::shared_mutex> lock(mtx_);
+    RecordLocked([this, rows, now]{ ApplySavesLocked(rows, now); });
+    if (IsLoaded()) ApplySavesLocked(rows, now);
+}
+
+void LeaderboardService::ApplySavesLocked(const std::vector<CharacterSave>& rows, int64_t now)
+{
+    for (const CharacterSave& r : rows)
+    {
+        // the UPDATE skips characters deleted meanwhile, so do we
+        auto it = entries_.find(r.characterId);
+        if (it == entries_.end()) continue;
+        Entry& e = it->second;
+
+        int values[kMetrics];
+        values[static_cast<size_t>(ELeaderboardMetric::Wave)]    = std::max(e.values[static_cast<size_t>(ELeaderboardMetric::Wave)], r.highestWave);
+        values[static_cast<size_t>(ELeaderboardMetric::Level)]   = r.level;
+        values[static_cast<size_t>(ELeaderboardMetric::Credits)] = r.credits;
+        values[static_cast<size_t>(ELeaderboardMetric::Potions)] = r.potions;
+
+        for (size_t m = 0; m < kMetrics; ++m)
+        {
+            if (values[m] == e.values[m]) continue;
+            all_[m].Erase({e.values[m], r.characterId});
+            all_[m].Insert({values[m], r.characterId});
+            if (e.weekly) {
+                week_[m].Erase({e.values[m], r.characterId});
+                week_[m].Insert({values[m], r.characterId});
+            }
+            e.values[m] = values[m];
+        }
+        // every flush sets StoreTime, so the character is (again) part of this week
+        Touch(r.characterId, e, now);
+    }
+}
+
+std::vector<BestEntry> LeaderboardService::TopLocked(const RankIndex& index, int topN) const
+{
+    std::vector<BestEntry> out;
+    const size_t n = std::min(index.Size(), static_cast<size_t>(std::max(topN, 0)));
+    out.reserve(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        const RankIndex::Key k = index.Select(i);
+        const Entry& e = entries_.at(k.characterId);
+
+        BestEntry b;
+        b.characterId   = k.characterId;
+        b.characterName = e.characterName;
+        b.userEmail     = e.userEmail;
+        b.avatar        = e.avatar;
+        b.value         = k.value;
+        b.rank          = static_cast<int>(i) + 1;
+        out.push_back(std::move(b));
+    }
+    return out;
+}
+
+BestListsResult LeaderboardService::GetBestListsAndMyPlaces(const std::string& userEmail, int topN)
+{
+    const int64_t cutoff = NowSec() - DARA_LEADERBOARD_WEEK_SEC;
+
+    // exclusive only when the startup load failed or a weekly entry aged out
+    if (!IsLoaded()) {
+        std::unique_lock<std::mutex> loadLock(loadMtx_);   // waits for a load in flight
+        if (!IsLoaded()) {
+            loadLock.unlock();
+            LoadFromDb();
+        }
+    }
+    bool expired;
+    {
+        std::shared_lock<std::shared_mutex> lock(mtx_);
+        expired = HasExpiredLocked(cutoff);
+    }
+    if (expired) {
+        std::unique_lock<std::shared_mutex> lock(mtx_);
+        ExpireWeeklyLocked(cutoff);
+    }
+
+    std::shared_lock<std::shared_mutex> lock(mtx_);
+    BestListsResult r;
+
+    constexpr size_t wave    = static_cast<size_t>(ELeaderboardMetric::Wave);
+    constexpr size_t level   = static_cast<size_t>(ELeaderboardMetric::Level);
+    constexpr size_t credits = static_cast<size_t>(ELeaderboardMetric::Credits);
+    constexpr size_t potions = static_cast<size_t>(ELeaderboardMetric::Potions);
+
+    r.topWaveWeek    = TopLocked(week_[wave], topN);
+    r.topLevelWeek   = TopLocked(week_[level], topN);
+    r.topCreditsWeek = TopLocked(week_[credits], topN);
+    r.topPotionsWeek = TopLocked(week_[potions], topN);
+
+    r.topWaveAll     = TopLocked(all_[wave], topN);
+    r.topLevelAll    = TopLocked(all_[level], topN);
+    r.topCreditsAll  = TopLocked(all_[credits], topN);
+    r.topPotionsAll  = TopLocked(all_[potions], topN);
+
+    auto ids = idsByEmail_.find(userEmail);
+    if (ids == idsByEmail_.end()) return r;
+
+    // newest character first, like ORDER BY CharacterId DESC
+    for (auto it = ids->second.rbegin(); it != ids->second.rend(); ++it)
+    {
+        const int id = *it;
+        const Entry& e = entries_.at(id);
+
+        MyPlace p;
+        p.characterId   = id;
+        p.characterName = e.characterName;
+        p.avatar        = e.avatar;
+
+        if (e.weekly) {
+            p.rankWaveWeek    = week_[wave].Rank({e.values[wave], id});
+            p.rankLevelWeek   = week_[level].Rank({e.values[level], id});
+            p.rankCreditsWeek = week_[credits].Rank({e.values[credits], id});
+            p.rankPotionsWeek = week_[potions].Rank({e.values[potions], id});
+        }
+        p.rankWaveAll     = all_[wave].Rank({e.values[wave], id});
+        p.rankLevelAll    = all_[level].Rank({e.values[level], id});
+        p.rankCreditsAll  = all_[credits].Rank({e.values[credits], id});
+        p.rankPotionsAll  = all_[potions].Rank({e.values[potions], id});
+
+        r.myPlaces.push_back(std::move(p));
+    }
+    return r;
+}
@@ -0,0 +1,142 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <set>
+#include <unordered_map>
+#include <shared_mutex>
+#include <mutex>
+#include <functional>
+#include <atomic>
+#include <cstdint>
+#include "DaraConfig.h"
+#include "CharacterRepository.h"
+
+enum class ELeaderboardMetric
+{
+    Wave,       // highestWave
+    Level,
+    Credits,
+    Potions,
+    Count
+};
+
+// =======================================================
+// Order statistic index (size-augmented treap) over (value DESC, CharacterId ASC),
+// the same order as the RANK() OVER (...) queries it replaces. CharacterId is
+// unique, so the rank of a key is 1 + the number of keys before it.
+// Insert/Erase/Rank/Select are O(log n).
+// =======================================================
+class RankIndex
+{
+public:
+    struct Key
+    {
+        int value = 0;
+        int characterId = 0;
+    };
+
+    void Insert(Key k);
+    void Erase(Key k);          // k must be present
+    int Rank(Key k) const;      // 1-based; k must be present
+    Key Select(size_t pos) const; // 0-based position, pos < Size()
+    size_t Size() const { return root_ == kNil ? 0 : nodes_[root_].size; }
+    void Clear();
+
+private:
+    static constexpr uint32_t kNil = UINT32_MAX;
+
+    struct Node
+    {
+        Key key;
+        uint32_t prio;
+        uint32_t left = kNil;
+        uint32_t right = kNil;
+        uint32_t size = 1;
+    };
+
+    static bool Before(const Key& a, const Key& b)
+    {
+        return a.value != b.value ? a.value > b.value : a.characterId < b.characterId;
+    }
+
+    uint32_t SizeOf(uint32_t n) const { return n == kNil ? 0 : nodes_[n].size; }
+    void Update(uint32_t n) { nodes_[n].size = 1 + SizeOf(nodes_[n].left) + SizeOf(nodes_[n].right); }
+    // (keys before k, keys from k on)
+    void Split(uint32_t t, const Key& k, uint32_t& l, uint32_t& r);
+    // (first `count` keys, the rest)
+    void SplitAt(uint32_t t, uint32_t count, uint32_t& l, uint32_t& r);
+    uint32_t Merge(uint32_t l, uint32_t r);
+    uint32_t NextPrio();
+
+    std::vector<Node> nodes_;
+    std::vector<uint32_t> free_;
+    uint32_t root_ = kNil;
+    uint32_t rng_ = 0x9E3779B9u;
+};
+
+// =======================================================
+// In-memory leaderboards (weekly + all time, per metric), loaded once from
+// the Characters table and then kept current from the save stream:
+// CharacterDbWorker reports every flushed batch, character create/delete
+// report themselves. Top-N and "my places" need no DB round-trip.
+// Weekly = saved within DARA_LEADERBOARD_WEEK_SEC, like StoreTime >= NOW() - 7 DAY.
+// =======================================================
+class LeaderboardService
+{
+public:
+    // Reads all characters from g_characterStore; throws (sql::SQLException / std::runtime_error) on DB errors.
+    // The query runs without the index lock and the new index is swapped in;
+    // changes reported meanwhile are applied on top of it.
+    void LoadFromDb();
+    bool IsLoaded() const { return loaded_.load(std::memory_order_acquire); }
+
+    // save stream; ignored until loaded (the load reads the DB state),
+    // recorded and replayed while a load is querying
+    void OnCharacterCreated(int characterId, const std::string& characterName,
+                            const std::string& userEmail, const std::string& avatar);
+    void OnCharacterRemoved(int characterId);
+    void ApplySaves(const std::vector<CharacterSave>& rows);   // rows just committed
+
+    // Loads lazily if the startup load failed (then throws like LoadFromDb).
+    BestListsResult GetBestListsAndMyPlaces(const std::string& userEmail,
+                                            int topN = DARA_LEADERBOARD_TOP_N);
+
+private:
+    static constexpr size_t kMetrics = static_cast<size_t>(ELeaderboardMetric::Count);
+
+    struct Entry
+    {
+        std::string characterName;
+        std::string userEmail;
+        std::string avatar;
+        int values[kMetrics] = {};
+        int64_t storeTime = 0;      // unix seconds of the last save
+        bool weekly = false;        // currently in week_[]
+    };
+
+    static int64_t NowSec();
+    void InsertLocked(int characterId, Entry e);
+    void EraseLocked(int characterId);
+    void Touch(int characterId, Entry& e, int64_t now);   // re-enter the weekly lists
+    void ExpireWeeklyLocked(int64_t cutoff);
+    void ApplySavesLocked(const std::vector<CharacterSave>& rows, int64_t now);
+    // while a load queries the store: replayed on the new index
+    void RecordLocked(std::function<void()> change);
+    bool HasExpiredLocked(int64_t cutoff) const;
+    std::vector<BestEntry> TopLocked(const RankIndex& index, int topN) const;
+
+    mutable std::shared_mutex mtx_;
+    std::atomic<bool> loaded_{false};
+
+    std::mutex loadMtx_;                               // one load at a time
+    bool recording_ = false;                           // a load is querying (under mtx_)
+    std::vector<std::function<void()>> duringLoad_;   // changes reported meanwhile
+
+    std::unordered_map<int, Entry> entries_;
+    std::unordered_map<std::string, std::set<int>> idsByEmail_;
+    RankIndex all_[kMetrics];
+    RankIndex week_[kMetrics];
+    std::set<std::pair<int64_t, int>> weeklyByTime_;   // (storeTime, characterId) of weekly entries
+};
+
+extern LeaderboardService g_leaderboard;
@@ -0,0 +1,522 @@
+#include "LocalCharacterStore.h"
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+#include <fcntl.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <io.h>
+#endif
+#include "BinaryIo.h"
+
+namespace
+{
+    struct FileHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t nextId;    // ids of deleted characters are never reused (0: none written)
+    };
+
+    struct RecordHeader
+    {
+        uint32_t crc;       // CRC-32 of type, size and the payload
+        uint16_t type;
+        uint16_t reserved;
+        uint32_t size;      // payload bytes
+    };
+
+    uint32_t RecordCrc(const RecordHeader& h, const char* payload)
+    {
+        const uint32_t c = Crc32(0, reinterpret_cast<const char*>(&h) + sizeof(h.crc), sizeof(h) - sizeof(h.crc));
+        return Crc32(c, payload, h.size);
+    }
+
+    bool TruncateFd(int fd, size_t len)
+    {
+#ifndef _WIN32
+        return ::ftruncate(fd, static_cast<off_t>(len)) == 0;
+#else
+        return ::_chsize_s(fd, static_cast<long long>(len)) == 0;
+#endif
+    }
+
+    int OpenFile(const std::string& path, bool truncate)
+    {
+#ifndef _WIN32
+        return ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | (truncate ? O_TRUNC : 0), 0644);
+#else
+        return ::_open(path.c_str(), _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY | (truncate ? _O_TRUNC : 0),
+                       _S_IREAD | _S_IWRITE);
+#endif
+    }
+}
+
+LocalCharacterStore::~LocalCharacterStore()
+{
+    if (fd_ >= 0) ::close(fd_);
+}
+
+int64_t LocalCharacterStore::NowSec()
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+std::string LocalCharacterStore::FormatTime(int64_t unixSec)
+{
+    // like the StoreTime column: "YYYY-MM-DD HH:MM:SS" (UTC)
+    const std::time_t tt = static_cast<std::time_t>(unixSec);
+    std::tm tm{};
+#ifdef _WIN32
+    gmtime_s(&tm, &tt);
+#else
+    gmtime_r(&tt, &tm);
+#endif
+    char buf[32];
+    std::strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+    return buf;
+}
+
+// =============================
+// Open / replay
+// =============================
+
+bool LocalCharacterStore::Open(const std::string& path, std::string* err)
+{
+    std::unique_lock<std::shared_mutex> lock(mtx_);
+    if (fd_ >= 0) return true;
+    path_ = path;
+
+    std::error_code ec;
+    const bool exists = std::filesystem::exists(path, ec);
+    size_t valid = 0;
+    size_t size = 0;
+    if (exists)
+    {
+        size = static_cast<size_t>(std::filesystem::file_size(path, ec));
+        if (ec) {
+            if (err) *err = "Cannot stat character store: " + path;
+            return false;
+        }
+    }
+
+    if (size > 0)
+    {
+#ifndef _WIN32
+        const int rfd = ::open(path.c_str(), O_RDONLY);
+        if (rfd < 0) {
+            if (err) *err = "Cannot open character store: " + path;
+            return false;
+        }
+        void* addr = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, rfd, 0);
+        ::close(rfd);
+        if (addr == MAP_FAILED) {
+            if (err) *err = "Cannot mmap character store: " + path;
+            return false;
+        }
+        valid = ReplayLocked(static_cast<const char*>(addr), size);
+        ::munmap(addr, size);
+#else
+        std::ifstream in(path, std::ios::binary);
+        const std::vector<char> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        valid = ReplayLocked(data.data(), data.size());
+#endif
+        if (valid == 0) {
+            if (err) *err = "Not a character store (bad header): " + path;
+            return false;
+        }
+        if (valid < size)
+            DaraLog("STORE", "Character store " + path + " has a torn tail, cut off "
+                + std::to_string(size - valid) + " bytes");
+    }
+
+    fd_ = OpenFile(path, false);
+    if (fd_ < 0) {
+        if (err) *err = "Cannot open character store for writing: " + path;
+        return false;
+    }
+    if (valid < size && !TruncateFd(fd_, valid)) {
+        if (err) *err = "Cannot truncate character store: " + path;
+        ::close(fd_);
+        fd_ = -1;
+        return false;
+    }
+    fileBytes_ = valid;
+
+    if (fileBytes_ == 0)
+    {
+        FileHeader h{};
+        std::memcpy(h.magic, LOCAL_STORE_MAGIC, sizeof(h.magic));
+        h.version = LOCAL_STORE_VERSION;
+        h.nextId = static_cast<uint32_t>(nextId_);
+        if (!WriteAll(fd_, reinterpret_cast<const char*>(&h), sizeof(h)) || !SyncFd(fd_)) {
+            if (err) *err = "Cannot write character store: " + path;
+            ::close(fd_);
+            fd_ = -1;
+            return false;
+        }
+        fileBytes_ = sizeof(h);
+    }
+
+    DaraLog("STORE", "Opened local character store " + path + ": " + std::to_string(rows_.size())
+        + " characters, " + std::to_string(fileBytes_) + " bytes");
+    return true;
+}
+
+size_t LocalCharacterStore::ReplayLocked(const char* data, size_t len)
+{
+    FileHeader fh{};
+    if (len < sizeof(fh)) return 0;
+    std::memcpy(&fh, data, sizeof(fh));
+    if (std::memcmp(fh.magic, LOCAL_STORE_MAGIC, sizeof(fh.magic)) != 0 || fh.version != LOCAL_STORE_VERSION)
+        return 0;
+    // a rewrite drops deleted rows: their ids only survive here
+    nextId_ = std::max(nextId_, static_cast<int>(fh.nextId));
+
+    size_t pos = sizeof(fh);
+    while (len - pos >= sizeof(RecordHeader))
+    {
+        RecordHeader h{};
+        std::memcpy(&h, data + pos, sizeof(h));
+        const char* payload = data + pos + sizeof(h);
+        if (h.size > len - pos - sizeof(h) || h.crc != RecordCrc(h, payload)) break;
+
+        BinaryReader r(payload, h.size);
+        switch (static_cast<ERecordType>(h.type))
+        {
+        case ERecordType::Put:
+        {
+            Row row;
+            row.rec.characterId    = r.Get<int32_t>();
+            row.storeTime          = r.Get<int64_t>();
+            row.rec.level          = r.Get<int32_t>();
+            row.rec.xp             = r.Get<int32_t>();
+            row.rec.credits        = r.Get<int32_t>();
+            row.rec.potions        = r.Get<int32_t>();
+            row.rec.highestWave    = r.Get<int32_t>();
+            row.rec.userId         = r.GetString();
+            row.rec.usereMail      = r.GetString();
+            row.rec.characterName  = r.GetString();
+            row.rec.characterClass = r.GetString();
+            row.rec.avatar         = r.GetString();
+            if (r.ok()) ApplyPutLocked(std::move(row));
+            break;
+        }
+        case ERecordType::Update:
+        {
+            const int64_t storeTime = r.Get<int64_t>();
+            const uint32_t n = r.Get<uint32_t>();
+            for (uint32_t i = 0; i < n && r.ok(); ++i)
+            {
+                CharacterSave s;
+                s.characterId = r.Get<int32_t>();
+                s.level       = r.Get<int32_t>();
+                s.xp          = r.Get<int32_t>();
+                s.credits     = r.Get<int32_t>();
+                s.potions     = r.Get<int32_t>();
+                s.highestWave = r.Get<int32_t>();
+                if (!r.ok()) break;
+                auto it = rows_.find(s.characterId);
+                if (it == rows_.end()) continue;
+                it->second.rec.level       = s.level;
+                it->second.rec.xp          = s.xp;
+                it->second.rec.credits     = s.credits;
+                it->second.rec.potions     = s.potions;
+                it->second.rec.highestWave = std::max(it->second.rec.highestWave, s.highestWave);
+                it->second.storeTime       = storeTime;
+            }
+            break;
+        }
+        case ERecordType::Delete:
+        {
+            const int32_t id = r.Get<int32_t>();
+            if (r.ok()) ApplyDeleteLocked(id);
+            break;
+        }
+        default:
+            break;   // written by a newer version: skip
+        }
+        pos += sizeof(h) + h.size;
+    }
+
+    for (auto& [id, row] : rows_) row.rec.storeTime = FormatTime(row.storeTime);
+    return pos;
+}
+
+void LocalCharacterStore::ApplyPutLocked(Row row)
+{
+    const int id = row.rec.characterId;
+    ApplyDeleteLocked(id);
+    nextId_ = std::max(nextId_, id + 1);
+    liveBytes_ += sizeof(RecordHeader) + EncodePut(row).size();
+    idsByEmail_[row.rec.usereMail].insert(id);
+    rows_.emplace(id, std::move(row));
+}
+
+void LocalCharacterStore::ApplyDeleteLocked(int characterId)
+{
+    auto it = rows_.find(characterId);
+    if (it == rows_.end()) return;
+
+    liveBytes_ -= sizeof(RecordHeader) + EncodePut(it->second).size();
+    auto e = idsByEmail_.find(it->second.rec.usereMail);
+    if (e != idsByEmail_.end()) {
+        e->second.erase(characterId);
+        if (e->second.empty()) idsByEmail_.erase(e);
+    }
+    rows_.erase(it);
+}
+
+// =============================
+// Log writing
+// =============================
+
+std::string LocalCharacterStore::EncodePut(const Row& row)
+{
+    std::string p;
+    p.reserve(64 + row.rec.userId.size() + row.rec.usereMail.size() + row.rec.characterName.size()
+              + row.rec.characterClass.size() + row.rec.avatar.size());
+    PutPod<int32_t>(p, row.rec.characterId);
+    PutPod<int64_t>(p, row.storeTime);
+    PutPod<int32_t>(p, row.rec.level);
+    PutPod<int32_t>(p, row.rec.xp);
+    PutPod<int32_t>(p, row.rec.credits);
+    PutPod<int32_t>(p, row.rec.potions);
+    PutPod<int32_t>(p, row.rec.highestWave);
+    PutString(p, row.rec.userId);
+    PutString(p, row.rec.usereMail);
+    PutString(p, row.rec.characterName);
+    PutString(p, row.rec.characterClass);
+    PutString(p, row.rec.avatar);
+    return p;
+}
+
+std::string LocalCharacterStore::Frame(ERecordType type, const std::string& payload)
+{
+    RecordHeader h{};
+    h.type = static_cast<uint16_t>(type);
+    h.size = static_cast<uint32_t>(payload.size());
+    h.crc = RecordCrc(h, payload.data());
+
+    std::string out;
+    out.reserve(sizeof(h) + payload.size());
+    out.append(reinterpret_cast<const char*>(&h), sizeof(h));
+    out.append(payload);
+    return out;
+}
+
+void LocalCharacterStore::AppendLocked(const std::string& record)
+{
+    if (fd_ < 0) throw std::runtime_error("Character store not open");
+
+    if (!WriteAll(fd_, record.data(), record.size()) || !SyncFd(fd_))
+    {
+        // drop the partial record, or the next replay stops in front of it
+        TruncateFd(fd_, fileBytes_);
+        throw std::runtime_error("Character store write failed: " + path_);
+    }
+    fileBytes_ += record.size();
+}
+
+void LocalCharacterStore::MaybeCompactLocked()
+{
+    if (fileBytes_ < DARA_LOCAL_STORE_COMPACT_BYTES || fileBytes_ < 2 * (liveBytes_ + sizeof(FileHeader)))
+        return;
+
+    const size_t before = fileBytes_;
+    std::string err;
+    if (!RewriteLocked(&err)) {
+        DaraLog("STORE", "Rewrite failed, keeping the log: " + err);
+        return;
+    }
+    DaraLog("STORE", "Rewrote " + path_ + ": " + std::to_string(before) + " -> " + std::to_string(fileBytes_) + " bytes");
+}
+
+bool LocalCharacterStore::RewriteLocked(std::string* err)
+{
+    std::string data;
+    data.reserve(sizeof(FileHeader) + liveBytes_);
+    FileHeader h{};
+    std::memcpy(h.magic, LOCAL_STORE_MAGIC, sizeof(h.magic));
+    h.version = LOCAL_STORE_VERSION;
+    h.nextId = static_cast<uint32_t>(nextId_);
+    data.append(reinterpret_cast<const char*>(&h), sizeof(h));
+    for (const auto& [id, row] : rows_)
+        data += Frame(ERecordType::Put, EncodePut(row));
+
+    if (!ReplaceFileDurably(path_, data, err)) return false;
+
+    // the old fd still points at the replaced file
+    ::close(fd_);
+    fd_ = OpenFile(path_, false);
+    fileBytes_ = data.size();
+    if (fd_ < 0) {
+        if (err) *err = "Cannot reopen " + path_;
+        return false;
+    }
+    return true;
+}
+
+// =============================
+// CRUD
+// =============================
+
+int LocalCharacterStore::CreateCharacter(const std::string& userId,
+                                         const std::string& userEmail,
+                                         const std::string& characterName,
+                                         const std::string& characterClass,
+                                         const std::string& avatar)
+{
+    std::unique_lock<std::shared_mutex> lock(mtx_);
+
+    Row row;
+    row.rec.characterId    = nextId_;
+    row.rec.userId         = userId;
+    row.rec.usereMail      = userEmail;
+    row.rec.characterName  = characterName;
+    row.rec.characterClass = characterClass;
+    row.rec.avatar         = avatar;
+    row.rec.level          = 1;   // schema defaults
+    row.storeTime          = NowSec();
+    row.rec.storeTime      = FormatTime(row.storeTime);
+
+    AppendLocked(Frame(ERecordType::Put, EncodePut(row)));
+    const int id = row.rec.characterId;
+    ApplyPutLocked(std::move(row));
+    return id;
+}
+
+std::vector<CharacterRecord> LocalCharacterStore::GetCharactersForUser(const std::string& userEmail)
+{
+    std::shared_lock<std::shared_mutex> lock(mtx_);
+
+    std::vector<CharacterRecord> out;
+    auto e = idsByEmail_.find(userEmail);
+    if (e == idsByEmail_.end()) return out;
+
+    out.reserve(e->second.size());
+    // newest first, like ORDER BY CharacterId DESC
+    for (auto it = e->second.rbegin(); it != e->second.rend(); ++it)
+        out.push_back(rows_.at(*it).rec);
+    return out;
+}
+
+void LocalCharacterStore::UpdateCharactersBatch(const std::vector<CharacterSave>& rows)
+{
+    if (rows.empty()) return;
+
+    std::unique_lock<std::shared_mutex> lock(mtx_);
+    const int64_t now = NowSec();
+
+    std::string p;
+    p.reserve(12 + rows.size() * 24);
+    PutPod<int64_t>(p, now);
+    PutPod<uint32_t>(p, static_cast<uint32_t>(rows.size()));
+    for (const CharacterSave& s : rows)
+    {
+        PutPod<int32_t>(p, s.characterId);
+        PutPod<int32_t>(p, s.level);
+        PutPod<int32_t>(p, s.xp);
+        PutPod<int32_t>(p, s.credits);
+        PutPod<int32_t>(p, s.potions);
+        PutPod<int32_t>(p, s.highestWave);
+    }
+    AppendLocked(Frame(ERecordType::Update, p));
+
+    const std::string storeTime = FormatTime(now);
+    for (const CharacterSave& s : rows)
+    {
+        auto it = rows_.find(s.characterId);
+        if (it == rows_.end()) continue;   // deleted meanwhile
+        CharacterRecord& r = it->second.rec;
+        r.level       = s.level;
+        r.xp          = s.xp;
+        r.credits     = s.credits;
+        r.potions     = s.potions;
+        r.highestWave = std::max(r.highestWave, s.highestWave);
+        r.storeTime   = storeTime;
+        it->second.storeTime = now;
+    }
+    MaybeCompactLocked();
+}
+
+bool LocalCharacterStore::RemoveCharacter(const std::string& userId, int characterId)
+{
+    std::unique_lock<std::shared_mutex> lock(mtx_);
+
+    auto it = rows_.find(characterId);
+    if (it == rows_.end() || it->second.rec.userId != userId) return false;
+
+    std::string p;
+    PutPod<int32_t>(p, characterId);
+    AppendLocked(Frame(ERecordType::Delete, p));
+    ApplyDeleteLocked(characterId);
+    return true;
+}
+
+void LocalCharacterStore::ForEachCharacterOfActiveUsers(int64_t activeWithinSec, size_t maxUsers,
+                                                        const std::function<void(CharacterRecord&&)>& fn)
+{
+    std::shared_lock<std::shared_mutex> lock(mtx_);
+    const int64_t since = NowSec() - activeWithinSec;
+
+    // (last save, email) of the active users, most recent first
+    std::vector<std::pair<int64_t, const std::string*>> active;
+    for (const auto& [email, ids] : idsByEmail_)
+    {
+        int64_t last = INT64_MIN;
+        for (int id : ids) last = std::max(last, rows_.at(id).storeTime);
+        if (last >= since) active.emplace_back(last, &email);
+    }
+    std::sort(active.begin(), active.end(), [](const auto& a, const auto& b){ return a.first > b.first; });
+    if (active.size() > maxUsers) active.resize(maxUsers);
+
+    for (const auto& [last, email] : active)
+    {
+        const std::set<int>& ids = idsByEmail_.at(*email);
+        for (auto it = ids.rbegin(); it != ids.rend(); ++it)
+            fn(CharacterRecord(rows_.at(*it).rec));
+    }
+}
+
+size_t LocalCharacterStore::Size()
+{
+    std::shared_lock<std::shared_mutex> lock(mtx_);
+    return rows_.size();
+}
+
+// =============================
+// Leaderboards
+// =============================
+
+std::vector<CharacterRankRow> LocalCharacterStore::GetRankRows()
+{
+    std::shared_lock<std::shared_mutex> lock(mtx_);
+    const int64_t now = NowSec();
+
+    std::vector<CharacterRankRow> out;
+    out.reserve(rows_.size());
+    for (const auto& [id, row] : rows_)
+    {
+        CharacterRankRow r;
+        r.characterId   = id;
+        r.characterName = row.rec.characterName;
+        r.userEmail     = row.rec.usereMail;
+        r.avatar        = row.rec.avatar;
+        r.highestWave   = row.rec.highestWave;
+        r.level         = row.rec.level;
+        r.credits       = row.rec.credits;
+        r.potions       = row.rec.potions;
+        r.ageSec        = std::max<int64_t>(0, now - row.storeTime);
+        out.push_back(std::move(r));
+    }
+    return out;
+}
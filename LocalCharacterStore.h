@@ -0,0 +1,97 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <shared_mutex>
+#include <cstdint>
+#include "CharacterStore.h"
+
+// =======================================================
+// Embedded single-file character store (--no-persistence, benchmarks,
+// single-node deployments): no MySQL needed.
+// All characters live in memory; every change is appended to the file as one
+// CRC-checked record and fsynced before the call returns. Open() maps the file
+// and replays it; a torn tail (crash mid-write) is cut off. Once the log is
+// mostly superseded records it is rewritten (write + fsync + rename).
+//
+// File: header { magic, version, next character id }, then records
+// { crc, type, size, payload }. Native little-endian. Ids are never reused:
+// the header keeps the next one across rewrites, like AUTO_INCREMENT.
+//   Put    full character (create, and every character after a rewrite)
+//   Update one save batch (all-or-nothing like the MySQL transaction)
+//   Delete characterId
+// =======================================================
+
+inline constexpr char     LOCAL_STORE_MAGIC[8] = { 'D','A','R','A','C','H','R','\0' };
+inline constexpr uint32_t LOCAL_STORE_VERSION  = 1;
+
+class LocalCharacterStore : public ICharacterStore
+{
+public:
+    LocalCharacterStore() = default;
+    ~LocalCharacterStore() override;
+
+    LocalCharacterStore(const LocalCharacterStore&) = delete;
+    LocalCharacterStore& operator=(const LocalCharacterStore&) = delete;
+
+    // creates the file if missing; false if it cannot be read or written
+    bool Open(const std::string& path, std::string* err = nullptr);
+
+    const char* Name() const override { return "local"; }
+
+    int CreateCharacter(const std::string& userId,
+                        const std::string& userEmail,
+                        const std::string& characterName,
+                        const std::string& characterClass,
+                        const std::string& avatar) override;
+    std::vector<CharacterRecord> GetCharactersForUser(const std::string& userEmail) override;
+    void UpdateCharactersBatch(const std::vector<CharacterSave>& rows) override;
+    bool RemoveCharacter(const std::string& userId, int characterId) override;
+    void ForEachCharacterOfActiveUsers(int64_t activeWithinSec, size_t maxUsers,
+                                       const std::function<void(CharacterRecord&&)>& fn) override;
+
+    std::vector<CharacterRankRow> GetRankRows() override;
+
+    size_t Size();
+
+private:
+    enum class ERecordType : uint16_t
+    {
+        Put = 1,
+        Update = 2,
+        Delete = 3
+    };
+
+    struct Row
+    {
+        CharacterRecord rec;        // rec.storeTime is derived from storeTime
+        int64_t storeTime = 0;      // unix seconds of the last save
+    };
+
+    static int64_t NowSec();
+    static std::string FormatTime(int64_t unixSec);
+
+    // returns the length of the valid prefix
+    size_t ReplayLocked(const char* data, size_t len);
+    void ApplyPutLocked(Row row);
+    void ApplyDeleteLocked(int characterId);
+
+    static std::string EncodePut(const Row& row);
+    static std::string Frame(ERecordType type, const std::string& payload);
+    // write + fsync; on failure the file is cut back and std::runtime_error thrown
+    void AppendLocked(const std::string& record);
+    void MaybeCompactLocked();
+    bool RewriteLocked(std::string* err);
+
+    std::string path_;
+    int fd_ = -1;
+    size_t fileBytes_ = 0;
+    size_t liveBytes_ = 0;          // what a rewrite would write
+
+    std::shared_mutex mtx_;
+    std::map<int, Row> rows_;
+    std::unordered_map<std::string, std::set<int>> idsByEmail_;
+    int nextId_ = 1;
+};
@@ -0,0 +1,60 @@
+#include "MobPool.h"
+#include <charconv>
+
+MobPool::MobPool(size_t prewarm)
+{
+    Objects.reserve(prewarm);
+    for (size_t i = 0; i < prewarm; ++i)
+        Objects.push_back(NewObject());
+}
+
+std::shared_ptr<Combatant> MobPool::NewObject()
+{
+    auto mob = std::make_shared<Combatant>("mob", ECombatantType::Mob);
+    mob->ResetForReuse();
+    return mob;
+}
+
+std::shared_ptr<Combatant> MobPool::Acquire()
+{
+    const size_t n = Objects.size();
+    for (size_t i = 0; i < n; ++i)
+    {
+        const size_t idx = (Cursor + i) % n;
+        // use_count 1 = only the pool holds it; it can only go up from here
+        // through the pool itself, so this is safe under the room lock
+        if (Objects[idx].use_count() == 1)
+        {
+            Cursor = (idx + 1) % n;
+            Objects[idx]->ResetForReuse();
+            return Objects[idx];
+        }
+    }
+
+    // all in use (or still referenced, e.g. by a UI snapshot): grow
+    Objects.push_back(NewObject());
+    Cursor = 0;
+    DaraLog("INFO", "MobPool grown to "+std::to_string(Objects.size())+" mobs");
+    return Objects.back();
+}
+
+void MobPool::AssignInstanceId(Combatant& mob, std::string_view templateId)
+{
+    char buf[24];
+    const auto res = std::to_chars(buf, buf + sizeof(buf), ++NextSerial);
+
+    // built in a reused buffer and copied into the mob's (reused) string
+    IdScratch.assign(templateId);
+    IdScratch.push_back('-');
+    IdScratch.append(buf, res.ptr);
+    mob.SetInstanceId(IdScratch);
+    mob.SetTemplateId(templateId);
+}
+
+size_t MobPool::InUse() const
+{
+    size_t used = 0;
+    for (const auto& o : Objects)
+        if (o.use_count() > 1) ++used;
+    return used;
+}
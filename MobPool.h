@@ -0,0 +1,44 @@
+// MobPool.h
+#pragma once
+#include <memory>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include "combatant.h"
+
+// =======================================================
+// Per-room pool of mob Combatants.
+// Mobs are never freed while the room lives: an object whose only owner is
+// the pool (it was erased from CombatDirector::Mobs and nobody else holds it)
+// is free and gets reset in place on the next spawn. So spawning reuses the
+// object, its control block and its string/set capacity instead of
+// allocating; the pool only grows past its high-water mark.
+// Not thread safe: guarded by the owning CombatDirector's CacheMutex.
+// =======================================================
+class MobPool
+{
+public:
+    explicit MobPool(size_t prewarm = DARA_MOB_POOL_PREWARM);
+
+    MobPool(const MobPool&) = delete;
+    MobPool& operator=(const MobPool&) = delete;
+
+    // free mob, already ResetForReuse(); init it from a template afterwards
+    std::shared_ptr<Combatant> Acquire();
+
+    // sets the instance id "<templateId>-<n>" (n counts up per room, so it is
+    // unique for the room's lifetime) and the template id
+    void AssignInstanceId(Combatant& mob, std::string_view templateId);
+
+    size_t Capacity() const { return Objects.size(); }
+    size_t InUse() const;
+
+private:
+    std::shared_ptr<Combatant> NewObject();
+
+    std::vector<std::shared_ptr<Combatant>> Objects;
+    size_t Cursor = 0;      // round-robin scan start
+    uint64_t NextSerial = 0;
+    std::string IdScratch;
+};
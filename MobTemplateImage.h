@@ -0,0 +1,100 @@
+// MobTemplateImage.h
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+// =======================================================
+// Compiled mob template image (mobs/mobdb.bin)
+// Written by the offline `mobcompile` tool, mmapped by MobTemplateStore.
+// Native little-endian, every section 8-byte aligned, all offsets are
+// relative to the start of the file.
+// =======================================================
+
+inline constexpr char     MOB_IMAGE_MAGIC[8]  = { 'D','A','R','A','M','O','B','\0' };
+inline constexpr uint32_t MOB_IMAGE_VERSION   = 2;
+inline constexpr uint32_t MOB_IMAGE_NO_TABLE  = UINT32_MAX;
+inline constexpr size_t   MOB_IMAGE_DIFFICULTIES = 6; // ECombatantDifficulty::Normal..RaidBoss
+// spawn table families: one per difficulty, then bombs (attackType Bomb, any difficulty)
+inline constexpr size_t   MOB_IMAGE_BOMB_FAMILY  = MOB_IMAGE_DIFFICULTIES;
+inline constexpr size_t   MOB_IMAGE_FAMILIES     = MOB_IMAGE_DIFFICULTIES + 1;
+
+struct MobImageString
+{
+    uint32_t offset;   // into the string table
+    uint32_t length;   // without the trailing '\0'
+};
+
+// one fixed-size record per template, sorted by id (binary search lookup)
+struct MobImageRecord
+{
+    MobImageString id;
+    MobImageString displayName;
+    MobImageString mobClass;
+    MobImageString avatarId;
+    uint8_t attackType;    // ECombatantAttackType
+    uint8_t difficulty;    // ECombatantDifficulty
+    uint8_t pad[2];
+    float speed;           // as in mobdb.json (random Normal speed-up is rolled at load)
+    float spawnWeight;
+    int32_t wave;
+    int32_t maxHP;
+    int32_t maxEnergy;
+    int32_t maxMana;
+    int32_t baseDamage;
+    int32_t baseDefense;
+    uint32_t reserved;
+};
+
+// Walker alias table for one (wave, family): `count` entries starting at `firstEntry`
+struct MobImageTable
+{
+    uint32_t firstEntry;
+    uint32_t count;
+};
+
+struct MobImageTableEntry
+{
+    uint32_t templateIndex;  // index into the record array
+    float    prob;           // keep probability of this slot
+    uint32_t alias;          // slot (relative to firstEntry) taken otherwise
+};
+
+struct MobImageHeader
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t fileSize;
+    uint64_t checksum;         // FNV-1a 64 over [headerSize, fileSize)
+
+    uint32_t templateCount;
+    uint32_t templateOffset;   // MobImageRecord[templateCount]
+    uint32_t tableCount;
+    uint32_t tableOffset;      // MobImageTable[tableCount]
+    uint32_t entryCount;
+    uint32_t entryOffset;      // MobImageTableEntry[entryCount]
+    uint32_t stringBytes;
+    uint32_t stringOffset;     // '\0' terminated, interned strings
+
+    // per family: wave -> table index (MOB_IMAGE_NO_TABLE = none), already
+    // forward-filled so undefined waves point to the nearest lower defined wave
+    // of the same family
+    uint32_t waveIndexOffset;  // uint32_t[sum(waveIndexCount)]
+    uint32_t waveIndexFirst[MOB_IMAGE_FAMILIES];
+    uint32_t waveIndexCount[MOB_IMAGE_FAMILIES];
+    uint32_t reserved;
+};
+
+static_assert(sizeof(MobImageRecord) == 72, "MobImageRecord layout changed, bump MOB_IMAGE_VERSION");
+static_assert(sizeof(MobImageTableEntry) == 12, "MobImageTableEntry layout changed, bump MOB_IMAGE_VERSION");
+static_assert(sizeof(MobImageHeader) % 8 == 0, "MobImageHeader must keep 8-byte alignment");
+
+inline uint64_t MobImageChecksum(const unsigned char* data, size_t size)
+{
+    uint64_t h = 1469598103934665603ull;
+    for (size_t i = 0; i < size; ++i) {
+        h ^= data[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
@@ -1,7 +1,39 @@
 #include "MobTemplateStore.h"
 #include <fstream>
+#include <map>
+#include <array>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
-bool MobTemplateStore::LoadFromFile(const std::string& path, std::string* err)
+// snapshots are shared between threads, so every thread samples with its own rng
+static std::mt19937& SpawnRng()
+{
+    static thread_local std::mt19937 rng{ std::random_device{}() };
+    return rng;
+}
+
+MobTemplateStore::MobTemplateStore()
+    : Current(std::make_shared<const Snapshot>())
+{
+}
+
+MobTemplateStore::~MobTemplateStore()
+{
+    StopWatching();
+}
+
+// =============================
+// json -> image
+// =============================
+
+bool MobTemplateStore::ParseJson(const std::string& path, std::vector<MobTemplate>& out, std::string* err)
 {
     try {
         std::ifstream in(path);
@@ -13,15 +45,17 @@ bool MobTemplateStore::LoadFromFile(const std::string& path, std::string* err)
         json root;
         in >> root;
 
-        Templates.clear();
-        Keys.clear();
-
         const auto& arr = root.at("mobs");
         if (!arr.is_array()) {
             if (err) *err = "`mobs` must be an array";
             return false;
         }
+        if (arr.empty()) {
+            if (err) *err = "`mobs` is empty";
+            return false;
+        }
 
+        std::unordered_map<std::string, size_t> byId;
         for (const auto& m : arr) {
             MobTemplate t;
             t.id          = m.at("id").get<std::string>();
@@ -36,19 +70,23 @@ bool MobTemplateStore::LoadFromFile(const std::string& path, std::string* err)
             t.maxMana     = m.at("maxMana").get<int>();
             t.baseDamage  = m.at("baseDamage").get<int>();
             t.baseDefense = m.at("baseDefense").get<int>();
-            if(t.difficulty==ECombatantDifficulty::Normal && GetRandomFloat(0.f,10.f)>5.f){
-                t.speed       = 2.f * m.at("speed").get<float>();
-            }else{
-                t.speed       = m.at("speed").get<float>();
+            t.speed       = m.at("speed").get<float>();
+            t.spawnWeight = m.value("spawnWeight", 1.f);
+            if (t.wave < 0 || t.wave > kMaxTemplateWave) {
+                if (err) *err = "Mob " + t.id + ": wave out of range (0.." + std::to_string(kMaxTemplateWave) + ")";
+                return false;
+            }
+            // inf would make the alias table's sum inf and its probabilities NaN
+            if (!std::isfinite(t.spawnWeight) || t.spawnWeight < 0.f) {
+                if (err) *err = "Mob " + t.id + ": spawnWeight must be a finite number >= 0";
+                return false;
             }
 
-            // store
-            Templates[t.id] = t;
+            // store (a later entry with the same id replaces the earlier one)
+            auto [it, inserted] = byId.emplace(t.id, out.size());
+            if (inserted) out.push_back(std::move(t));
+            else out[it->second] = std::move(t);
         }
-
-        Keys.reserve(Templates.size());
-        for (const auto& kv : Templates) Keys.push_back(kv.first);
-
         return true;
     }
     catch (const std::exception& e) {
@@ -57,89 +95,584 @@ bool MobTemplateStore::LoadFromFile(const std::string& path, std::string* err)
     }
 }
 
-bool MobTemplateStore::HasTemplate(const std::string& mobId) const
+// Vose's variant of Walker's alias method, slots are relative to the table start
+void MobTemplateStore::BuildAliasTable(const std::vector<std::pair<uint32_t, float>>& entries,
+                                       std::vector<MobImageTableEntry>& out)
 {
-    return Templates.find(mobId) != Templates.end();
+    const size_t n = entries.size();
+    const size_t first = out.size();
+
+    double sum = 0.0;
+    for (const auto& e : entries) sum += e.second;
+
+    std::vector<double> scaled(n);
+    std::vector<uint32_t> small, large;
+    for (size_t i = 0; i < n; ++i)
+    {
+        out.push_back(MobImageTableEntry{ entries[i].first, 1.f, static_cast<uint32_t>(i) });
+        scaled[i] = entries[i].second * static_cast<double>(n) / sum;
+        (scaled[i] < 1.0 ? small : large).push_back(static_cast<uint32_t>(i));
+    }
+
+    while (!small.empty() && !large.empty())
+    {
+        const uint32_t l = small.back(); small.pop_back();
+        const uint32_t g = large.back(); large.pop_back();
+
+        out[first + l].prob  = static_cast<float>(scaled[l]);
+        out[first + l].alias = g;
+
+        scaled[g] = (scaled[g] + scaled[l]) - 1.0;
+        (scaled[g] < 1.0 ? small : large).push_back(g);
+    }
+    // leftovers (rounding) keep prob 1 and alias to themselves
 }
 
-std::shared_ptr<Combatant> MobTemplateStore::CreateMobInstancePtr(const std::string& mobId, int lane, int slot) const
+std::vector<char> MobTemplateStore::BuildImage(std::vector<MobTemplate> templates)
 {
-    Combatant tmp = CreateMobInstance(mobId, lane, slot);          // creates by value
-    return std::make_shared<Combatant>(std::move(tmp)); // wraps into shared_ptr
+    std::sort(templates.begin(), templates.end(),
+              [](const MobTemplate& a, const MobTemplate& b){ return a.id < b.id; });
+
+    // interned string table: displayName/mobClass/avatarId are mostly equal to the id
+    std::string strings;
+    std::unordered_map<std::string, MobImageString> interned;
+    auto intern = [&](const std::string& v) -> MobImageString
+    {
+        auto it = interned.find(v);
+        if (it != interned.end()) return it->second;
+        MobImageString ref{ static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(v.size()) };
+        strings.append(v);
+        strings.push_back('\0');
+        interned.emplace(v, ref);
+        return ref;
+    };
+
+    std::vector<MobImageRecord> records(templates.size());
+    for (size_t i = 0; i < templates.size(); ++i)
+    {
+        const auto& t = templates[i];
+        MobImageRecord& r = records[i];
+        r = MobImageRecord{};
+        r.id          = intern(t.id);
+        r.displayName = intern(t.displayName);
+        r.mobClass    = intern(t.mobClass);
+        r.avatarId    = intern(t.avatarId);
+        r.attackType  = static_cast<uint8_t>(t.attackType);
+        r.difficulty  = static_cast<uint8_t>(t.difficulty);
+        r.speed       = t.speed;
+        r.spawnWeight = t.spawnWeight;
+        r.wave        = t.wave;
+        r.maxHP       = t.maxHP;
+        r.maxEnergy   = t.maxEnergy;
+        r.maxMana     = t.maxMana;
+        r.baseDamage  = t.baseDamage;
+        r.baseDefense = t.baseDefense;
+    }
+
+    // spawn tables per (family, wave); weight 0 = never spawned randomly.
+    // Bombs get their own family, so a Boss lookup never lands on a bomb table.
+    std::map<std::pair<size_t, int>, std::vector<std::pair<uint32_t, float>>> groups;
+    for (size_t i = 0; i < templates.size(); ++i)
+    {
+        const auto& t = templates[i];
+        if (t.spawnWeight <= 0.f) continue;
+        const size_t family = t.attackType == ECombatantAttackType::Bomb
+            ? MOB_IMAGE_BOMB_FAMILY : static_cast<size_t>(t.difficulty);
+        groups[{family, t.wave}].emplace_back(static_cast<uint32_t>(i), t.spawnWeight);
+    }
+
+    std::vector<MobImageTable> tables;
+    std::vector<MobImageTableEntry> entries;
+    std::array<std::vector<uint32_t>, MOB_IMAGE_FAMILIES> waveIndex;
+    for (const auto& [key, members] : groups)
+    {
+        const auto [family, wave] = key;
+
+        auto& idx = waveIndex[family];
+        if (idx.size() <= static_cast<size_t>(wave))
+            idx.resize(static_cast<size_t>(wave) + 1, MOB_IMAGE_NO_TABLE);
+
+        idx[wave] = static_cast<uint32_t>(tables.size());
+        tables.push_back(MobImageTable{ static_cast<uint32_t>(entries.size()), static_cast<uint32_t>(members.size()) });
+        BuildAliasTable(members, entries);
+    }
+
+    // fallback chain: undefined waves use the nearest lower defined wave of the family
+    for (auto& idx : waveIndex)
+    {
+        uint32_t last = MOB_IMAGE_NO_TABLE;
+        for (auto& t : idx)
+        {
+            if (t == MOB_IMAGE_NO_TABLE) t = last;
+            else last = t;
+        }
+    }
+
+    // layout: header, records, tables, entries, wave index, strings
+    MobImageHeader h{};
+    std::memcpy(h.magic, MOB_IMAGE_MAGIC, sizeof(h.magic));
+    h.version    = MOB_IMAGE_VERSION;
+    h.headerSize = sizeof(MobImageHeader);
+
+    std::vector<char> image(sizeof(MobImageHeader));
+    auto append = [&image](const void* data, size_t bytes) -> uint32_t
+    {
+        image.resize((image.size() + 7) & ~size_t(7), '\0');
+        const uint32_t offset = static_cast<uint32_t>(image.size());
+        const char* p = static_cast<const char*>(data);
+        image.insert(image.end(), p, p + bytes);
+        return offset;
+    };
+
+    h.templateCount  = static_cast<uint32_t>(records.size());
+    h.templateOffset = append(records.data(), records.size() * sizeof(MobImageRecord));
+    h.tableCount     = static_cast<uint32_t>(tables.size());
+    h.tableOffset    = append(tables.data(), tables.size() * sizeof(MobImageTable));
+    h.entryCount     = static_cast<uint32_t>(entries.size());
+    h.entryOffset    = append(entries.data(), entries.size() * sizeof(MobImageTableEntry));
+
+    std::vector<uint32_t> flatIndex;
+    for (size_t d = 0; d < MOB_IMAGE_FAMILIES; ++d)
+    {
+        h.waveIndexFirst[d] = static_cast<uint32_t>(flatIndex.size());
+        h.waveIndexCount[d] = static_cast<uint32_t>(waveIndex[d].size());
+        flatIndex.insert(flatIndex.end(), waveIndex[d].begin(), waveIndex[d].end());
+    }
+    h.waveIndexOffset = append(flatIndex.data(), flatIndex.size() * sizeof(uint32_t));
+
+    h.stringBytes  = static_cast<uint32_t>(strings.size());
+    h.stringOffset = append(strings.data(), strings.size());
+
+    image.resize((image.size() + 7) & ~size_t(7), '\0');
+    h.fileSize = image.size();
+    h.checksum = MobImageChecksum(reinterpret_cast<const unsigned char*>(image.data()) + sizeof(MobImageHeader),
+                                  image.size() - sizeof(MobImageHeader));
+    std::memcpy(image.data(), &h, sizeof(MobImageHeader));
+    return image;
 }
 
-Combatant MobTemplateStore::CreateMobInstance(const std::string& mobId, int lane, int slot) const
+// =============================
+// image -> snapshot
+// =============================
+
+std::shared_ptr<MobTemplateStore::Snapshot> MobTemplateStore::SnapshotFromImage(
+    std::shared_ptr<const void> storage, const char* data, size_t size, bool mapped, std::string* err)
 {
-    const auto& t = Templates.at(mobId);
+    auto fail = [err](const std::string& why) -> std::shared_ptr<Snapshot>
+    {
+        if (err) *err = "Invalid mob template image: " + why;
+        return nullptr;
+    };
 
-    Combatant mob(t.displayName, ECombatantType::Mob);
-    mob.InitFromMobTemplate(
-        t.mobClass,
-        t.avatarId,
-        t.attackType,
-        t.difficulty,
-        t.speed,
-        t.maxHP,
-        t.maxEnergy,
-        t.maxMana,
-        t.baseDamage,
-        t.baseDefense
-    );
-    mob.SetLane(lane,slot);
-    return mob;
+    if (size < sizeof(MobImageHeader)) return fail("truncated header");
+    if (reinterpret_cast<uintptr_t>(data) % alignof(MobImageHeader) != 0) return fail("misaligned buffer");
+
+    const auto* h = reinterpret_cast<const MobImageHeader*>(data);
+    if (std::memcmp(h->magic, MOB_IMAGE_MAGIC, sizeof(h->magic)) != 0) return fail("bad magic");
+    if (h->version != MOB_IMAGE_VERSION)
+        return fail("version " + std::to_string(h->version) + ", expected " + std::to_string(MOB_IMAGE_VERSION));
+    if (h->headerSize != sizeof(MobImageHeader)) return fail("header size mismatch");
+    if (h->fileSize != size) return fail("file size mismatch");
+
+    const uint64_t sum = MobImageChecksum(reinterpret_cast<const unsigned char*>(data) + sizeof(MobImageHeader),
+                                          size - sizeof(MobImageHeader));
+    if (sum != h->checksum) return fail("checksum mismatch");
+
+    auto section = [size](uint32_t offset, uint64_t count, uint64_t elemSize)
+    {
+        return offset % 4 == 0 && offset >= sizeof(MobImageHeader) && offset + count * elemSize <= size;
+    };
+    uint64_t waveIndexTotal = 0;
+    for (size_t d = 0; d < MOB_IMAGE_FAMILIES; ++d)
+    {
+        if (h->waveIndexFirst[d] != waveIndexTotal) return fail("wave index layout");
+        waveIndexTotal += h->waveIndexCount[d];
+    }
+    if (!section(h->templateOffset, h->templateCount, sizeof(MobImageRecord))) return fail("template section");
+    if (!section(h->tableOffset, h->tableCount, sizeof(MobImageTable)))        return fail("table section");
+    if (!section(h->entryOffset, h->entryCount, sizeof(MobImageTableEntry)))   return fail("entry section");
+    if (!section(h->waveIndexOffset, waveIndexTotal, sizeof(uint32_t)))        return fail("wave index section");
+    if (h->stringOffset < sizeof(MobImageHeader) || uint64_t(h->stringOffset) + h->stringBytes > size)
+        return fail("string section");
+
+    auto snap = std::make_shared<Snapshot>();
+    snap->Header        = h;
+    snap->Records       = reinterpret_cast<const MobImageRecord*>(data + h->templateOffset);
+    snap->Tables        = reinterpret_cast<const MobImageTable*>(data + h->tableOffset);
+    snap->Entries       = reinterpret_cast<const MobImageTableEntry*>(data + h->entryOffset);
+    snap->WaveIndex     = reinterpret_cast<const uint32_t*>(data + h->waveIndexOffset);
+    snap->Strings       = data + h->stringOffset;
+    snap->TemplateCount = h->templateCount;
+
+    // every reference must stay inside the image, so readers never bounds-check again
+    auto validString = [h](const MobImageString& s)
+    {
+        return uint64_t(s.offset) + s.length < h->stringBytes;
+    };
+    for (uint32_t i = 0; i < h->templateCount; ++i)
+    {
+        const MobImageRecord& r = snap->Records[i];
+        if (!validString(r.id) || !validString(r.displayName) || !validString(r.mobClass) || !validString(r.avatarId))
+            return fail("string reference of template " + std::to_string(i));
+        if (r.attackType > static_cast<uint8_t>(ECombatantAttackType::Bomb) || r.difficulty >= MOB_IMAGE_DIFFICULTIES)
+            return fail("enum value of template " + std::to_string(i));
+        if (i > 0 && !(snap->Str(snap->Records[i - 1].id) < snap->Str(r.id)))
+            return fail("templates not sorted by id");
+    }
+    for (uint32_t t = 0; t < h->tableCount; ++t)
+    {
+        const MobImageTable& table = snap->Tables[t];
+        if (table.count == 0 || uint64_t(table.firstEntry) + table.count > h->entryCount)
+            return fail("spawn table " + std::to_string(t));
+        for (uint32_t i = 0; i < table.count; ++i)
+        {
+            const MobImageTableEntry& e = snap->Entries[table.firstEntry + i];
+            if (e.templateIndex >= h->templateCount || e.alias >= table.count)
+                return fail("spawn table entry " + std::to_string(t) + "/" + std::to_string(i));
+        }
+    }
+    for (uint64_t i = 0; i < waveIndexTotal; ++i)
+    {
+        if (snap->WaveIndex[i] != MOB_IMAGE_NO_TABLE && snap->WaveIndex[i] >= h->tableCount)
+            return fail("wave index entry " + std::to_string(i));
+    }
+
+    // rolled once per load like before: Normal mobs randomly run at double speed
+    snap->Speed.resize(h->templateCount);
+    for (uint32_t i = 0; i < h->templateCount; ++i)
+    {
+        const MobImageRecord& r = snap->Records[i];
+        if (static_cast<ECombatantDifficulty>(r.difficulty) == ECombatantDifficulty::Normal && GetRandomFloat(0.f,10.f)>5.f)
+            snap->Speed[i] = 2.f * r.speed;
+        else
+            snap->Speed[i] = r.speed;
+    }
+
+    snap->Storage = std::move(storage);
+    snap->Mapped  = mapped;
+    return snap;
+}
+
+std::shared_ptr<MobTemplateStore::Snapshot> MobTemplateStore::LoadJson(const std::string& path, std::string* err)
+{
+    std::vector<MobTemplate> templates;
+    if (!ParseJson(path, templates, err)) return nullptr;
+
+    auto buffer = std::make_shared<const std::vector<char>>(BuildImage(std::move(templates)));
+    const char* data = buffer->data();
+    const size_t size = buffer->size();
+    return SnapshotFromImage(std::shared_ptr<const void>(buffer, data), data, size, false, err);
+}
+
+std::shared_ptr<MobTemplateStore::Snapshot> MobTemplateStore::MapImage(const std::string& path, std::string* err)
+{
+#ifndef _WIN32
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        if (err) *err = "Cannot open mob template image: " + path;
+        return nullptr;
+    }
+
+    struct stat st{};
+    if (::fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ::close(fd);
+        if (err) *err = "Cannot stat mob template image: " + path;
+        return nullptr;
+    }
+
+    const size_t len = static_cast<size_t>(st.st_size);
+    void* addr = ::mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        if (err) *err = "Cannot mmap mob template image: " + path;
+        return nullptr;
+    }
+
+    std::shared_ptr<const void> storage(addr, [len](const void* p){ ::munmap(const_cast<void*>(p), len); });
+    return SnapshotFromImage(std::move(storage), static_cast<const char*>(addr), len, true, err);
+#else
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        if (err) *err = "Cannot open mob template image: " + path;
+        return nullptr;
+    }
+    auto buffer = std::make_shared<const std::vector<char>>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    const char* data = buffer->data();
+    const size_t size = buffer->size();
+    return SnapshotFromImage(std::shared_ptr<const void>(buffer, data), data, size, false, err);
+#endif
+}
+
+std::string MobTemplateStore::ImagePathFor(const std::string& jsonPath)
+{
+    std::filesystem::path p(jsonPath);
+    p.replace_extension(".bin");
+    return p.string();
 }
 
-std::string MobTemplateStore::PickRandomMobId()
+bool MobTemplateStore::CheckImage(const std::string& imagePath, size_t* templates, std::string* err)
 {
-    if (Keys.empty()) return {};
-    std::uniform_int_distribution<size_t> dist(0, Keys.size() - 1);
-    return Keys[dist(rng)];
+    auto snap = MapImage(imagePath, err);
+    if (!snap) return false;
+    if (templates) *templates = snap->Size();
+    return true;
 }
 
-std::string MobTemplateStore::PickRandomMobIdForWave(int wave)
+bool MobTemplateStore::CompileJsonToImage(const std::string& jsonPath, const std::string& imagePath, std::string* err)
 {
-    std::vector<std::string> waveKeys;
+    std::vector<MobTemplate> templates;
+    if (!ParseJson(jsonPath, templates, err)) return false;
+
+    const std::vector<char> image = BuildImage(std::move(templates));
 
-    for (const auto& key : Keys)
+    // self-check before anything touches the disk
+    if (!SnapshotFromImage(nullptr, image.data(), image.size(), false, err)) return false;
+
+    // write + rename, so a running server never maps a half written file
+    const std::string tmpPath = imagePath + ".tmp";
     {
-        auto it = Templates.find(key);
-        if (it == Templates.end())
-            continue;
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            if (err) *err = "Cannot write mob template image: " + tmpPath;
+            return false;
+        }
+        out.write(image.data(), static_cast<std::streamsize>(image.size()));
+        if (!out) {
+            if (err) *err = "Write failed: " + tmpPath;
+            return false;
+        }
+    }
 
-        if (it->second.wave == wave && it->second.difficulty==ECombatantDifficulty::Normal)
-        {
-            waveKeys.push_back(key);
+    std::error_code ec;
+    std::filesystem::rename(tmpPath, imagePath, ec);
+    if (ec) {
+        if (err) *err = "Cannot rename " + tmpPath + " -> " + imagePath + ": " + ec.message();
+        return false;
+    }
+    return true;
+}
+
+// =============================
+// Store
+// =============================
+
+bool MobTemplateStore::LoadFromFile(const std::string& path, std::string* err)
+{
+    namespace fs = std::filesystem;
+
+    std::shared_ptr<const Snapshot> next;
+
+    // prefer the compiled image unless the json was edited after compiling it
+    const std::string imagePath = ImagePathFor(path);
+    std::error_code imageEc, jsonEc;
+    const auto imageTime = fs::last_write_time(imagePath, imageEc);
+    const auto jsonTime  = fs::last_write_time(path, jsonEc);
+    if (!imageEc)
+    {
+        if (jsonEc || imageTime >= jsonTime) {
+            std::string imageErr;
+            next = MapImage(imagePath, &imageErr);
+            if (!next) DaraLog("ERROR", "Mob template image unusable, falling back to json: "+imageErr);
+        } else {
+            DaraLog("FILE", "Mob template image "+imagePath+" is older than "+path+", loading json");
         }
     }
 
-    if (waveKeys.empty())
-        return {};
+    if (!next) next = LoadJson(path, err);
+    if (!next) return false;
 
-    std::uniform_int_distribution<size_t> dist(0, waveKeys.size() - 1);
-    return waveKeys[dist(rng)];
+    // RCU publish: readers that still hold the old snapshot keep using it until
+    // they drop their reference.
+    Current.store(std::move(next), std::memory_order_release);
+    Generation.fetch_add(1, std::memory_order_relaxed);
+    return true;
 }
 
-std::string MobTemplateStore::PickRandomBossForWave(int wave, ECombatantDifficulty difficulty)
+bool MobTemplateStore::HasTemplate(std::string_view mobId) const
 {
-    std::vector<std::string> matches;
+    return Acquire()->HasTemplate(mobId);
+}
+
+std::shared_ptr<Combatant> MobTemplateStore::CreateMobInstancePtr(std::string_view mobId, int lane, int slot) const
+{
+    const SnapshotPtr snap = Acquire();
+    if (!snap->HasTemplate(mobId)) return nullptr;
+    return snap->CreateMobInstancePtr(mobId, lane, slot);
+}
+
+void MobTemplateStore::StartWatching(const std::string& path, std::chrono::milliseconds interval)
+{
+    bool expected = false;
+    if (!Watching.compare_exchange_strong(expected, true))
+        return; // already watching
+
+    Watcher = std::thread([this, path, interval]() { WatchLoop(path, interval); });
+}
+
+void MobTemplateStore::StopWatching()
+{
+    bool expected = true;
+    if (!Watching.compare_exchange_strong(expected, false))
+        return; // not watching
 
-    for (const auto& key : Keys)
     {
-        auto it = Templates.find(key);
-        if (it == Templates.end())
-            continue;
+        std::lock_guard<std::mutex> lk(WatchMutex);
+        WatchCv.notify_all();
+    }
 
-        if (it->second.wave == wave && it->second.difficulty == difficulty)
+    if (Watcher.joinable())
+        Watcher.join();
+}
+
+void MobTemplateStore::WatchLoop(std::string path, std::chrono::milliseconds interval)
+{
+    namespace fs = std::filesystem;
+
+    const std::string imagePath = ImagePathFor(path);
+    auto lastChange = [&]()
+    {
+        std::error_code ec;
+        fs::file_time_type newest = fs::file_time_type::min();
+        for (const auto& p : { path, imagePath })
         {
-            matches.push_back(key);
+            const auto t = fs::last_write_time(p, ec);
+            if (!ec && t > newest) newest = t;
+        }
+        return newest;
+    };
+
+    fs::file_time_type lastWrite = lastChange();
+
+    while (Watching.load())
+    {
+        {
+            std::unique_lock<std::mutex> lk(WatchMutex);
+            WatchCv.wait_for(lk, interval, [this]{ return !Watching.load(); });
+        }
+        if (!Watching.load()) break;
+
+        const fs::file_time_type nowWrite = lastChange();
+        if (nowWrite == lastWrite) continue;
+        lastWrite = nowWrite;
+
+        std::string err;
+        if (!LoadFromFile(path, &err)) {
+            DaraLog("ERROR", "Mob template reload from "+path+" failed, keeping current templates: "+err);
+            continue;
         }
+        const SnapshotPtr snap = Acquire();
+        DaraLog("FILE", "Reloaded mob templates from "+std::string(snap->IsMapped() ? imagePath : path)
+            +" ("+std::to_string(snap->Size())+" templates, generation "+std::to_string(GetGeneration())+")");
     }
+}
+
+// =============================
+// Snapshot
+// =============================
+
+const MobImageRecord* MobTemplateStore::Snapshot::FindRecord(std::string_view mobId) const
+{
+    const MobImageRecord* end = Records + TemplateCount;
+    const MobImageRecord* it = std::lower_bound(Records, end, mobId,
+        [this](const MobImageRecord& r, std::string_view id){ return Str(r.id) < id; });
+    return (it != end && Str(it->id) == mobId) ? it : nullptr;
+}
+
+bool MobTemplateStore::Snapshot::HasTemplate(std::string_view mobId) const
+{
+    return FindRecord(mobId) != nullptr;
+}
+
+std::shared_ptr<Combatant> MobTemplateStore::Snapshot::CreateMobInstancePtr(std::string_view mobId, int lane, int slot) const
+{
+    Combatant tmp = CreateMobInstance(mobId, lane, slot);          // creates by value
+    return std::make_shared<Combatant>(std::move(tmp)); // wraps into shared_ptr
+}
+
+Combatant MobTemplateStore::Snapshot::CreateMobInstance(std::string_view mobId, int lane, int slot) const
+{
+    const MobImageRecord* t = FindRecord(mobId);
+    if (!t) throw std::out_of_range("Unknown mob template: " + std::string(mobId));
 
-    if (matches.empty())
-        return {};
+    Combatant mob(std::string(Str(t->displayName)), ECombatantType::Mob);
+    InitMobInstance(mob, mobId, lane, slot);
+    return mob;
+}
+
+bool MobTemplateStore::Snapshot::InitMobInstance(Combatant& mob, std::string_view mobId, int lane, int slot) const
+{
+    const MobImageRecord* t = FindRecord(mobId);
+    if (!t) return false;
 
-    std::uniform_int_distribution<size_t> dist(0, matches.size() - 1);
-    return matches[dist(rng)];
+    mob.InitName(Str(t->displayName));
+    mob.InitFromMobTemplate(
+        Str(t->mobClass),
+        Str(t->avatarId),
+        static_cast<ECombatantAttackType>(t->attackType),
+        static_cast<ECombatantDifficulty>(t->difficulty),
+        Speed[t - Records],
+        t->maxHP,
+        t->maxEnergy,
+        t->maxMana,
+        t->baseDamage,
+        t->baseDefense
+    );
+    mob.SetLane(lane,slot);
+    return true;
+}
+
+std::string_view MobTemplateStore::Snapshot::SampleTable(const MobImageTable& t) const
+{
+    const MobImageTableEntry* e = Entries + t.firstEntry;
+    const size_t n = t.count;
+    if (n == 1) return Str(Records[e[0].templateIndex].id);
+
+    std::uniform_real_distribution<double> dist(0.0, static_cast<double>(n));
+    const double x = dist(SpawnRng());
+    const size_t i = std::min(static_cast<size_t>(x), n - 1);
+    const float coin = static_cast<float>(x - static_cast<double>(i));
+
+    const size_t slot = coin < e[i].prob ? i : e[i].alias;
+    return Str(Records[e[slot].templateIndex].id);
+}
+
+const MobImageTable* MobTemplateStore::Snapshot::FindSpawnTable(int wave, size_t family) const
+{
+    if (!Header || wave < 0 || family >= MOB_IMAGE_FAMILIES) return nullptr;
+
+    const uint32_t count = Header->waveIndexCount[family];
+    if (count == 0) return nullptr;
+
+    // past the family's highest wave: its last table, never another family's
+    const uint32_t w = std::min(static_cast<uint32_t>(wave), count - 1);
+    const uint32_t t = WaveIndex[Header->waveIndexFirst[family] + w];
+    return t == MOB_IMAGE_NO_TABLE ? nullptr : &Tables[t];
+}
+
+std::string_view MobTemplateStore::Snapshot::PickRandomMobId() const
+{
+    if (TemplateCount == 0) return {};
+    std::uniform_int_distribution<uint32_t> dist(0, TemplateCount - 1);
+    return Str(Records[dist(SpawnRng())].id);
+}
+
+std::string_view MobTemplateStore::Snapshot::PickRandomMobIdForWave(int wave) const
+{
+    return PickRandomBossForWave(wave, ECombatantDifficulty::Normal);
+}
+
+std::string_view MobTemplateStore::Snapshot::PickRandomBossForWave(int wave, ECombatantDifficulty difficulty) const
+{
+    const MobImageTable* t = FindSpawnTable(wave, static_cast<size_t>(difficulty));
+    if (!t) return {};
+    return SampleTable(*t);
+}
+
+std::string_view MobTemplateStore::Snapshot::PickRandomBombForWave(int wave) const
+{
+    const MobImageTable* t = FindSpawnTable(wave, MOB_IMAGE_BOMB_FAMILY);
+    if (!t) return {};
+    return SampleTable(*t);
 }
 
 
@@ -2,29 +2,113 @@
 #include <unordered_map>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <random>
+#include <cstdint>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <filesystem>
 #include "json.hpp"
 #include "combatant.h"
+#include "MobTemplateImage.h"
 
 class MobTemplateStore
 {
 public:
     using json = nlohmann::json;
 
+    // Immutable set of templates + spawn tables. It is a read-only view over a
+    // compiled template image (see MobTemplateImage.h), either mmapped from
+    // mobs/mobdb.bin or compiled in memory from mobdb.json. Readers hold a
+    // SnapshotPtr for as long as they use string_views returned from it; a reload
+    // never mutates it.
+    class Snapshot
+    {
+    public:
+        bool HasTemplate(std::string_view mobId) const;
+        Combatant CreateMobInstance(std::string_view mobId, int lane, int slot) const;
+        std::shared_ptr<Combatant> CreateMobInstancePtr(std::string_view mobId, int lane, int slot) const;
+        // (re)initializes an existing mob in place, e.g. one recycled by MobPool;
+        // false if mobId is not part of this snapshot
+        bool InitMobInstance(Combatant& mob, std::string_view mobId, int lane, int slot) const;
+
+        // random picking
+        // Picks are O(1) and allocation free: they sample the prebuilt spawn tables
+        // and return a view into the snapshot (empty = no match).
+        bool Empty() const { return TemplateCount == 0; }
+        size_t Size() const { return TemplateCount; }
+        bool IsMapped() const { return Mapped; }
+        std::string_view PickRandomMobId() const;
+        std::string_view PickRandomMobIdForWave(int wave) const;
+        std::string_view PickRandomBossForWave(int wave,  ECombatantDifficulty difficulty= ECombatantDifficulty::Boss) const;
+        // bombs (attackType Bomb) have their own spawn tables, apart from the difficulties
+        std::string_view PickRandomBombForWave(int wave) const;
+
+    private:
+        friend class MobTemplateStore;
+
+        // keeps the image bytes alive (mmap region or heap buffer)
+        std::shared_ptr<const void> Storage;
+        bool Mapped = false;
+
+        const MobImageHeader* Header = nullptr;
+        const MobImageRecord* Records = nullptr;
+        const MobImageTable* Tables = nullptr;
+        const MobImageTableEntry* Entries = nullptr;
+        const uint32_t* WaveIndex = nullptr;
+        const char* Strings = nullptr;
+        uint32_t TemplateCount = 0;
+
+        // speed per record as rolled at load (Normal mobs randomly run double speed)
+        std::vector<float> Speed;
+
+        std::string_view Str(const MobImageString& s) const { return std::string_view(Strings + s.offset, s.length); }
+        const MobImageRecord* FindRecord(std::string_view mobId) const;
+        // family: an ECombatantDifficulty or MOB_IMAGE_BOMB_FAMILY
+        const MobImageTable* FindSpawnTable(int wave, size_t family) const;
+        std::string_view SampleTable(const MobImageTable& t) const;
+    };
+    using SnapshotPtr = std::shared_ptr<const Snapshot>;
+
+    MobTemplateStore();
+    ~MobTemplateStore();
+
+    MobTemplateStore(const MobTemplateStore&) = delete;
+    MobTemplateStore& operator=(const MobTemplateStore&) = delete;
+
+    // Loads `path` (mobdb.json) and swaps the new snapshot in. If a compiled image
+    // (same name, .bin extension) exists and is not older than the json, it is
+    // mmapped instead of parsing the json. On failure the current snapshot stays.
     bool LoadFromFile(const std::string& path, std::string* err = nullptr);
 
-    bool HasTemplate(const std::string& mobId) const;
-    Combatant CreateMobInstance(const std::string& mobId, int lane, int slot) const;
-    
-    std::shared_ptr<Combatant> CreateMobInstancePtr(const std::string& mobId, int lane, int slot) const;
+    // Offline compiler (mobcompile): mobdb.json -> binary template image
+    static bool CompileJsonToImage(const std::string& jsonPath, const std::string& imagePath, std::string* err = nullptr);
+    static std::string ImagePathFor(const std::string& jsonPath);
+    // maps `imagePath` and runs the loader's checks on it (mobcompile's read-back)
+    static bool CheckImage(const std::string& imagePath, size_t* templates = nullptr, std::string* err = nullptr);
+
+    // Lock-free for readers (no mutex): grab the current snapshot.
+    SnapshotPtr Acquire() const { return Current.load(std::memory_order_acquire); }
+    uint64_t GetGeneration() const { return Generation.load(std::memory_order_relaxed); }
+
+    // convenience wrappers on the current snapshot
+    bool HasTemplate(std::string_view mobId) const;
+    // returns nullptr if mobId is not part of the current snapshot (e.g. removed by a reload)
+    std::shared_ptr<Combatant> CreateMobInstancePtr(std::string_view mobId, int lane, int slot) const;
 
-    // random picking
-    bool Empty() const { return Keys.empty(); }
-    std::string PickRandomMobId();
-    std::string PickRandomMobIdForWave(int wave);
-    std::string PickRandomBossForWave(int wave,  ECombatantDifficulty difficulty= ECombatantDifficulty::Boss);
+    // Hot reload: a background thread polls the json's and the image's mtime and
+    // rebuilds the snapshot off the game thread when one of them changes.
+    void StartWatching(const std::string& path, std::chrono::milliseconds interval);
+    void StopWatching();
 
 private:
+    static constexpr int kMaxTemplateWave = 65535;
+
+    // build-time form of a template (json -> image)
     struct MobTemplate {
         std::string id;
         std::string displayName;
@@ -33,6 +117,7 @@ private:
         ECombatantAttackType attackType;
         ECombatantDifficulty difficulty;
         float speed;
+        float spawnWeight = 1.f; // optional "spawnWeight" in mobdb.json
         int wave;
         int maxHP;
         int maxEnergy;
@@ -41,11 +126,27 @@ private:
         int baseDefense;
     };
 
-    std::unordered_map<std::string, MobTemplate> Templates;
-    std::vector<std::string> Keys;
+    static bool ParseJson(const std::string& path, std::vector<MobTemplate>& out, std::string* err);
+    static std::vector<char> BuildImage(std::vector<MobTemplate> templates);
+    static void BuildAliasTable(const std::vector<std::pair<uint32_t, float>>& entries,
+                                std::vector<MobImageTableEntry>& out);
 
-    mutable std::mt19937 rng{ std::random_device{}() };
+    static std::shared_ptr<Snapshot> SnapshotFromImage(std::shared_ptr<const void> storage, const char* data,
+                                                       size_t size, bool mapped, std::string* err);
+    static std::shared_ptr<Snapshot> LoadJson(const std::string& path, std::string* err);
+    static std::shared_ptr<Snapshot> MapImage(const std::string& path, std::string* err);
 
     static ECombatantAttackType ParseAttackType(const std::string& s);
     static ECombatantDifficulty ParseDifficulty(const std::string& s);
+
+    void WatchLoop(std::string path, std::chrono::milliseconds interval);
+
+    std::atomic<SnapshotPtr> Current;
+    std::atomic<uint64_t> Generation{0};
+
+    // watcher thread
+    std::thread Watcher;
+    std::atomic<bool> Watching{false};
+    std::mutex WatchMutex;
+    std::condition_variable WatchCv;
 };
@@ -0,0 +1,284 @@
+#include <mysql_driver.h>
+#include <mysql_connection.h>
+#include <cppconn/prepared_statement.h>
+#include <cppconn/resultset.h>
+#include <cppconn/exception.h>
+
+#include <memory>
+#include <string>
+#include <stdexcept>
+#include <vector>
+#include <algorithm>
+#include "MySqlCharacterStore.h"
+#include "DbConnectionPool.h"
+
+// =======================================================
+// CREATE CHARACTER
+// Returns new CharacterId
+// =======================================================
+int MySqlCharacterStore::CreateCharacter(
+    const std::string& userId,
+    const std::string& userEmail,
+    const std::string& characterName,
+    const std::string& characterClass,
+    const std::string& avatar
+)
+{
+    auto con = g_dbPool.Acquire();
+    DaraLog("DB", "Before Create character");
+
+    sql::PreparedStatement* stmt = con.Prepare(
+        R"(
+            INSERT INTO Characters
+            (UserId, UserEmail, CharacterName, CharacterClass, Avatar)
+            VALUES (?, ?, ?, ?, ?)
+        )"
+    );
+
+    stmt->setString(1, userId);
+    stmt->setString(2, userEmail);
+    stmt->setString(3, characterName);
+    stmt->setString(4, characterClass);
+    stmt->setString(5, avatar);
+
+    stmt->executeUpdate();
+
+    DaraLog("DB", "After Create character");
+    // Fetch auto-increment id
+    sql::PreparedStatement* idStmt = con.Prepare("SELECT LAST_INSERT_ID()");
+
+    std::unique_ptr<sql::ResultSet> rs(idStmt->executeQuery());
+    if (!rs->next())
+        throw std::runtime_error("Failed to retrieve CharacterId");
+
+    return rs->getInt(1);
+}
+
+// =======================================================
+// UPDATE CHARACTERS (batched write-behind flush)
+// UPDATE ... JOIN a derived table instead of INSERT ... ON DUPLICATE KEY,
+// so a character deleted meanwhile is not recreated as a partial row.
+// =======================================================
+static std::string BuildBatchUpdateSql(size_t rows)
+{
+    std::string sqlText =
+        "UPDATE Characters c JOIN ("
+        "SELECT ? AS Id, ? AS Level, ? AS XP, ? AS Credits, ? AS Potions, ? AS Wave";
+    for (size_t i = 1; i < rows; ++i)
+        sqlText += " UNION ALL SELECT ?, ?, ?, ?, ?, ?";
+    sqlText +=
+        ") v ON c.CharacterId = v.Id "
+        "SET c.Level = v.Level, c.XP = v.XP, c.Credits = v.Credits, c.Potions = v.Potions, "
+        "c.highestWave = GREATEST(c.highestWave, v.Wave), "
+        "c.StoreTime = CURRENT_TIMESTAMP";
+    return sqlText;
+}
+
+void MySqlCharacterStore::UpdateCharactersBatch(const std::vector<CharacterSave>& rows)
+{
+    if (rows.empty()) return;
+
+    auto con = g_dbPool.Acquire();
+    con->setAutoCommit(false);
+    try
+    {
+        const size_t chunk = DARA_DB_FLUSH_BATCH_ROWS;
+        for (size_t first = 0; first < rows.size(); first += chunk)
+        {
+            const size_t n = std::min(chunk, rows.size() - first);
+            // full chunks all share one cached statement
+            sql::PreparedStatement* stmt = con.Prepare(BuildBatchUpdateSql(n));
+
+            unsigned idx = 1;
+            for (size_t i = first; i < first + n; ++i)
+            {
+                const CharacterSave& r = rows[i];
+                stmt->setInt(idx++, r.characterId);
+                stmt->setInt(idx++, r.level);
+                stmt->setInt(idx++, r.xp);
+                stmt->setInt(idx++, r.credits);
+                stmt->setInt(idx++, r.potions);
+                stmt->setInt(idx++, r.highestWave);
+            }
+            stmt->executeUpdate();
+        }
+        con->commit();
+    }
+    catch (...)
+    {
+        try { con->rollback(); } catch (...) {}
+        try { con->setAutoCommit(true); } catch (...) {}
+        throw;
+    }
+    con->setAutoCommit(true);
+}
+
+// =======================================================
+// REMOVE CHARACTER
+// (delete character slot)
+// =======================================================
+bool MySqlCharacterStore::RemoveCharacter(const std::string& userId, int characterId)
+{
+    auto con = g_dbPool.Acquire();
+
+    sql::PreparedStatement* stmt = con.Prepare(
+        "DELETE FROM Characters WHERE UserId= ? AND CharacterId = ?"
+    );
+
+    stmt->setString(1, userId);
+    stmt->setInt(2, characterId);
+    return stmt->executeUpdate() > 0;
+}
+
+// =======================================================
+// GET CHARACTERS FOR USER (by email)
+// Returns all character rows for that email, newest first
+// =======================================================
+// one row of the character selects below
+static CharacterRecord ReadCharacterRecord(sql::ResultSet& rs)
+{
+    CharacterRecord c{};
+    c.characterId    = rs.getInt("CharacterId");
+    c.userId         = rs.getString("UserId");
+    c.usereMail      = rs.getString("UserEmail");
+    c.characterName  = rs.getString("CharacterName");
+    c.characterClass = rs.getString("CharacterClass");
+    c.avatar         = rs.getString("Avatar");
+    c.level          = rs.getInt("Level");
+    c.xp             = rs.getInt("XP");
+    c.credits        = rs.getInt("Credits");
+    c.potions        = rs.getInt("Potions");
+    c.highestWave = rs.getInt("highestWave");
+
+    // StoreTime can be NULL if you ever insert NULL explicitly; your schema defaults to CURRENT_TIMESTAMP,
+    // so normally it's always present.
+    // Convert to string (YYYY-MM-DD HH:MM:SS):
+    try {
+        c.storeTime = rs.getString("StoreTime");
+    } catch (...) {
+        c.storeTime = "";
+    }
+    return c;
+}
+
+std::vector<CharacterRecord> MySqlCharacterStore::GetCharactersForUser(const std::string& userMail)
+{
+    auto con = g_dbPool.Acquire();
+
+    sql::PreparedStatement* stmt = con.Prepare(
+        R"(
+            SELECT
+                CharacterId,
+                UserId,
+                UserEmail,
+                CharacterName,
+                CharacterClass,
+                Avatar,
+                Level,
+                XP,
+                Credits,
+                Potions,
+                highestWave,
+                StoreTime
+            FROM Characters
+            WHERE UserEmail = ?
+            ORDER BY CharacterId DESC
+        )"
+    );
+
+    stmt->setString(1, userMail);
+
+    std::unique_ptr<sql::ResultSet> rs(stmt->executeQuery());
+
+    std::vector<CharacterRecord> out;
+    out.reserve(8);
+
+    while (rs->next())
+    {
+        CharacterRecord c = ReadCharacterRecord(*rs);
+        DaraLog("DEBUGDB", "Avatar: "+c.avatar);
+        out.push_back(std::move(c));
+    }
+
+    return out;
+}
+
+// =======================================================
+// CHARACTERS OF RECENTLY ACTIVE USERS (startup warm-up)
+// One query, rows handed over as they are read, grouped by user.
+// =======================================================
+void MySqlCharacterStore::ForEachCharacterOfActiveUsers(int64_t activeWithinSec, size_t maxUsers,
+                                                        const std::function<void(CharacterRecord&&)>& fn)
+{
+    auto con = g_dbPool.Acquire();
+
+    sql::PreparedStatement* stmt = con.Prepare(
+        R"(
+            SELECT
+                c.CharacterId,
+                c.UserId,
+                c.UserEmail,
+                c.CharacterName,
+                c.CharacterClass,
+                c.Avatar,
+                c.Level,
+                c.XP,
+                c.Credits,
+                c.Potions,
+                c.highestWave,
+                c.StoreTime
+            FROM Characters c
+            JOIN (
+                SELECT UserEmail
+                FROM Characters
+                GROUP BY UserEmail
+                HAVING MAX(StoreTime) >= (NOW() - INTERVAL ? SECOND)
+                ORDER BY MAX(StoreTime) DESC
+                LIMIT ?
+            ) a ON a.UserEmail = c.UserEmail
+            ORDER BY c.UserEmail, c.CharacterId DESC
+        )"
+    );
+    stmt->setInt64(1, activeWithinSec);
+    stmt->setUInt64(2, maxUsers);
+
+    std::unique_ptr<sql::ResultSet> rs(stmt->executeQuery());
+    while (rs->next())
+        fn(ReadCharacterRecord(*rs));
+}
+
+// =======================================================
+// RANK ROWS (LeaderboardService load)
+// =======================================================
+std::vector<CharacterRankRow> MySqlCharacterStore::GetRankRows()
+{
+    auto con = g_dbPool.Acquire();
+    // age instead of the timestamp itself: immune to clock skew between DB and server
+    sql::PreparedStatement* stmt = con.Prepare(
+        R"(
+            SELECT
+                CharacterId, CharacterName, UserEmail, Avatar,
+                highestWave, Level, Credits, Potions,
+                TIMESTAMPDIFF(SECOND, StoreTime, NOW()) AS AgeSec
+            FROM Characters
+        )"
+    );
+    std::unique_ptr<sql::ResultSet> rs(stmt->executeQuery());
+
+    std::vector<CharacterRankRow> out;
+    while (rs->next())
+    {
+        CharacterRankRow r;
+        r.characterId   = rs->getInt("CharacterId");
+        r.characterName = rs->getString("CharacterName");
+        r.userEmail     = rs->getString("UserEmail");
+        r.avatar        = rs->getString("Avatar");
+        r.highestWave   = rs->getInt("highestWave");
+        r.level         = rs->getInt("Level");
+        r.credits       = rs->getInt("Credits");
+        r.potions       = rs->getInt("Potions");
+        r.ageSec        = rs->getInt64("AgeSec");
+        out.push_back(std::move(r));
+    }
+    return out;
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include "CharacterStore.h"
+
+// the Characters table; connections come from g_dbPool
+class MySqlCharacterStore : public ICharacterStore
+{
+public:
+    const char* Name() const override { return "mysql"; }
+
+    int CreateCharacter(const std::string& userId,
+                        const std::string& userEmail,
+                        const std::string& characterName,
+                        const std::string& characterClass,
+                        const std::string& avatar) override;
+    std::vector<CharacterRecord> GetCharactersForUser(const std::string& userEmail) override;
+    void UpdateCharactersBatch(const std::vector<CharacterSave>& rows) override;
+    bool RemoveCharacter(const std::string& userId, int characterId) override;
+    void ForEachCharacterOfActiveUsers(int64_t activeWithinSec, size_t maxUsers,
+                                       const std::function<void(CharacterRecord&&)>& fn) override;
+
+    std::vector<CharacterRankRow> GetRankRows() override;
+};
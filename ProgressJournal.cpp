@@ -0,0 +1,320 @@
+#include "ProgressJournal.h"
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cctype>
+#include <fcntl.h>
+#ifndef _WIN32
+#include <unistd.h>
+#else
+#include <io.h>
+#endif
+#include "BinaryIo.h"
+
+namespace
+{
+    uint32_t RecordCrc(const ProgressJournalRecord& r)
+    {
+        return Crc32(reinterpret_cast<const char*>(&r) + sizeof(r.crc), sizeof(r) - sizeof(r.crc));
+    }
+
+    // latest wins, highestWave keeps the max (like the DB worker's buffer)
+    void Merge(std::unordered_map<int, CharacterSave>& into, const CharacterSave& s)
+    {
+        auto [it, inserted] = into.try_emplace(s.characterId, s);
+        if (!inserted) {
+            const int wave = std::max(it->second.highestWave, s.highestWave);
+            it->second = s;
+            it->second.highestWave = wave;
+        }
+    }
+}
+
+ProgressJournal::~ProgressJournal()
+{
+    Stop();
+}
+
+ProgressJournalRecord ProgressJournal::MakeRecord(const CharacterSave& s)
+{
+    ProgressJournalRecord r{};
+    r.characterId = s.characterId;
+    r.level       = s.level;
+    r.xp          = s.xp;
+    r.credits     = s.credits;
+    r.potions     = s.potions;
+    r.highestWave = s.highestWave;
+    r.crc         = RecordCrc(r);
+    return r;
+}
+
+bool ProgressJournal::Open(const std::string& path, std::string* err)
+{
+    if (IsOpen()) return true;
+    path_ = path;
+
+    // ---- recover ----
+    std::unordered_map<int, CharacterSave> unsaved;
+    size_t records = 0;
+    bool tornTail = false;
+    if (std::filesystem::exists(path))
+    {
+        std::ifstream in(path, std::ios::binary);
+        ProgressJournalHeader h{};
+        if (!in.read(reinterpret_cast<char*>(&h), sizeof(h))
+            || std::memcmp(h.magic, PROGRESS_JOURNAL_MAGIC, sizeof(h.magic)) != 0
+            || h.version != PROGRESS_JOURNAL_VERSION
+            || h.recordSize != sizeof(ProgressJournalRecord))
+        {
+            // not ours (or a different version): keep it for inspection, start fresh
+            in.close();
+            std::error_code ec;
+            std::filesystem::rename(path, path + ".bad", ec);
+            DaraLog("JOURNAL", "Unreadable journal " + path + " moved to " + path + ".bad");
+        }
+        else
+        {
+            ProgressJournalRecord r{};
+            while (in.read(reinterpret_cast<char*>(&r), sizeof(r)))
+            {
+                if (r.crc != RecordCrc(r)) { tornTail = true; break; }
+                Merge(unsaved, CharacterSave{ r.characterId, r.level, r.xp, r.credits, r.potions, r.highestWave });
+                ++records;
+            }
+            if (in.gcount() > 0) tornTail = true;
+        }
+    }
+    if (tornTail)
+        DaraLog("JOURNAL", "Journal " + path + " has a torn tail after " + std::to_string(records) + " records, cut off");
+
+    // ---- rewrite with the recovered states only, then append to it ----
+    if (!Compact(unsaved)) {
+        if (err) *err = "Cannot write progress journal: " + path;
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        unsaved_ = std::move(unsaved);
+        stats_.replayed = unsaved_.size();
+        stats_.fileBytes = sizeof(ProgressJournalHeader) + unsaved_.size() * sizeof(ProgressJournalRecord);
+    }
+    open_.store(true, std::memory_order_release);
+
+    DaraLog("JOURNAL", "Opened " + path + ": " + std::to_string(records) + " records, "
+        + std::to_string(stats_.replayed) + " characters to replay");
+    return true;
+}
+
+void ProgressJournal::Start()
+{
+    if (!IsOpen()) return;
+    bool expected = false;
+    if (!running_.compare_exchange_strong(expected, true))
+        return; // already running
+
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stop_ = false;
+    }
+    th_ = std::thread([this]{ Run(); });
+}
+
+void ProgressJournal::Stop()
+{
+    if (running_.exchange(false))
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            stop_ = true;
+        }
+        cv_.notify_one();
+        if (th_.joinable()) th_.join();
+    }
+    if (!open_.exchange(false)) return;
+
+    // shutdown: the file keeps only what the DB did not confirm
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        needCompact_ = true;
+    }
+    GroupCommit();
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+}
+
+void ProgressJournal::Append(int characterId, int level, int xp, int credits, int potions, int highestWave)
+{
+    if (!IsOpen()) return;
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    Merge(unsaved_, CharacterSave{ characterId, level, xp, credits, potions, highestWave });
+    buffer_.push_back(MakeRecord(unsaved_[characterId]));
+    stats_.appended++;
+}
+
+void ProgressJournal::Append(const std::string& characterId, int level, int xp, int credits, int potions, int highestWave)
+{
+    // cache ids are strings, the DB id is the numeric CharacterId
+    if (characterId.empty() || !std::isdigit((unsigned char)characterId[0])) return;
+    Append(std::stoi(characterId), level, xp, credits, potions, highestWave);
+}
+
+void ProgressJournal::MarkSaved(const std::vector<CharacterSave>& rows)
+{
+    if (!IsOpen()) return;
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    for (const auto& row : rows)
+    {
+        auto it = unsaved_.find(row.characterId);
+        if (it == unsaved_.end()) continue;
+        const CharacterSave& s = it->second;
+        // a newer state journaled meanwhile stays unsaved
+        if (s.level == row.level && s.xp == row.xp && s.credits == row.credits
+            && s.potions == row.potions && s.highestWave <= row.highestWave)
+            unsaved_.erase(it);
+    }
+}
+
+std::vector<CharacterSave> ProgressJournal::Pending()
+{
+    std::vector<CharacterSave> rows;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        rows.reserve(unsaved_.size());
+        for (const auto& [id, s] : unsaved_) rows.push_back(s);
+    }
+    std::sort(rows.begin(), rows.end(),
+              [](const CharacterSave& a, const CharacterSave& b){ return a.characterId < b.characterId; });
+    return rows;
+}
+
+void ProgressJournal::Overlay(std::vector<Character>& chars)
+{
+    if (!IsOpen()) return;
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (unsaved_.empty()) return;
+    for (auto& ch : chars)
+    {
+        if (ch.characterId.empty() || !std::isdigit((unsigned char)ch.characterId[0])) continue;
+        auto it = unsaved_.find(std::stoi(ch.characterId));
+        if (it == unsaved_.end()) continue;
+        ch.level       = it->second.level;
+        ch.xp          = it->second.xp;
+        ch.credits     = it->second.credits;
+        ch.potions     = it->second.potions;
+        ch.highestWave = std::max(ch.highestWave, it->second.highestWave);
+    }
+}
+
+ProgressJournalStats ProgressJournal::GetStats()
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    ProgressJournalStats s = stats_;
+    s.unsaved = unsaved_.size();
+    return s;
+}
+
+// =============================
+// Group commit thread
+// =============================
+
+void ProgressJournal::Run()
+{
+    std::unique_lock<std::mutex> lock(mtx_);
+    while (!stop_)
+    {
+        cv_.wait_for(lock, std::chrono::milliseconds(DARA_JOURNAL_SYNC_MS), [this]{ return stop_; });
+        if (stop_) break;
+
+        lock.unlock();
+        GroupCommit();
+        lock.lock();
+    }
+}
+
+void ProgressJournal::GroupCommit()
+{
+    std::vector<ProgressJournalRecord> batch;
+    std::unordered_map<int, CharacterSave> snapshot;
+    bool compact = false;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        batch.swap(buffer_);
+        compact = needCompact_
+            || stats_.fileBytes + batch.size() * sizeof(ProgressJournalRecord) > DARA_JOURNAL_COMPACT_BYTES;
+        // the snapshot already holds every state in batch
+        if (compact) snapshot = unsaved_;
+        needCompact_ = false;
+    }
+    if (batch.empty() && !compact) return;
+
+    const auto t0 = std::chrono::steady_clock::now();
+    bool ok;
+    size_t fileBytes = 0;
+    if (compact)
+    {
+        ok = Compact(snapshot);
+        fileBytes = sizeof(ProgressJournalHeader) + snapshot.size() * sizeof(ProgressJournalRecord);
+    }
+    else
+    {
+        ok = WriteAll(fd_, batch.data(), batch.size() * sizeof(ProgressJournalRecord)) && SyncFd(fd_);
+    }
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (!ok)
+    {
+        // the states are still in unsaved_: the next round rewrites the file from them
+        needCompact_ = true;
+        stats_.failedSyncs++;
+        DaraLog("JOURNAL", "Write to " + path_ + " failed, rewriting on the next commit");
+        return;
+    }
+    stats_.syncs++;
+    stats_.written += batch.size();
+    stats_.lastSyncMs = ms;
+    stats_.maxSyncMs = std::max(stats_.maxSyncMs, ms);
+    if (compact) {
+        stats_.compactions++;
+        stats_.fileBytes = fileBytes;
+    } else {
+        stats_.fileBytes += batch.size() * sizeof(ProgressJournalRecord);
+    }
+}
+
+bool ProgressJournal::Compact(const std::unordered_map<int, CharacterSave>& unsaved)
+{
+    std::vector<char> data(sizeof(ProgressJournalHeader) + unsaved.size() * sizeof(ProgressJournalRecord));
+    ProgressJournalHeader h{};
+    std::memcpy(h.magic, PROGRESS_JOURNAL_MAGIC, sizeof(h.magic));
+    h.version = PROGRESS_JOURNAL_VERSION;
+    h.recordSize = sizeof(ProgressJournalRecord);
+    std::memcpy(data.data(), &h, sizeof(h));
+    char* out = data.data() + sizeof(h);
+    for (const auto& [id, s] : unsaved) {
+        const ProgressJournalRecord r = MakeRecord(s);
+        std::memcpy(out, &r, sizeof(r));
+        out += sizeof(r);
+    }
+
+    std::string err;
+    if (!ReplaceFileDurably(path_, std::string_view(data.data(), data.size()), &err)) {
+        DaraLog("JOURNAL", err);
+        return false;
+    }
+
+    // keep appending to the new file
+    if (fd_ >= 0) ::close(fd_);
+#ifndef _WIN32
+    fd_ = ::open(path_.c_str(), O_WRONLY | O_APPEND);
+#else
+    fd_ = ::_open(path_.c_str(), _O_WRONLY | _O_APPEND | _O_BINARY);
+#endif
+    return fd_ >= 0;
+}
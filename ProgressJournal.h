@@ -0,0 +1,119 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <unordered_map>
+#include <cstdint>
+#include "DaraConfig.h"
+#include "CharacterRepository.h"
+#include "character.h"
+
+// =======================================================
+// Local progress journal (DARA_JOURNAL_PATH)
+// Write-ahead log of character progress: every change is appended as one
+// fixed-size record and a background thread writes + fsyncs whatever
+// accumulated every DARA_JOURNAL_SYNC_MS (group commit), so gameplay never
+// waits for the disk or the DB. MySQL is brought up to date lazily by the
+// checkpointer / DB worker; rows the worker committed are marked saved here.
+// On startup the records not known to be in the DB are replayed (Pending())
+// and laid over freshly loaded characters (Overlay()). Once the file grows
+// past DARA_JOURNAL_COMPACT_BYTES it is rewritten with the unsaved states only.
+//
+// File: header, then records. Native little-endian. Records hold absolute
+// values (latest wins, highestWave keeps the max), so replay is idempotent.
+// A torn or corrupt tail (crash mid-write) is cut off at the last good record.
+// =======================================================
+
+inline constexpr char     PROGRESS_JOURNAL_MAGIC[8] = { 'D','A','R','A','J','N','L','\0' };
+inline constexpr uint32_t PROGRESS_JOURNAL_VERSION  = 1;
+
+struct ProgressJournalHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+};
+
+struct ProgressJournalRecord
+{
+    uint32_t crc;          // CRC-32 of the fields below
+    int32_t characterId;
+    int32_t level;
+    int32_t xp;
+    int32_t credits;
+    int32_t potions;
+    int32_t highestWave;
+    uint32_t reserved;
+};
+static_assert(sizeof(ProgressJournalRecord) == 32, "journal record layout changed");
+
+struct ProgressJournalStats
+{
+    uint64_t appended = 0;       // records accepted
+    uint64_t written = 0;        // records written (after group commit)
+    uint64_t syncs = 0;          // write + fsync rounds
+    uint64_t failedSyncs = 0;
+    uint64_t compactions = 0;
+    uint64_t replayed = 0;       // unsaved characters found on Open()
+    size_t unsaved = 0;          // characters not yet confirmed by the DB
+    size_t fileBytes = 0;
+    double lastSyncMs = 0.0;
+    double maxSyncMs = 0.0;
+};
+
+class ProgressJournal
+{
+public:
+    ProgressJournal() = default;
+    ~ProgressJournal();
+
+    ProgressJournal(const ProgressJournal&) = delete;
+    ProgressJournal& operator=(const ProgressJournal&) = delete;
+
+    // Reads (recovers) the journal and opens it for appending; false (and the
+    // journal stays disabled, Append() is a no-op) if the file cannot be used.
+    bool Open(const std::string& path, std::string* err = nullptr);
+    void Start();                // group commit thread
+    void Stop();                 // last group commit, close
+    bool IsOpen() const { return open_.load(std::memory_order_acquire); }
+
+    // cheap: buffers the record; durable after the next group commit
+    void Append(int characterId, int level, int xp, int credits, int potions, int highestWave);
+    void Append(const std::string& characterId, int level, int xp, int credits, int potions, int highestWave);
+
+    // rows the DB just committed (CharacterDbWorker::FlushSaves)
+    void MarkSaved(const std::vector<CharacterSave>& rows);
+
+    // latest state of every character the DB may not have yet (replay)
+    std::vector<CharacterSave> Pending();
+    // applies newer journal states to characters read from the DB
+    void Overlay(std::vector<Character>& chars);
+
+    ProgressJournalStats GetStats();
+
+private:
+    void Run();
+    void GroupCommit();
+    bool Compact(const std::unordered_map<int, CharacterSave>& unsaved);
+    static ProgressJournalRecord MakeRecord(const CharacterSave& s);
+
+    std::string path_;
+    int fd_ = -1;                // owned by the commit thread once started
+    std::atomic<bool> open_{false};
+    std::atomic<bool> running_{false};
+    std::thread th_;
+
+    // ---- guarded by mtx_ ----
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+    bool needCompact_ = false;   // last write failed: rewrite from unsaved_
+    std::vector<ProgressJournalRecord> buffer_;      // appended, not yet written
+    std::unordered_map<int, CharacterSave> unsaved_; // characterId -> latest journaled state
+    ProgressJournalStats stats_;
+};
+
+extern ProgressJournal g_progressJournal;
@@ -0,0 +1,117 @@
+#include "RequestPipeline.h"
+#include <unordered_set>
+#include "auth.h"
+
+namespace
+{
+    thread_local RequestContext t_request;
+
+    // filled before listen, read-only afterwards
+    std::unordered_set<std::string> g_sessionRoutes;
+
+    // token -> session for a RequireSession route; false: res is answered
+    bool Authenticate(RequestContext& ctx, httplib::Response& res)
+    {
+        if (ctx.token.empty()) {
+            SendError(res, 401, HttpError::MissingToken);
+            return false;
+        }
+
+        SessionPtr s = FindSession(ctx.token);
+        if (!s) {
+            SendError(res, 401, HttpError::InvalidSession);
+            return false;
+        }
+        if (s->expiresAt < std::chrono::system_clock::now()) {
+            ExpireSession(ctx.token, s);
+            SendError(res, 401, HttpError::SessionExpired);
+            return false;
+        }
+
+        ctx.session = std::move(s);
+        return true;
+    }
+}
+
+const RequestContext& CurrentRequest()
+{
+    return t_request;
+}
+
+void RequireSession(const std::string& path)
+{
+    g_sessionRoutes.insert(path);
+}
+
+void SendError(httplib::Response& res, int status, std::string_view body)
+{
+    res.status = status;
+    res.set_content(body.data(), body.size(), "application/json");
+}
+
+void InstallRequestPipeline(httplib::Server& server, CombatDirector* room)
+{
+    server.set_pre_routing_handler([room](const httplib::Request& req, httplib::Response& res)
+    {
+        RequestContext& ctx = t_request;
+        ctx.start = std::chrono::steady_clock::now();
+        ctx.token = GetBearerToken(req);
+        ctx.session.reset();
+        ctx.room = room;
+        ctx.routeClass = ERouteClass::Default;
+        ctx.slowSlot = false;
+
+        AddCorsHeadersAuth(res);
+        if (req.method == "OPTIONS") {
+            res.status = 204;   // preflight OK
+            return httplib::Server::HandlerResponse::Handled;
+        }
+
+        // the worker queue was full when this connection came in
+        if (HttpLoadControl::OnOverflowWorker()) {
+            res.set_header("Retry-After", std::to_string(DARA_HTTP_RETRY_AFTER_SEC));
+            SendError(res, 503, HttpError::Overloaded);
+            return httplib::Server::HandlerResponse::Handled;
+        }
+
+        ctx.routeClass = g_httpLoad.ClassOf(req.path);
+        if (g_sessionRoutes.count(req.path) && !Authenticate(ctx, res))
+            return httplib::Server::HandlerResponse::Handled;
+
+        if (ctx.routeClass == ERouteClass::Slow) {
+            ctx.slowSlot = g_httpLoad.AdmitSlow();
+            if (!ctx.slowSlot) {
+                // nothing ran yet: safe to retry, POSTs included
+                res.set_header("Retry-After", std::to_string(DARA_HTTP_RETRY_AFTER_SEC));
+                SendError(res, 503, HttpError::Overloaded);
+                return httplib::Server::HandlerResponse::Handled;
+            }
+        }
+
+        return httplib::Server::HandlerResponse::Unhandled;
+    });
+
+    server.set_post_routing_handler([](const httplib::Request& req, httplib::Response& res)
+    {
+        RequestContext& ctx = t_request;
+        if (ctx.slowSlot) {
+            g_httpLoad.ReleaseSlow();
+            ctx.slowSlot = false;
+        }
+
+        // connections wait for a worker: hand this one back after the response,
+        // whatever the route (an idle keep-alive holds the worker just the same)
+        if ((g_httpLoad.Saturated() || HttpLoadControl::OnOverflowWorker()) && !res.has_header("Connection"))
+            res.set_header("Connection", "close");
+
+        const double ms = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - ctx.start).count();
+        g_httpLoad.RecordRequest(ctx.routeClass, ms);
+        if (ms >= DARA_HTTP_SLOW_MS)
+            DaraLog("HTTP", "Slow request " + req.method + " " + req.path + " -> "
+                + std::to_string(res.status) + " in " + std::to_string(static_cast<long long>(ms)) + "ms");
+
+        // do not keep the session alive until this thread's next request
+        ctx.session.reset();
+    });
+}
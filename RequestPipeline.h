@@ -0,0 +1,59 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <chrono>
+#include "httplib.h"
+#include "DaraConfig.h"
+#include "sessions.h"
+#include "HttpWorkerPool.h"
+
+class CombatDirector;
+
+// =======================================================
+// Request pipeline: one pre-routing stage in front of every handler
+//  - CORS headers on every response, preflights (OPTIONS, any path) answered 204
+//  - routes registered with RequireSession(): the bearer token is resolved and
+//    checked for expiry once, failures answered right there with prebuilt
+//    error bodies; the handler finds the session in CurrentRequest()
+//  - load control (HttpLoadControl): requests on an overflow worker are
+//    answered 503 + Retry-After; once authenticated, a Slow route takes an
+//    admission slot or is shed right there with 503 + Retry-After; while
+//    connections wait for a worker, responses close their connection
+//  - request timing; the post-routing stage records it per route class and
+//    logs requests slower than DARA_HTTP_SLOW_MS
+// httplib runs pre-routing, handler and post-routing of a request on one
+// worker thread, so the context is thread_local and reset per request.
+// =======================================================
+struct RequestContext
+{
+    std::chrono::steady_clock::time_point start;
+    std::string token;                 // bearer token, empty if none was sent
+    SessionPtr session;                // set on RequireSession routes
+    CombatDirector* room = nullptr;    // the game requests are played in
+    ERouteClass routeClass = ERouteClass::Default;
+    bool slowSlot = false;             // holds a Slow admission slot until post-routing
+};
+
+// the current request's context; only valid inside a handler
+const RequestContext& CurrentRequest();
+
+// path (exact, as registered) needs a valid session; call before listen
+void RequireSession(const std::string& path);
+
+// room: the game handed to handlers via RequestContext::room
+void InstallRequestPipeline(httplib::Server& server, CombatDirector* room);
+
+// prebuilt JSON bodies, no json building per error
+namespace HttpError
+{
+    inline constexpr std::string_view MissingToken   = R"({"status":"error","message":"Missing Bearer token"})";
+    inline constexpr std::string_view InvalidSession = R"({"status":"error","message":"Invalid session"})";
+    inline constexpr std::string_view SessionExpired = R"({"status":"error","message":"Session expired"})";
+    inline constexpr std::string_view InvalidJson    = R"({"status":"error","message":"Invalid JSON body"})";
+    inline constexpr std::string_view PlayerNotFound = R"({"status":"error","message":"Player not found"})";
+    inline constexpr std::string_view NoCharacter    = R"({"status":"error","message":"Session has no playerName"})";
+    inline constexpr std::string_view Overloaded     = R"({"status":"error","message":"Server busy, retry shortly"})";
+    inline constexpr std::string_view PlayerLoading  = R"({"status":"loading","message":"Rejoining the game, retry shortly"})";
+}
+
+void SendError(httplib::Response& res, int status, std::string_view body);
@@ -32,6 +32,14 @@ ServerOptions ParseCommandLine(int argc, char* argv[])
         {
             opt.config = argv[++i];
         }
+        else if (arg == "--store" && i + 1 < argc)
+        {
+            opt.storeFile = argv[++i];
+        }
+        else if (arg == "--mob-reload" && i + 1 < argc)
+        {
+            opt.mobReloadSeconds = std::atoi(argv[++i]);
+        }
         else if (arg == "--dev")
         {
             opt.devMode = true;
@@ -40,6 +48,10 @@ ServerOptions ParseCommandLine(int argc, char* argv[])
         {
             opt.noPersistence = true;
         }
+        else if (arg == "--signed-sessions")
+        {
+            opt.signedSessions = true;
+        }
         else if (arg == "--no-mobjitter")
         {
             opt.noMobJitter = true;
@@ -61,10 +73,14 @@ ServerOptions ParseCommandLine(int argc, char* argv[])
                 "  --tickrate <n>        (not implemented) Game tickrate (default 20)\n"
                 "  --config <file>       (not implemented) Config file\n"
                 "  --dev                 (not implemented) Enable dev mode\n"
-                "  --no-persistence      (not implemented) Disable DB persistence\n"
+                "  --no-persistence      No MySQL: keep characters in the embedded store file\n"
+                "  --store <file>        Embedded store file (default characters.store)\n"
+                "  --signed-sessions     Stateless signed session tokens (any process with the same\n"
+                "                        DARA_SESSION_KEYS=id:hexkey[,id:hexkey] accepts them)\n"
                 "  --no-mobjitter        Mobs x pos will not be random each turn\n"
                 "  --showfullstate       Each turn and player the full state reply will be sent\n"
                 "  --showleaderboards    Each leaderboard request will show full json for leaderboard\n"
+                "  --mob-reload <sec>    Hot reload mob templates when the file changes (default 5, 0=off)\n"
                 "  --help                Show this help\n";
             std::exit(0);
         }
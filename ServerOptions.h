@@ -9,10 +9,13 @@ struct ServerOptions
     int tickRate        = 20;      // game ticks per second
     bool devMode        = false;
     bool noPersistence  = false;
+    bool signedSessions = false;   // stateless HMAC tokens, keys from DARA_SESSION_KEYS
     bool noMobJitter    = false;
     bool showFullState  = false;
     bool showLeaderBoards = false;
+    int mobReloadSeconds = 5;      // poll mobs/mobdb.json for hot reload, 0 = off
     std::string config  = "server.json";
+    std::string storeFile = "characters.store";   // embedded store used with --no-persistence
 };
 
 extern ServerOptions g_options;
\ No newline at end of file
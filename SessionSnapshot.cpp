@@ -0,0 +1,113 @@
+#include "SessionSnapshot.h"
+#include <fstream>
+#include <filesystem>
+#include <chrono>
+#include <cstring>
+#include <vector>
+#include "sessions.h"
+#include "BinaryIo.h"
+
+namespace
+{
+    int64_t ToEpochMs(std::chrono::system_clock::time_point t)
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(t.time_since_epoch()).count();
+    }
+}
+
+bool SaveSessionSnapshot(const std::string& path, size_t* saved, std::string* err)
+{
+    std::string body;
+    uint32_t count = 0;
+    g_sessionStore.ForEach([&](const std::string& token, const SessionPtr& s)
+    {
+        PutString(body, token);
+        PutString(body, s->characterId);
+        PutString(body, s->characterName);
+        PutString(body, s->sub);
+        PutString(body, s->userName);
+        PutString(body, s->name);
+        PutString(body, s->eMail);
+        PutString(body, s->playerName);
+        PutPod<int64_t>(body, ToEpochMs(s->expiresAt));
+        count++;
+    });
+
+    SessionSnapshotHeader h{};
+    std::memcpy(h.magic, SESSION_SNAPSHOT_MAGIC, sizeof(h.magic));
+    h.version = SESSION_SNAPSHOT_VERSION;
+    h.count = count;
+    h.crc = Crc32(body.data(), body.size());
+
+    std::string data;
+    data.reserve(sizeof(h) + body.size());
+    data.append(reinterpret_cast<const char*>(&h), sizeof(h));
+    data.append(body);
+
+    // 0600: the tokens are bearer credentials
+    if (!ReplaceFileDurably(path, data, err, 0600)) return false;
+
+    if (saved) *saved = count;
+    return true;
+}
+
+static bool Reject(const std::string& path, const std::string& why, std::string* err)
+{
+    // keep it for inspection; the next snapshot must not overwrite it
+    std::error_code ec;
+    std::filesystem::rename(path, path + ".bad", ec);
+    if (err) *err = path + " " + why + (ec ? "" : ", moved to " + path + ".bad");
+    return false;
+}
+
+bool LoadSessionSnapshot(const std::string& path, size_t* loaded, std::string* err)
+{
+    if (loaded) *loaded = 0;
+
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return true;   // first start
+    const std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+
+    SessionSnapshotHeader h{};
+    if (data.size() < sizeof(h)) return Reject(path, "is truncated", err);
+    std::memcpy(&h, data.data(), sizeof(h));
+    if (std::memcmp(h.magic, SESSION_SNAPSHOT_MAGIC, sizeof(h.magic)) != 0 || h.version != SESSION_SNAPSHOT_VERSION)
+        return Reject(path, "is not a session snapshot (version " + std::to_string(SESSION_SNAPSHOT_VERSION) + ")", err);
+
+    const char* body = data.data() + sizeof(h);
+    const size_t bodyLen = data.size() - sizeof(h);
+    if (Crc32(body, bodyLen) != h.crc) return Reject(path, "is corrupt (CRC mismatch)", err);
+
+    // decode everything first: a bad file restores nothing
+    std::vector<std::pair<std::string, Session>> entries;
+    entries.reserve(h.count);
+    BinaryReader r(body, bodyLen);
+    for (uint32_t i = 0; i < h.count && r.ok(); ++i)
+    {
+        std::string token = r.GetString();
+        Session s;
+        s.characterId   = r.GetString();
+        s.characterName = r.GetString();
+        s.sub           = r.GetString();
+        s.userName      = r.GetString();
+        s.name          = r.GetString();
+        s.eMail         = r.GetString();
+        s.playerName    = r.GetString();
+        s.expiresAt     = std::chrono::system_clock::time_point(std::chrono::milliseconds(r.Get<int64_t>()));
+        entries.emplace_back(std::move(token), std::move(s));
+    }
+    if (!r.ok() || !r.done()) return Reject(path, "is corrupt (bad entry)", err);
+
+    const auto now = std::chrono::system_clock::now();
+    size_t n = 0;
+    for (auto& [token, s] : entries)
+    {
+        if (token.empty() || s.expiresAt <= now) continue;
+        g_sessionStore.Put(token, std::move(s));
+        n++;
+    }
+
+    if (loaded) *loaded = n;
+    return true;
+}
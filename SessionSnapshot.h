@@ -0,0 +1,35 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include "DaraConfig.h"
+
+// =======================================================
+// Session snapshot (DARA_SESSION_SNAPSHOT_PATH)
+// The session table written to one binary file (periodically and on shutdown
+// by the SessionSweeper) and read back before listen, so a restart does not
+// send every player through Google sign-in again.
+//
+// File: header, then one entry per session: token, identity, selected
+// character (u32 length + bytes each) and expiresAt (i64 ms since epoch).
+// Native little-endian; the header's CRC-32 covers the entries. It holds
+// bearer tokens: created 0600, replaced via write + fsync + rename.
+// =======================================================
+
+inline constexpr char     SESSION_SNAPSHOT_MAGIC[8] = { 'D','A','R','A','S','E','S','\0' };
+inline constexpr uint32_t SESSION_SNAPSHOT_VERSION  = 1;
+
+struct SessionSnapshotHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t count;       // entries
+    uint32_t crc;         // CRC-32 of the entries
+    uint32_t reserved;
+};
+
+// writes every session of g_sessionStore; false (old file kept) on failure
+bool SaveSessionSnapshot(const std::string& path, size_t* saved = nullptr, std::string* err = nullptr);
+// puts the unexpired sessions of the file into g_sessionStore; a missing file
+// is not an error, a corrupt one is (it is moved aside to <path>.bad)
+bool LoadSessionSnapshot(const std::string& path, size_t* loaded = nullptr, std::string* err = nullptr);
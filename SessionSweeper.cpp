@@ -0,0 +1,102 @@
+#include "SessionSweeper.h"
+#include <string>
+#include <vector>
+#include "sessions.h"
+#include "SessionSnapshot.h"
+
+SessionSweeper::~SessionSweeper()
+{
+    Stop();
+}
+
+void SessionSweeper::Start()
+{
+    bool expected = false;
+    if (!running_.compare_exchange_strong(expected, true))
+        return; // already running
+
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stop_ = false;
+    }
+    th_ = std::thread([this]{ Run(); });
+}
+
+void SessionSweeper::Stop()
+{
+    if (!running_.exchange(false)) return;
+
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stop_ = true;
+    }
+    cv_.notify_one();
+    if (th_.joinable()) th_.join();
+
+    // shutdown: the next start picks the sessions up again
+    SnapshotIfChanged();
+}
+
+size_t SessionSweeper::SweepOnce()
+{
+    std::vector<std::pair<std::string, SessionPtr>> expired;
+    g_sessionStore.SweepExpired(std::chrono::system_clock::now(),
+                                static_cast<size_t>(DARA_SESSION_SWEEP_BATCH), expired);
+    if (expired.empty()) return 0;
+
+    // outside the store's locks: the hook takes the game's
+    for (const auto& [token, s] : expired)
+        RunSessionExpiredHook(token, s);
+
+    const SessionStoreStats st = g_sessionStore.GetStats();
+    DaraLog("SESSION", "Expired " + std::to_string(expired.size()) + " sessions ("
+        + std::to_string(st.live) + " live, " + std::to_string(st.expired) + " expired since start)");
+    return expired.size();
+}
+
+void SessionSweeper::SnapshotIfChanged()
+{
+    if (snapshotPath_.empty()) return;
+
+    const uint64_t version = g_sessionStore.Version();
+    if (version == snapshotVersion_) return;
+
+    size_t saved = 0;
+    std::string err;
+    if (!SaveSessionSnapshot(snapshotPath_, &saved, &err)) {
+        DaraLog("SESSION", "Snapshot failed: " + err);
+        return;
+    }
+    // a change racing the write gets the next snapshot (version read before)
+    snapshotVersion_ = version;
+    DaraLog("SESSION", "Snapshot of " + std::to_string(saved) + " sessions written to " + snapshotPath_);
+}
+
+void SessionSweeper::Run()
+{
+    auto lastSnapshot = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(mtx_);
+    while (!stop_)
+    {
+        cv_.wait_for(lock, std::chrono::milliseconds(DARA_SESSION_SWEEP_INTERVAL_MS),
+                     [this]{ return stop_; });
+        if (stop_) break;
+
+        lock.unlock();
+        try
+        {
+            SweepOnce();
+
+            const auto now = std::chrono::steady_clock::now();
+            if (now - lastSnapshot >= std::chrono::milliseconds(DARA_SESSION_SNAPSHOT_INTERVAL_MS)) {
+                SnapshotIfChanged();
+                lastSnapshot = now;
+            }
+        }
+        catch (const std::exception& e)
+        {
+            DaraLog("SESSION", std::string("Session sweep failed: ") + e.what());
+        }
+        lock.lock();
+    }
+}
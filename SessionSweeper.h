@@ -0,0 +1,48 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <string>
+#include <cstdint>
+#include "DaraConfig.h"
+
+// Removes expired sessions from g_sessionStore every
+// DARA_SESSION_SWEEP_INTERVAL_MS, a bounded batch per shard and round, and runs
+// the session-expired hook for each (the game drops the player). Without it an
+// abandoned token stays until somebody presents it again.
+// With a snapshot path it also writes the session snapshot every
+// DARA_SESSION_SNAPSHOT_INTERVAL_MS if the store changed, and once more on Stop().
+class SessionSweeper
+{
+public:
+    SessionSweeper() = default;
+    ~SessionSweeper();
+
+    SessionSweeper(const SessionSweeper&) = delete;
+    SessionSweeper& operator=(const SessionSweeper&) = delete;
+
+    // empty: no snapshots. Set before Start()
+    void SetSnapshotPath(const std::string& path) { snapshotPath_ = path; }
+    void Start();
+    void Stop();
+
+    // one round; returns the number of sessions removed
+    size_t SweepOnce();
+    // writes the snapshot if the store changed since the last one
+    void SnapshotIfChanged();
+
+private:
+    void Run();
+
+    std::string snapshotPath_;
+    uint64_t snapshotVersion_ = UINT64_MAX;   // store version last written (sweeper thread / Stop)
+
+    std::thread th_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+    std::atomic<bool> running_{false};
+};
+
+extern SessionSweeper g_sessionSweeper;
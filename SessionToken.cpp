@@ -0,0 +1,258 @@
+#include "SessionToken.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <vector>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include "BinaryIo.h"
+
+SessionTokenSigner g_tokenSigner;
+
+namespace
+{
+    constexpr char     kPrefix[]   = "s1.";
+    constexpr size_t   kPrefixLen  = sizeof(kPrefix) - 1;
+    constexpr uint8_t  kVersion    = 1;
+    constexpr size_t   kMacLen     = 32;    // HMAC-SHA256
+    constexpr size_t   kMinKeyLen  = 32;
+
+    // ---- base64url without padding ----
+    const char kB64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+    std::string Base64UrlEncode(const std::string& in)
+    {
+        std::string out;
+        out.reserve((in.size() * 4 + 2) / 3);
+        size_t i = 0;
+        for (; i + 2 < in.size(); i += 3)
+        {
+            const uint32_t v = (uint8_t)in[i] << 16 | (uint8_t)in[i + 1] << 8 | (uint8_t)in[i + 2];
+            out += kB64[v >> 18 & 63]; out += kB64[v >> 12 & 63]; out += kB64[v >> 6 & 63]; out += kB64[v & 63];
+        }
+        if (i + 1 == in.size()) {
+            const uint32_t v = (uint8_t)in[i] << 16;
+            out += kB64[v >> 18 & 63]; out += kB64[v >> 12 & 63];
+        } else if (i + 2 == in.size()) {
+            const uint32_t v = (uint8_t)in[i] << 16 | (uint8_t)in[i + 1] << 8;
+            out += kB64[v >> 18 & 63]; out += kB64[v >> 12 & 63]; out += kB64[v >> 6 & 63];
+        }
+        return out;
+    }
+
+    bool Base64UrlDecode(const char* p, size_t n, std::string& out)
+    {
+        static const auto table = []{
+            std::array<int8_t, 256> t{};
+            t.fill(-1);
+            for (int i = 0; i < 64; ++i) t[(uint8_t)kB64[i]] = (int8_t)i;
+            return t;
+        }();
+
+        if (n % 4 == 1) return false;
+        out.clear();
+        out.reserve(n * 3 / 4);
+        uint32_t acc = 0;
+        int bits = 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            const int8_t v = table[(uint8_t)p[i]];
+            if (v < 0) return false;
+            acc = acc << 6 | (uint32_t)v;
+            bits += 6;
+            if (bits >= 8) {
+                bits -= 8;
+                out += (char)(acc >> bits & 0xFF);
+            }
+        }
+        // canonical only: the unused low bits of the last char must be zero
+        return (acc & ((1u << bits) - 1)) == 0;
+    }
+
+    int HexValue(char c)
+    {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    std::string Mac(const std::string& key, const std::string& payload)
+    {
+        unsigned char mac[EVP_MAX_MD_SIZE];
+        unsigned int len = 0;
+        HMAC(EVP_sha256(), key.data(), (int)key.size(),
+             reinterpret_cast<const unsigned char*>(payload.data()), payload.size(), mac, &len);
+        return std::string(reinterpret_cast<const char*>(mac), len);
+    }
+
+    // tokens stay short: 16-bit string lengths
+    using StrLen = uint16_t;
+}
+
+bool SessionTokenSigner::Configure(const std::string& spec, std::string* err)
+{
+    keys_.clear();
+    signKeyId_ = -1;
+
+    size_t pos = 0;
+    while (pos <= spec.size())
+    {
+        const size_t end = std::min(spec.find(',', pos), spec.size());
+        const std::string item = spec.substr(pos, end - pos);
+        pos = end + 1;
+        if (item.empty()) continue;
+
+        const size_t colon = item.find(':');
+        const std::string idText = colon == std::string::npos ? "" : item.substr(0, colon);
+        const std::string hex = colon == std::string::npos ? "" : item.substr(colon + 1);
+        int id = -1;
+        try { id = idText.empty() ? -1 : std::stoi(idText); } catch (...) {}
+        if (id < 0 || id > 255 || hex.size() % 2 != 0) {
+            if (err) *err = "Bad session key entry (expected id:hexkey): " + idText;
+            return false;
+        }
+
+        std::string key;
+        for (size_t i = 0; i < hex.size(); i += 2)
+        {
+            const int hi = HexValue(hex[i]), lo = HexValue(hex[i + 1]);
+            if (hi < 0 || lo < 0) {
+                if (err) *err = "Session key " + idText + " is not hex";
+                return false;
+            }
+            key += static_cast<char>(hi << 4 | lo);
+        }
+        if (key.size() < kMinKeyLen) {
+            if (err) *err = "Session key " + idText + " is shorter than " + std::to_string(kMinKeyLen) + " bytes";
+            return false;
+        }
+        if (!keys_.emplace(static_cast<uint8_t>(id), std::move(key)).second) {
+            if (err) *err = "Session key id " + idText + " appears twice";
+            return false;
+        }
+        if (signKeyId_ < 0) signKeyId_ = id;
+    }
+
+    if (signKeyId_ < 0) {
+        if (err) *err = "No session keys given";
+        return false;
+    }
+    return true;
+}
+
+bool SessionTokenSigner::IsSignedToken(const std::string& token)
+{
+    return token.compare(0, kPrefixLen, kPrefix) == 0;
+}
+
+std::string SessionTokenSigner::Issue(const Session& s, SessionTokenLogin login)
+{
+    static thread_local std::mt19937_64 rng{ std::random_device{}() };
+    if (login.nonce == 0) {
+        while (login.nonce == 0) login.nonce = rng();
+        login.issuedAtMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    std::string payload;
+    payload.reserve(64 + s.sub.size() + s.userName.size() + s.eMail.size() + s.name.size()
+                    + s.characterId.size() + s.characterName.size() + s.playerName.size());
+    PutPod<uint8_t>(payload, kVersion);
+    PutPod<uint8_t>(payload, static_cast<uint8_t>(signKeyId_));
+    PutPod<uint64_t>(payload, login.nonce);
+    PutPod<int64_t>(payload, login.issuedAtMs);
+    PutPod<int64_t>(payload, std::chrono::duration_cast<std::chrono::seconds>(s.expiresAt.time_since_epoch()).count());
+    PutString<StrLen>(payload, s.sub);
+    PutString<StrLen>(payload, s.userName);
+    PutString<StrLen>(payload, s.eMail);
+    PutString<StrLen>(payload, s.name);
+    PutString<StrLen>(payload, s.characterId);
+    PutString<StrLen>(payload, s.characterName);
+    PutString<StrLen>(payload, s.playerName);
+
+    return kPrefix + Base64UrlEncode(payload + Mac(keys_.at(static_cast<uint8_t>(signKeyId_)), payload));
+}
+
+SessionPtr SessionTokenSigner::Verify(const std::string& token, SessionTokenLogin* login)
+{
+    SessionTokenLogin l;
+    SessionPtr s = Decode(token, l);
+    if (!s || IsRevoked(s->sub, l.issuedAtMs)) return nullptr;
+    if (login) *login = l;
+    return s;
+}
+
+SessionPtr SessionTokenSigner::Decode(const std::string& token, SessionTokenLogin& login)
+{
+    if (!Enabled() || !IsSignedToken(token)) return nullptr;
+
+    std::string raw;
+    if (!Base64UrlDecode(token.data() + kPrefixLen, token.size() - kPrefixLen, raw) || raw.size() < 2 + kMacLen)
+        return nullptr;
+
+    const size_t payloadLen = raw.size() - kMacLen;
+    if (static_cast<uint8_t>(raw[0]) != kVersion) return nullptr;
+    auto key = keys_.find(static_cast<uint8_t>(raw[1]));
+    if (key == keys_.end()) return nullptr;
+
+    unsigned char mac[EVP_MAX_MD_SIZE];
+    unsigned int macLen = 0;
+    HMAC(EVP_sha256(), key->second.data(), (int)key->second.size(),
+         reinterpret_cast<const unsigned char*>(raw.data()), payloadLen, mac, &macLen);
+    if (macLen != kMacLen || CRYPTO_memcmp(mac, raw.data() + payloadLen, kMacLen) != 0)
+        return nullptr;
+
+    BinaryReader r(raw.data(), payloadLen);
+    r.Get<uint8_t>();
+    r.Get<uint8_t>();
+    login.nonce      = r.Get<uint64_t>();
+    login.issuedAtMs = r.Get<int64_t>();
+    auto s = std::make_shared<Session>();
+    s->expiresAt     = std::chrono::system_clock::time_point(std::chrono::seconds(r.Get<int64_t>()));
+    s->sub           = r.GetString<StrLen>();
+    s->userName      = r.GetString<StrLen>();
+    s->eMail         = r.GetString<StrLen>();
+    s->name          = r.GetString<StrLen>();
+    s->characterId   = r.GetString<StrLen>();
+    s->characterName = r.GetString<StrLen>();
+    s->playerName    = r.GetString<StrLen>();
+    if (!r.ok() || !r.done()) return nullptr;   // signed by us, so a bug or a key leak
+    return s;
+}
+
+bool SessionTokenSigner::IsRevoked(const std::string& sub, int64_t issuedAtMs)
+{
+    if (revokedCount_.load(std::memory_order_acquire) == 0) return false;
+    std::lock_guard<std::mutex> lk(revokedMtx_);
+    auto it = revoked_.find(sub);
+    return it != revoked_.end() && issuedAtMs <= it->second.issuedBeforeMs;
+}
+
+void SessionTokenSigner::Revoke(const std::string& token)
+{
+    // only authentic tokens get in, so the set cannot be flooded with junk
+    SessionTokenLogin login;
+    SessionPtr s = Decode(token, login);
+    if (!s) return;
+
+    const std::time_t now = std::time(nullptr);
+    const std::time_t exp = std::chrono::system_clock::to_time_t(s->expiresAt);
+
+    std::lock_guard<std::mutex> lk(revokedMtx_);
+    Revocation& r = revoked_[s->sub];
+    r.issuedBeforeMs = std::max(r.issuedBeforeMs, login.issuedAtMs);
+    r.until = std::max(r.until, exp);
+
+    // one entry per user that logged out; expired ones go in amortized sweeps
+    if (revoked_.size() >= purgeAt_)
+    {
+        for (auto it = revoked_.begin(); it != revoked_.end(); )
+            it = it->second.until <= now ? revoked_.erase(it) : std::next(it);
+        purgeAt_ = std::max<size_t>(1024, revoked_.size() * 2);
+    }
+    revokedCount_.store(revoked_.size(), std::memory_order_release);
+}
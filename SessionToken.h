@@ -0,0 +1,82 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include "DaraConfig.h"
+#include "sessions.h"
+
+// what every token of one login shares
+struct SessionTokenLogin
+{
+    uint64_t nonce = 0;        // 0: a new login, Issue draws both
+    int64_t issuedAtMs = 0;
+};
+
+// =======================================================
+// Signed session tokens (--signed-sessions)
+// Stateless alternative to the random tokens of the session store: the session
+// (identity, selected character, expiry) travels in the token as a compact
+// binary payload plus HMAC-SHA256, so every server process holding the same
+// keys (DARA_SESSION_KEYS env) accepts it without a shared session store.
+//
+// Token: "s1." + base64url(payload | mac). Payload: version u8, key id u8,
+// nonce u64, issuedAt i64 (unix ms), expiresAt i64 (unix sec), then sub, userName, eMail, name,
+// characterId, characterName, playerName (u16 length + bytes each).
+// Keys rotate by id: the first configured key signs, all of them verify.
+// The MAC is compared in constant time.
+//
+// Such a session cannot be changed in place: selecting a character issues a
+// new token with the same nonce, issue time and expiry, so every token of one
+// login shares them. Logout revokes by user: tokens of that sub issued at or
+// before the login are rejected in this process until they expire (other
+// processes accept them until then). That ends the user's older logins on
+// other devices too, never anyone else's, and keeps one entry per user, so
+// logging in and out in a loop cannot grow the set.
+// =======================================================
+class SessionTokenSigner
+{
+public:
+    SessionTokenSigner() = default;
+
+    SessionTokenSigner(const SessionTokenSigner&) = delete;
+    SessionTokenSigner& operator=(const SessionTokenSigner&) = delete;
+
+    // "id:hexkey[,id:hexkey...]", ids 0-255, keys at least 32 bytes; call once
+    // at startup, before requests are served
+    bool Configure(const std::string& spec, std::string* err = nullptr);
+    bool Enabled() const { return signKeyId_ >= 0; }
+
+    static bool IsSignedToken(const std::string& token);
+
+    // reissues pass the login Verify returned, so revoking any token of the
+    // login revokes all of them
+    std::string Issue(const Session& s, SessionTokenLogin login = {});
+    // nullptr if malformed, unknown key, bad MAC or revoked. Expiry is the
+    // caller's check, as for sessions from the store
+    SessionPtr Verify(const std::string& token, SessionTokenLogin* login = nullptr);
+    void Revoke(const std::string& token);
+
+private:
+    struct Revocation
+    {
+        int64_t issuedBeforeMs = 0;   // tokens issued at or before: revoked
+        std::time_t until = 0;        // their latest expiry; dropped afterwards
+    };
+
+    // MAC checked, revocation not
+    SessionPtr Decode(const std::string& token, SessionTokenLogin& login);
+    bool IsRevoked(const std::string& sub, int64_t issuedAtMs);
+
+    std::unordered_map<uint8_t, std::string> keys_;   // id -> secret, read-only once configured
+    int signKeyId_ = -1;
+
+    std::mutex revokedMtx_;
+    std::unordered_map<std::string, Revocation> revoked_;   // by sub
+    std::atomic<size_t> revokedCount_{0};                   // lock-free "nothing revoked" check
+    size_t purgeAt_ = 1024;                                 // next sweep of expired entries
+};
+
+extern SessionTokenSigner g_tokenSigner;
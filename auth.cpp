@@ -1,22 +1,22 @@
 #include "auth.h"
 
-#include <cpr/cpr.h>
 #include "json.hpp"
 
 // jwt-cpp (you must add this dependency)
 #include <jwt-cpp/jwt.h>
 
-#include <unordered_map>
-#include <mutex>
 #include <chrono>
 #include <random>
 #include <sstream>
-#include <regex>
 #include <cstdlib>
-#include <openssl/rsa.h>
-#include <openssl/pem.h>
-#include <openssl/bn.h>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <openssl/sha.h>
 #include "sessions.h"
+#include "GoogleKeyCache.h"
+#include "SessionToken.h"
+#include "RequestPipeline.h"
 using json = nlohmann::json;
 
 static PostLoginHook g_postLoginHook;
@@ -26,63 +26,6 @@ void SetPostLoginHook(PostLoginHook hook)
     g_postLoginHook = std::move(hook);
 }
 
-// --- base64url decode helper ---
-static std::string Base64UrlToBase64(std::string s) {
-    for (auto& c : s) { if (c == '-') c = '+'; else if (c == '_') c = '/'; }
-    while (s.size() % 4) s.push_back('=');
-    return s;
-}
-
-static std::vector<unsigned char> Base64Decode(const std::string& b64) {
-    BIO* bmem = BIO_new_mem_buf(b64.data(), (int)b64.size());
-    BIO* b64bio = BIO_new(BIO_f_base64());
-    BIO_set_flags(b64bio, BIO_FLAGS_BASE64_NO_NL);
-    bmem = BIO_push(b64bio, bmem);
-
-    std::vector<unsigned char> out(b64.size());
-    int len = BIO_read(bmem, out.data(), (int)out.size());
-    BIO_free_all(bmem);
-
-    if (len <= 0) return {};
-    out.resize(len);
-    return out;
-}
-
-static std::string JwkNeToPem(const std::string& n_b64url, const std::string& e_b64url) {
-    auto n_bin = Base64Decode(Base64UrlToBase64(n_b64url));
-    auto e_bin = Base64Decode(Base64UrlToBase64(e_b64url));
-    if (n_bin.empty() || e_bin.empty()) return {};
-
-    BIGNUM* n = BN_bin2bn(n_bin.data(), (int)n_bin.size(), nullptr);
-    BIGNUM* e = BN_bin2bn(e_bin.data(), (int)e_bin.size(), nullptr);
-    if (!n || !e) { if(n) BN_free(n); if(e) BN_free(e); return {}; }
-
-    RSA* rsa = RSA_new();
-    if (!rsa) { BN_free(n); BN_free(e); return {}; }
-
-    // RSA_set0_key takes ownership of n,e
-    if (RSA_set0_key(rsa, n, e, nullptr) != 1) {
-        RSA_free(rsa); // frees n,e too if set0 succeeded; here it didn't, so:
-        BN_free(n); BN_free(e);
-        return {};
-    }
-
-    BIO* mem = BIO_new(BIO_s_mem());
-    // write as SubjectPublicKeyInfo (-----BEGIN PUBLIC KEY-----)
-    if (PEM_write_bio_RSA_PUBKEY(mem, rsa) != 1) {
-        BIO_free(mem);
-        RSA_free(rsa);
-        return {};
-    }
-
-    char* data = nullptr;
-    long len = BIO_get_mem_data(mem, &data);
-    std::string pem(data, (size_t)len);
-
-    BIO_free(mem);
-    RSA_free(rsa);
-    return pem;
-}
 // =======================================================
 // Config (env)
 // =======================================================
@@ -96,29 +39,15 @@ static std::string GetEnvOrThrow(const char* name)
     return std::string(v);
 }
 
-static std::string GetEnvOrDefault(const char* name, const std::string& def)
-{
-    const char* v = std::getenv(name);
-    if (!v || !*v) return def;
-    return std::string(v);
-}
-
 // Required:
 //   GOOGLE_CLIENT_ID=xxxxx.apps.googleusercontent.com
 // Optional:
-//   GOOGLE_JWKS_URL=https://www.googleapis.com/oauth2/v3/certs
+//   GOOGLE_JWKS_URL (see GoogleKeyCache)
 static std::string GoogleClientId()
 {
     return GetEnvOrThrow("GOOGLE_CLIENT_ID");
 }
 
-static std::string GoogleJwksUrl()
-{
-    return GetEnvOrDefault("GOOGLE_JWKS_URL", "https://www.googleapis.com/oauth2/v3/certs");
-}
-
-
-
 // Adjust as you like
 static constexpr int kSessionDays = 7;
 
@@ -157,195 +86,111 @@ std::string GetBearerToken(const httplib::Request& req)
 // =======================================================
 
 
-bool GetSessionFromRequest(
-    const httplib::Request& req,
-    Session& outSession,
-    std::string* outErr)
-{
-    const std::string token = GetBearerToken(req);
-    if (token.empty()) {
-        if (outErr) *outErr = "Missing Bearer token";
-        return false;
-    }
-
-    std::lock_guard<std::mutex> lk(g_sessionsMutex);
-    auto it = g_sessions.find(token);
-    if (it == g_sessions.end()) {
-        if (outErr) *outErr = "Invalid session";
-        return false;
-    }
-
-    if (it->second.expiresAt < std::chrono::system_clock::now()) {
-        g_sessions.erase(it);
-        if (outErr) *outErr = "Session expired";
-        return false;
-    }
-
-    outSession = it->second;
-    return true;
-}
-
-
-
 bool ValidateSessionToken(const std::string& token, std::string& outUserName)
 {
     if (token.empty()) return false;
 
-    std::lock_guard<std::mutex> lk(g_sessionsMutex);
-    auto it = g_sessions.find(token);
-    if (it == g_sessions.end()) return false;
+    SessionPtr s = FindSession(token);
+    if (!s) return false;
 
     const auto now = std::chrono::system_clock::now();
-    if (it->second.expiresAt < now)
+    if (s->expiresAt < now)
     {
-        g_sessions.erase(it);
+        ExpireSession(token, s);
         return false;
     }
 
-    outUserName = it->second.userName;
+    outUserName = s->userName;
     return true;
 }
 
 // =======================================================
-// Google cert (JWKS) cache
+// Google ID token verification
 // =======================================================
 
-// We store "kid" -> PEM certificate (x5c converted to PEM).
-static std::unordered_map<std::string, std::string> g_googleKidToPem;
-static std::mutex g_googleCertMutex;
-static std::chrono::system_clock::time_point g_googleCertNextRefresh =
-    std::chrono::system_clock::time_point::min();
-
-static int ParseMaxAgeSeconds(const cpr::Response& r)
+struct GoogleClaims
 {
-    // Parse Cache-Control: public, max-age=XXXX, must-revalidate, ...
-    auto it = r.header.find("cache-control");
-    if (it == r.header.end()) return 300; // default fallback: 5 minutes
+    std::string sub;
+    std::string eMail;
+    bool email_verified = false;
+    std::string name;
+    std::string picture;
+    std::string issuer;
+};
 
-    std::smatch m;
-    std::regex re(R"(max-age\s*=\s*(\d+))", std::regex::icase);
-    if (std::regex_search(it->second, m, re) && m.size() >= 2)
+// =======================================================
+// Verified ID token cache
+// SHA-256(idToken) -> claims of a token that passed verification, kept until
+// the token's exp, LRU-evicted beyond DARA_ID_TOKEN_CACHE_MAX. The same token
+// bytes verify the same way, so a reconnect/retry storm with one token costs
+// a hash lookup instead of decode + RS256.
+// =======================================================
+class VerifiedTokenCache
+{
+public:
+    static std::string Key(const std::string& idToken)
     {
-        try { return std::stoi(m[1].str()); }
-        catch (...) { return 300; }
+        unsigned char digest[SHA256_DIGEST_LENGTH];
+        SHA256(reinterpret_cast<const unsigned char*>(idToken.data()), idToken.size(), digest);
+        return std::string(reinterpret_cast<const char*>(digest), sizeof(digest));
     }
-    return 300;
-}
 
-static std::string X5cToPemCert(const std::string& x5cBase64)
-{
-    // Convert x5c base64 to PEM cert format
-    // (wrap lines at 64 chars for readability)
-    std::ostringstream oss;
-    oss << "-----BEGIN CERTIFICATE-----\n";
-    for (size_t i = 0; i < x5cBase64.size(); i += 64)
-        oss << x5cBase64.substr(i, 64) << "\n";
-    oss << "-----END CERTIFICATE-----\n";
-    return oss.str();
-}
-
-static bool RefreshGoogleCerts(std::string* outErr)
-{
-    try
+    bool Find(const std::string& key, GoogleClaims& out)
     {
-        const std::string url = GoogleJwksUrl();
-
-        cpr::Response r = cpr::Get(
-            cpr::Url{url},
-            cpr::Timeout{8000}
-        );
-
-        if (r.status_code != 200)
-        {
-            if (outErr) *outErr = "Failed to fetch Google certs (HTTP " + std::to_string(r.status_code) + ")";
-            return false;
-        }
-
-        json j = json::parse(r.text);
-
-        if (!j.contains("keys") || !j["keys"].is_array())
-        {
-            if (outErr) *outErr = "Google certs response missing 'keys'";
-            return false;
-        }
-
-        std::unordered_map<std::string, std::string> nextMap;
-
-        for (const auto& key : j["keys"])
-        {
-            if (!key.contains("kid") || !key["kid"].is_string()) continue;
-            const std::string kid = key["kid"].get<std::string>();
-
-            // 1) Prefer x5c if present
-            if (key.contains("x5c") && key["x5c"].is_array() && !key["x5c"].empty() && key["x5c"][0].is_string())
-            {
-                nextMap[kid] = X5cToPemCert(key["x5c"][0].get<std::string>());
-                continue;
-            }
-
-            // 2) Fallback: n/e
-            if (key.contains("n") && key.contains("e") && key["n"].is_string() && key["e"].is_string())
-            {
-                std::string pem = JwkNeToPem(key["n"].get<std::string>(), key["e"].get<std::string>());
-                if (!pem.empty())
-                    nextMap[kid] = pem;
-                continue;
-            }
-        }
-
-        if (nextMap.empty())
-        {
-            if (outErr) *outErr = "Google certs parsed but no usable keys found";
+        std::lock_guard<std::mutex> lk(mtx_);
+        auto it = byKey_.find(key);
+        if (it == byKey_.end()) return false;
+        if (it->second->exp <= std::chrono::system_clock::now()) {
+            lru_.erase(it->second);
+            byKey_.erase(it);
             return false;
         }
-
-        const int maxAge = ParseMaxAgeSeconds(r);
-        const auto nextRefresh = std::chrono::system_clock::now() + std::chrono::seconds(maxAge);
-
-        {
-            std::lock_guard<std::mutex> lk(g_googleCertMutex);
-            g_googleKidToPem = std::move(nextMap);
-            g_googleCertNextRefresh = nextRefresh;
-        }
-
+        lru_.splice(lru_.begin(), lru_, it->second);
+        out = it->second->claims;
         return true;
     }
-    catch (const std::exception& e)
+
+    void Put(const std::string& key, const GoogleClaims& claims, std::chrono::system_clock::time_point exp)
     {
-        if (outErr) *outErr = std::string("RefreshGoogleCerts exception: ") + e.what();
-        return false;
+        std::lock_guard<std::mutex> lk(mtx_);
+        auto it = byKey_.find(key);
+        if (it != byKey_.end()) {
+            lru_.erase(it->second);
+            byKey_.erase(it);
+        }
+        lru_.push_front(Entry{ key, claims, exp });
+        byKey_[key] = lru_.begin();
+        while (lru_.size() > DARA_ID_TOKEN_CACHE_MAX) {
+            byKey_.erase(lru_.back().key);
+            lru_.pop_back();
+        }
     }
-}
 
-static bool EnsureGoogleCertsFresh(std::string* outErr)
-{
-    // Fast path check
+private:
+    struct Entry
     {
-        std::lock_guard<std::mutex> lk(g_googleCertMutex);
-        if (!g_googleKidToPem.empty() && std::chrono::system_clock::now() < g_googleCertNextRefresh)
-            return true;
-    }
+        std::string key;
+        GoogleClaims claims;
+        std::chrono::system_clock::time_point exp;
+    };
+
+    std::mutex mtx_;
+    std::list<Entry> lru_;   // most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> byKey_;
+};
 
-    // Refresh
-    return RefreshGoogleCerts(outErr);
-}
+static VerifiedTokenCache g_verifiedTokens;
 
-// =======================================================
-// Google ID token verification
-// =======================================================
-
-struct GoogleClaims
+// outRetry: failed only because the signing key is not loaded (yet); the
+// client should retry shortly instead of treating the token as invalid
+static bool VerifyGoogleIdToken(const std::string& idToken, GoogleClaims& out, std::string* outErr,
+                                bool* outRetry = nullptr)
 {
-    std::string sub;
-    std::string eMail;
-    bool email_verified = false;
-    std::string name;
-    std::string picture;
-    std::string issuer;
-};
+    // seen and verified before, not expired yet
+    const std::string cacheKey = VerifiedTokenCache::Key(idToken);
+    if (g_verifiedTokens.Find(cacheKey, out))
+        return true;
 
-static bool VerifyGoogleIdToken(const std::string& idToken, GoogleClaims& out, std::string* outErr)
-{
     try
     {
         // Decode without verification first (to read header kid)
@@ -359,32 +204,15 @@ static bool VerifyGoogleIdToken(const std::string& idToken, GoogleClaims& out, s
             return false;
         }
 
-        // Ensure we have certs cached
-        if (!EnsureGoogleCertsFresh(outErr))
-            return false;
-
-        std::string pemCert;
-        {
-            std::lock_guard<std::mutex> lk(g_googleCertMutex);
-            auto it = g_googleKidToPem.find(kid);
-            if (it != g_googleKidToPem.end())
-                pemCert = it->second;
-        }
-
-        // If kid missing, refresh once and try again (rotation)
-        if (pemCert.empty())
+        // parsed key from the cache; a miss (rotation, not loaded yet) is
+        // refreshed in the background, never on this request
+        const GoogleKeyCache::KeyPtr key = g_googleKeys.Find(kid);
+        if (!key)
         {
-            std::string refreshErr;
-            RefreshGoogleCerts(&refreshErr);
-
-            std::lock_guard<std::mutex> lk(g_googleCertMutex);
-            auto it = g_googleKidToPem.find(kid);
-            if (it == g_googleKidToPem.end())
-            {
-                if (outErr) *outErr = "Unknown 'kid' even after refresh";
-                return false;
-            }
-            pemCert = it->second;
+            if (outErr) *outErr = g_googleKeys.HasKeys() ? "Unknown 'kid', Google keys are being refreshed"
+                                                          : "Google keys not loaded yet";
+            if (outRetry) *outRetry = true;
+            return false;
         }
 
         // Verify signature + issuer + audience
@@ -394,7 +222,7 @@ static bool VerifyGoogleIdToken(const std::string& idToken, GoogleClaims& out, s
         // jwt-cpp verifier supports only one issuer check, so we do manual check after verify,
         // but we still check aud here.
         auto verifier = jwt::verify()
-            .allow_algorithm(jwt::algorithm::rs256(pemCert,"", "", "")) // verify using cert/public key
+            .allow_algorithm(*key) // copies the parsed key handle, no PEM parse
             .with_audience(aud);
 
         verifier.verify(decoded);
@@ -441,6 +269,9 @@ static bool VerifyGoogleIdToken(const std::string& idToken, GoogleClaims& out, s
             return false;
         }
 
+        // only tokens that expire (the verifier checked exp); Google's always do
+        if (decoded.has_payload_claim("exp"))
+            g_verifiedTokens.Put(cacheKey, out, decoded.get_expires_at());
         return true;
     }
     catch (const std::exception& e)
@@ -456,24 +287,11 @@ static bool VerifyGoogleIdToken(const std::string& idToken, GoogleClaims& out, s
 
 void RegisterAuthRoutes(httplib::Server& server)
 {
-    // Preflight
-    server.Options("/auth/google", [](const httplib::Request&, httplib::Response& res){
-        AddCorsHeadersAuth(res);
-        res.status = 204;
-    });
-    server.Options("/logout", [](const httplib::Request&, httplib::Response& res){
-        AddCorsHeadersAuth(res);
-        res.status = 204;
-    });
-    server.Options("/me", [](const httplib::Request&, httplib::Response& res){
-        AddCorsHeadersAuth(res);
-        res.status = 204;
-    });
+    // preflight + CORS: RequestPipeline
+    RequireSession("/me");
 
     // Google login
     server.Post("/auth/google", [](const httplib::Request& req, httplib::Response& res){
-        AddCorsHeadersAuth(res);
-
         try
         {
             auto body = json::parse(req.body);
@@ -481,15 +299,16 @@ void RegisterAuthRoutes(httplib::Server& server)
 
             GoogleClaims claims;
             std::string err;
-            if (!VerifyGoogleIdToken(idToken, claims, &err))
+            bool retry = false;
+            if (!VerifyGoogleIdToken(idToken, claims, &err, &retry))
             {
-                res.status = 401;
+                res.status = retry ? 503 : 401;
+                if (retry) res.set_header("Retry-After", "1");
                 res.set_content((json{{"status","error"},{"message",err}}).dump(), "application/json");
                 return;
             }
 
             // Create your own session token
-            const std::string token = MakeToken();
             Session s;
             s.sub= claims.sub;
             s.userName = claims.eMail;
@@ -498,16 +317,21 @@ void RegisterAuthRoutes(httplib::Server& server)
 
  
             s.expiresAt = std::chrono::system_clock::now() + std::chrono::hours(24 * kSessionDays);
-            {
-                std::lock_guard<std::mutex> lk(g_sessionsMutex);
-                g_sessions[token] = s;
+            // signed: the token is the session, nothing to store
+            std::string token;
+            if (g_tokenSigner.Enabled()) {
+                token = g_tokenSigner.Issue(s);
+            } else {
+                token = MakeToken();
+                g_sessionStore.Put(token, s);
             }
 
             // we notify main.cpp to load the characters for this user if needed
+            bool charactersReady = true;
             if (g_postLoginHook)
             {
-                // non-fatal: login should still succeed even if DB is slow
-                (void)g_postLoginHook(s);
+                // non-blocking: login returns at once, the prefetch finishes in the background
+                charactersReady = g_postLoginHook(s);
 
                 // IMPORTANT: if the hook modifies session fields (e.g. charactersLoaded),
                 // persist them here: I DO NOT DO THAT atm
@@ -522,7 +346,8 @@ void RegisterAuthRoutes(httplib::Server& server)
                 {"name", claims.name},
                 {"playerName", s.playerName},
                 {"picture", claims.picture},
-                {"expiresDays", kSessionDays}
+                {"expiresDays", kSessionDays},
+                {"charactersLoading", !charactersReady}
             };
 
             res.status = 200;
@@ -536,49 +361,28 @@ void RegisterAuthRoutes(httplib::Server& server)
     });
 
     // Logout (invalidate your token)
-    server.Post("/logout", [](const httplib::Request& req, httplib::Response& res){
-        AddCorsHeadersAuth(res);
-
-        const std::string token = GetBearerToken(req);
+    server.Post("/logout", [](const httplib::Request&, httplib::Response& res){
+        const std::string& token = CurrentRequest().token;
         if (token.empty())
         {
-            res.status = 401;
-            res.set_content(R"({"status":"error","message":"Missing Bearer token"})", "application/json");
+            SendError(res, 401, HttpError::MissingToken);
             return;
         }
 
-        {
-            std::lock_guard<std::mutex> lk(g_sessionsMutex);
-            g_sessions.erase(token);
-        }
+        RemoveSession(token);
 
         res.status = 200;
         res.set_content(R"({"status":"ok"})", "application/json");
     });
 
     // Debug helper (who am I)
-    server.Get("/me", [](const httplib::Request& req, httplib::Response& res){
-     AddCorsHeadersAuth(res);
-
-        const std::string token = GetBearerToken(req);
-        if (token.empty()) { 
-            res.status = 401;
-            res.set_content(R"({"status":"error","message":"Missing Bearer token"})", "application/json");
-            return;
-         }
-
-        std::lock_guard<std::mutex> lk(g_sessionsMutex);
-        auto it = g_sessions.find(token);
-        if (it == g_sessions.end()) {
-            res.status = 401;
-            res.set_content(R"({"status":"error","message":"Invalid session"})", "application/json");
-            return;
-        }
+    server.Get("/me", [](const httplib::Request&, httplib::Response& res){
+        const SessionPtr& s = CurrentRequest().session;
         res.status = 200;
         res.set_content((json{
             {"status","ok"},
-            {"userName", it->second.userName},
-            {"playerName", it->second.playerName}
+            {"userName", s->userName},
+            {"playerName", s->playerName}
         }).dump(), "application/json");
     });
 }
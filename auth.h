@@ -6,8 +6,9 @@
 
 struct Session;
 
-// Called after a session was created/updated successfully.
-// Return false to indicate "non-fatal init failed" (optional).
+// Called after a session was created/updated successfully. Must not block
+// (no DB access): return false while the post-login init (character
+// prefetch) still runs in the background; login reports charactersLoading.
 using PostLoginHook = std::function<bool(Session&)>;
 
 void SetPostLoginHook(PostLoginHook hook);
@@ -16,7 +17,7 @@ void SetPostLoginHook(PostLoginHook hook);
 // Register /auth/google, /logout, /me
 void RegisterAuthRoutes(httplib::Server& server);
 
-// CORS helper (includes Authorization header)
+// CORS helper (includes Authorization header); RequestPipeline sets it on every response
 void AddCorsHeadersAuth(httplib::Response& res);
 
 // Extract "Bearer <token>" from Authorization header
@@ -24,10 +25,3 @@ std::string GetBearerToken(const httplib::Request& req);
 
 // Validate your own session token (returned by /auth/google)
 bool ValidateSessionToken(const std::string& token, std::string& outUserName);
-
-// used in main to get infos from token ?
-bool GetSessionFromRequest(
-    const httplib::Request& req,
-    Session& outSession,
-    std::string* outErr = nullptr); 
-
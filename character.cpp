@@ -1,12 +1,14 @@
 #include "character.h"
+#include "CharacterCache.h"
+#include "CharacterCheckpointer.h"
+#include "ProgressJournal.h"
 #include <map>
 #include <memory>
 #include <mutex>
 #include <random>
 #include <iostream>
 
-std::unordered_map<std::string, std::vector<Character>> g_charsByUser;
-std::mutex g_charsMutex;
+CharacterCache g_charCache;
 
 
 std::string NowIsoUtc()
@@ -58,71 +60,45 @@ json CharacterToJson(const Character& ch)
     };
 }
 
-// Find character by id for a user; returns nullptr if not found.
-Character* FindCharacterLocked(std::vector<Character>& vec, const std::string& characterId)
+json CharacterToListJson(const Character& ch)
 {
-    for (auto& c : vec)
-        if (c.characterId == characterId)
-            return &c;
-    return nullptr;
+    return json{
+        {"characterId",   ch.characterId},
+        {"characterName", ch.characterName},
+        {"class",         ch.characterClass},
+        {"level",         ch.level},
+        {"xp",            ch.xp},
+        {"credits",       ch.credits},
+        {"potions",       ch.potions},
+        {"avatarKey",        ch.avatar},
+        {"createdAt",     ch.createdAtIso}
+    };
 }
 
-json SerializeSelectedCharacterLockedForUser(const std::string userKey, const std::string& selectedCharacterId)
+json SerializeSelectedCharacterForUser(const std::string& userKey, const std::string& selectedCharacterId)
 {
-    auto it = g_charsByUser.find(userKey);
-    if (it == g_charsByUser.end())
+    auto ch = g_charCache.FindCharacter(userKey, selectedCharacterId);
+    if (!ch)
         return "";
 
-    const auto& vec = it->second;
-    for (const auto& ch : vec)
-    {
-        if (ch.characterId==selectedCharacterId)
-        return json{
-            {"characterId",   ch.characterId},
-            {"characterName", ch.characterName},
-            {"class",         ch.characterClass},
-            {"level",         ch.level},
-            {"xp",            ch.xp},
-            {"credits",       ch.credits},
-            {"potions",       ch.potions},
-            {"createdAt",     ch.createdAtIso}
-        };
-    }
-
-    return "";
+    return json{
+        {"characterId",   ch->characterId},
+        {"characterName", ch->characterName},
+        {"class",         ch->characterClass},
+        {"level",         ch->level},
+        {"xp",            ch->xp},
+        {"credits",       ch->credits},
+        {"potions",       ch->potions},
+        {"createdAt",     ch->createdAtIso}
+    };
 }
 
 json SerializeCharactersForUser(const std::string& userKey)
 {
-    std::lock_guard<std::mutex> lock(g_charsMutex);
-    return SerializeCharactersLockedForUser(userKey);
-}
-
-json SerializeCharactersLockedForUser(const std::string& userKey)
-{
-    json arr = json::array();
-
-    auto it = g_charsByUser.find(userKey);
-    if (it == g_charsByUser.end())
-        return arr;
-
-    const auto& vec = it->second;
-    for (const auto& ch : vec)
-    {
-        arr.push_back(json{
-            {"characterId",   ch.characterId},
-            {"characterName", ch.characterName},
-            {"class",         ch.characterClass},
-            {"level",         ch.level},
-            {"xp",            ch.xp},
-            {"credits",       ch.credits},
-            {"potions",       ch.potions},
-            {"avatarKey",        ch.avatar},
-            {"createdAt",     ch.createdAtIso}
-        });
-    }
-
-    return arr;
+    auto body = g_charCache.CharactersBody(userKey);
+    if (!body)
+        return json::array();
+    return json::parse(*body);
 }
 
 
@@ -153,14 +129,15 @@ static std::string MakeTestId(const std::string& prefix, int n)
 void DebugDumpCharacters(const std::string& lookupUser,
                          const std::string& lookupCharacterId)
 {
-    std::lock_guard<std::mutex> lock(g_charsMutex);
+    const CharacterCacheStats stats = g_charCache.GetStats();
 
-    std::cout << "\n===== DEBUG DUMP g_charsByUser =====\n";
-    std::cout << "Map size: " << g_charsByUser.size() << "\n";
+    std::cout << "\n===== DEBUG DUMP g_charCache =====\n";
+    std::cout << "Users: " << stats.users << "  bytes~" << stats.bytes
+              << "  dirty users: " << stats.dirtyUsers << "\n";
     std::cout << "Looking up user key: [" << lookupUser << "]\n";
     std::cout << "Looking up characterId: [" << lookupCharacterId << "]\n\n";
 
-    for (const auto& [user, vec] : g_charsByUser)
+    g_charCache.ForEachUser([](const std::string& user, const std::vector<Character>& vec)
     {
         std::cout << "USER KEY: [" << user << "]  characters=" << vec.size() << "\n";
 
@@ -173,7 +150,7 @@ void DebugDumpCharacters(const std::string& lookupUser,
                 << " level=" << ch.level
                 << "\n";
         }
-    }
+    });
 
     std::cout << "===== END DEBUG DUMP =====\n\n";
 }
@@ -183,34 +160,24 @@ void CacheApplyRewards(const std::string& userEmail,
                        const std::string& characterId,
                        int addXp, int addCredits, int addPotions)
 {
-    std::lock_guard<std::mutex> lock(g_charsMutex);
-    auto it = g_charsByUser.find(userEmail);
-    if (it == g_charsByUser.end()) return;
-    auto* ch = FindCharacterLocked(it->second, characterId);
-    if (!ch) return;
-
-    ch->xp += addXp;
-    ch->credits += addCredits;
-    ch->potions += addPotions;
-    ch->dirty = true;
-    // set dirtySinceMs...
+    if (!g_charCache.ApplyRewards(userEmail, characterId, addXp, addCredits, addPotions)) return;
+    if (auto ch = g_charCache.FindCharacter(userEmail, characterId))
+        g_progressJournal.Append(ch->characterId, ch->level, ch->xp, ch->credits, ch->potions, ch->highestWave);
+    g_checkpointer.NotifyDirty();
 }
 
-
-std::vector<DirtyToSave> CollectDirtyCharacters()
+bool CacheRecordProgress(const std::string& userEmail,
+                         const std::string& characterId,
+                         int level, int xp, int credits, int potions, int highestWave)
 {
-    std::vector<DirtyToSave> out;
-    std::lock_guard<std::mutex> lock(g_charsMutex);
+    if (!g_charCache.RecordProgress(userEmail, characterId, level, xp, credits, potions, highestWave))
+        return false;
+    g_checkpointer.NotifyDirty();
+    return true;
+}
 
-    for (auto& [email, vec] : g_charsByUser)
-    {
-        for (auto& ch : vec)
-        {
-            if (!ch.dirty) continue;
-            ch.dirty = false;
 
-            out.push_back({email, ch.characterId, ch.level, ch.xp, ch.credits, ch.potions});
-        }
-    }
-    return out;
+std::vector<DirtyToSave> CollectDirtyCharacters()
+{
+    return g_charCache.CollectDirty();
 }
@@ -6,13 +6,18 @@
 using json = nlohmann::json;
 
 
-struct DirtyToSave { std::string email; std::string characterId; int level,xp,credits,potions; };
+struct DirtyToSave { std::string email; std::string characterId; int level,xp,credits,potions,highestWave; };
 std::vector<DirtyToSave> CollectDirtyCharacters();
 
 
 void CacheApplyRewards(const std::string& userEmail,
                        const std::string& characterId,
                        int addXp, int addCredits, int addPotions);
+// in-game progress of a player's character; false if the user is not cached
+// (the caller then saves directly)
+bool CacheRecordProgress(const std::string& userEmail,
+                         const std::string& characterId,
+                         int level, int xp, int credits, int potions, int highestWave);
 
 // ===================== CHARACTER DATA (in-memory) =====================
 // Replace this later with DB persistence.
@@ -30,23 +35,19 @@ struct Character
     int highestWave= 0;
     std::string createdAtIso;   // optional
     bool dirty= false;
-    uint64_t dirtySinceMs = 0; // or time_point
+    uint64_t dirtySinceMs = 0; // CharacterCache::NowMs() when it became dirty
 };
-// userName -> characters
-extern std::unordered_map<std::string, std::vector<Character>> g_charsByUser;
-extern std::mutex g_charsMutex;
+// userName -> characters: see CharacterCache (g_charCache)
 
 std::string NowIsoUtc();
 
 // simple id generator; if you already have GenerateUUID() use that
 std::string GenerateCharacterId();
 json CharacterToJson(const Character& ch);
+// one element of the /characters array
+json CharacterToListJson(const Character& ch);
 
-// Find character by id for a user; returns nullptr if not found.
-Character* FindCharacterLocked(std::vector<Character>& vec, const std::string& characterId);
-
-json SerializeSelectedCharacterLockedForUser(const std::string userKey, const std::string& selectedCharacterId);
-json SerializeCharactersLockedForUser(const std::string& userKey);
+json SerializeSelectedCharacterForUser(const std::string& userKey, const std::string& selectedCharacterId);
 json SerializeCharactersForUser(const std::string& userKey);
 
 void SeedTestCharacters();
@@ -80,6 +80,37 @@ void Combatant::Revive()
     AvatarId=MobClass;
 }
 
+void Combatant::ResetForReuse()
+{
+    Type = ECombatantType::Mob;
+    Lane = 0;
+    Slot = 0;
+    PosX = -1.f;
+    PosY = -1.f;
+    Active = true;
+    DamageModifier = 0.f;
+    DefenseModifier = 0.f;
+    CurrentField = 0.f;
+    HPPercentage = 100.f;
+    EnergyPercentage = 100.f;
+    ManaPercentage = 100.f;
+    SpellManaMin = SPELLCOST;
+    MeleeManaMin = MELEECOST;
+    PotionAmount = INITIALPOTIONS;
+    MezzCounter = 0;
+    BurnedCounter = 0;
+    ExplodeCounter = 6;
+    StayInGameCounter = 1;
+    Conditions.clear();
+    Level = 0;
+    XP = 0;
+    Credits = 0;
+    InstanceId.clear();
+    TemplateId.clear();
+    OwnerKey.clear();
+    LastActive = std::chrono::steady_clock::now();
+}
+
 bool Combatant::IsAlive() const
 {
     return HP > 0.f;
@@ -148,9 +179,15 @@ std::string Combatant::GetName() const
 
 void Combatant::MobAttack(CombatantPtr target)
 {
-    if(!IsAlive())return;
-    if(MezzCounter>0)return;
-    if(AttackType==ECombatantAttackType::Bomb) return;
+    const float dmg = ComputeMobAttackDamage(*target);
+    if (dmg > 0.f) target->ApplyDamage(dmg);
+}
+
+float Combatant::ComputeMobAttackDamage(const Combatant& target)
+{
+    if(!IsAlive())return 0.f;
+    if(MezzCounter>0)return 0.f;
+    if(AttackType==ECombatantAttackType::Bomb) return 0.f;
     float dmg= 0.f;
     float nearRangeDmg;
 
@@ -158,9 +195,10 @@ void Combatant::MobAttack(CombatantPtr target)
     // dmg + if the mob is near to the last lane
     nearRangeDmg= static_cast<float>(Lane/MAX_LANES)*dmg;
     dmg += nearRangeDmg;
-    dmg-= target->GetCurrentDefense();
-    target->ApplyDamage(dmg);
+    dmg-= target.GetCurrentDefense();
     if(DARA_DEBUG_COMBAT)DaraLog("COMBAT", GetName()+ " Lane: "+std::to_string(Lane)+" NearRngDmg: "+std::to_string(nearRangeDmg) +" attacks with: "+std::to_string(dmg));
+    // a hit the defense fully absorbs does nothing (it used to heal the target)
+    return std::max(dmg, 0.f);
 }
 void Combatant::PlayerAttack(CombatantPtr target)
 {
@@ -464,8 +502,8 @@ bool Combatant::ShouldAttack()
 
 
 void Combatant::InitFromMobTemplate(
-    const std::string& mobClass,
-    const std::string& avatarId,
+    std::string_view mobClass,
+    std::string_view avatarId,
     ECombatantAttackType attackType,
     ECombatantDifficulty difficulty,
     float speed,
@@ -476,8 +514,8 @@ void Combatant::InitFromMobTemplate(
     int baseDefense
 )
 {
-    MobClass = mobClass;
-    AvatarId = avatarId;
+    MobClass.assign(mobClass);
+    AvatarId.assign(avatarId);
     AttackType = attackType;
     Difficulty = difficulty;
 
@@ -707,6 +745,14 @@ bool Combatant::ShouldExplode()
 void Combatant::Explode(CombatantPtr target)
 {
     if(AttackType!=ECombatantAttackType::Bomb) return;
+    const float dmg = ComputeExplosionDamage(*target);
+    if (dmg > 0.f) target->ApplyDamage(dmg);
+    HP=0;
+}
+
+float Combatant::ComputeExplosionDamage(const Combatant& target)
+{
+    if(AttackType!=ECombatantAttackType::Bomb) return 0.f;
     float dmg= 0.f;
     float nearRangeDmg;
 
@@ -714,11 +760,10 @@ void Combatant::Explode(CombatantPtr target)
     // dmg + if the mob is near to the last lane
     nearRangeDmg= static_cast<float>(Lane/MAX_LANES)*dmg;
     dmg += nearRangeDmg;
-    dmg-= target->GetCurrentDefense();
-    target->ApplyDamage(dmg);
+    dmg-= target.GetCurrentDefense();
     // if(DARA_DEBUG_COMBAT) 
     DaraLog("BOMB", "Explosion "+GetName()+ " Lane: "+std::to_string(Lane)+" NearRngDmg: "+std::to_string(nearRangeDmg) +" attacks with: "+std::to_string(dmg));
-    HP=0;
+    return std::max(dmg, 0.f);
 }
 
 
@@ -4,6 +4,7 @@
 #include <vector>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <random>
 #include <unordered_set>
 #include <chrono>
@@ -216,6 +217,7 @@ protected:
 
     std::string InstanceId="";
     std::string TemplateId="";
+    std::string OwnerKey="";   // players: character cache key (email) of the owning user
 
 
     ECombatantType Type = ECombatantType::Mob;
@@ -243,8 +245,8 @@ public:
                 std::string mobClass="MSAgent-Soldorn", int lane=0, int slot=0);
     Combatant();
     void InitFromMobTemplate(
-        const std::string& mobClass,
-        const std::string& avatarId,
+        std::string_view mobClass,
+        std::string_view avatarId,
         ECombatantAttackType attackType,
         ECombatantDifficulty difficulty,
         float speed,
@@ -255,11 +257,15 @@ public:
         int baseDefense
     );
     void Revive();
+    // back to a freshly constructed mob (keeps Id and string capacity), used by MobPool
+    void ResetForReuse();
 
     bool IsAlive() const;
     std::string GetId(){return Id;}
     void InitId(std::string id){Id=id;}
-    void InitName(std::string name){Name=name;}
+    void InitOwnerKey(std::string_view key){OwnerKey.assign(key);}
+    const std::string& GetOwnerKey() const {return OwnerKey;}
+    void InitName(std::string_view name){Name.assign(name);}
     void InitPlayerType(){AttackType= ECombatantAttackType::Combi;}
     void InitXP(int xp){XP=xp;}
     void InitLevel(int level);
@@ -318,6 +324,7 @@ public:
     bool ShouldExplode();
     void TriggerExplode(){ExplodeCounter=0;};
     void Explode(CombatantPtr target);
+    void MarkExploded(){HP=0.f;}
     void DefuseBomb();
 
     bool IsMezzed() const {return MezzCounter>0;}
@@ -327,6 +334,10 @@ public:
     void DebugShort();
 
     void MobAttack(CombatantPtr target);
+    // damage this mob would deal to target (>= 0), nothing is applied yet;
+    // CombatDirector sums these per target and applies them in one pass
+    float ComputeMobAttackDamage(const Combatant& target);
+    float ComputeExplosionDamage(const Combatant& target);
     float AttackMelee(CombatantPtr target);
     float AttackFireball(CombatantPtr target);
     float AttackShoot(CombatantPtr target);
@@ -349,9 +360,9 @@ public:
     float GetEnergyPct() const;
     json ToJson() const;
 
-    void SetInstanceId(std::string instId){InstanceId= instId;}
+    void SetInstanceId(std::string_view instId){InstanceId.assign(instId);}
     std::string GetInstanceId()const {return InstanceId;}
-    void SetTemplateId(std::string templateId){TemplateId= templateId;}
+    void SetTemplateId(std::string_view templateId){TemplateId.assign(templateId);}
     std::string GetTemplateId()const {return TemplateId;}
 
 };
@@ -1,6 +1,7 @@
 #include <thread>
 #include <condition_variable>
 #include <chrono>
+#include <unordered_set>
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -18,6 +19,19 @@
 #include "character.h"
 #include "CharacterRepository.h"
 #include "CharacterDbWorker.h"
+#include "DbConnectionPool.h"
+#include "LeaderboardService.h"
+#include "CharacterCache.h"
+#include "CharacterCheckpointer.h"
+#include "ProgressJournal.h"
+#include "CacheWarmup.h"
+#include "SessionSweeper.h"
+#include "SessionSnapshot.h"
+#include "GoogleKeyCache.h"
+#include "SessionToken.h"
+#include "RequestPipeline.h"
+#include "MySqlCharacterStore.h"
+#include "LocalCharacterStore.h"
 #include "ServerOptions.h"
 
 
@@ -28,17 +42,18 @@ CombatDirector* g_combatDirector = nullptr;
 MobTemplateStore g_mobTemplates;
 
 CharacterDbWorker g_dbWorker;
+DbConnectionPool g_dbPool;
+LeaderboardService g_leaderboard;
+CharacterCheckpointer g_checkpointer;
+ProgressJournal g_progressJournal;
+std::unique_ptr<ICharacterStore> g_characterStore;
+CacheWarmup g_warmup;
+SessionSweeper g_sessionSweeper;
+GoogleKeyCache g_googleKeys;
 
 void TrimHistory(std::vector<json>& hist);
 
 
-auto AddCorsHeaders = [](httplib::Response& res)
-{
-    res.set_header("Access-Control-Allow-Origin", "*");
-    res.set_header("Access-Control-Allow-Headers", "Content-Type, Authorization");
-    res.set_header("Access-Control-Allow-Methods", "GET, POST, OPTIONS");
-};
-
 static std::unordered_map<std::string, std::shared_ptr<GameState>> g_stateByGameId;
 static std::mutex g_stateMapMutex;
 
@@ -54,21 +69,42 @@ std::string Narrative= "Some cool story that I have here ..";
 extern CharacterDbWorker g_dbWorker;
 
 // Post login some actions can be done
-// here we load the cache with the available characters
+// here we prefetch the characters into the cache. Never waits for the DB:
+// the load runs on the DB worker and the client polls /characters until it
+// stops answering charactersLoading (cheap 304s meanwhile, see ETag below).
 static bool PostLoginInit(Session& s)
 {
     // If you key character cache by email:
     if (s.eMail.empty()) return true;
+    if (HasCharactersCachedForUser(s.eMail)) return true;
 
-    bool isDone = g_dbWorker.LoadUserBlocking(s.eMail, 800); // 800ms cap
-    isDone= true; 
-    return isDone; // never block login
+    g_dbWorker.RequestLoadUser(s.eMail);
+    return false; // still loading
+}
+
+// conditional GET: true if the client already has this representation
+static bool ClientHasETag(const httplib::Request& req, const std::string& etag)
+{
+    const std::string inm = req.get_header_value("If-None-Match");
+    return !inm.empty() && (inm == "*" || inm.find(etag) != std::string::npos);
 }
 
+static const std::string kCharactersLoadingETag = "\"characters-loading\"";
+// cache versions restart with the process: the start time keeps old ETags from matching
+static const std::string kCharactersETagPrefix = "\"c-"
+    + std::to_string(std::chrono::system_clock::now().time_since_epoch().count()) + "-";
+
 void InitializeMobStore()
 {
     std::string err;
     std::string filePath= (std::string)DARA_MOB_STORE;
+
+    // watch even if the first load fails, so a fixed file is picked up without restart
+    if (g_options.mobReloadSeconds > 0) {
+        g_mobTemplates.StartWatching(filePath, std::chrono::seconds(g_options.mobReloadSeconds));
+        DaraLog("FILE", "Watching "+filePath+" for changes every "+std::to_string(g_options.mobReloadSeconds)+"s");
+    }
+
     if(!g_mobTemplates.LoadFromFile(filePath, &err)) {
         DaraLog("FILE", "Loading mob templates from "+filePath);
         std::cerr << "Mob template load failed: " << err << "\n";
@@ -76,8 +112,9 @@ void InitializeMobStore()
         DaraLog("ERROR", "Error description: "+ err);
         return;
     }
-    DaraLog("FILE", "Loaded mob templates");
-
+    const MobTemplateStore::SnapshotPtr templates = g_mobTemplates.Acquire();
+    DaraLog("FILE", "Loaded "+std::to_string(templates->Size())+" mob templates"
+        +(templates->IsMapped() ? " from image "+MobTemplateStore::ImagePathFor(filePath) : ""));
 }
 /* NOT USED ATM but very handy
 static std::string GeneratePlayerName()
@@ -105,7 +142,7 @@ std::string NewPlayer(const std::string& userName,
 {
     //std::string playerName = GeneratePlayerName(displayName);
     // Your join logic:
-    g_combatDirector->AddOrUpdatePlayer(displayName, character);
+    g_combatDirector->AddOrUpdatePlayer(displayName, character, userName);
 
     DaraLog("LOGIN", "Created character :" + displayName + " for "+ userName + " Avatar: "+character.avatar);
 
@@ -418,52 +455,110 @@ std::string readPromptFromFile(const std::string& filename) {
 
 void LogoutByToken(const std::string& token)
 {
-    Session s;
-    if (!TryGetSession(token, s)) {
+    SessionPtr s = FindSession(token);
+    if (!s) {
         return;
     }
 
-    DaraLog("LOGOUT",s.playerName);
+    DaraLog("LOGOUT",s->playerName);
     // IMPORTANT: Remove player by playerName (because you added playerName to CombatDirector)
-    if (!s.playerName.empty()) {
-        g_combatDirector->RemovePlayer(s.playerName);
+    if (!s->playerName.empty()) {
+        g_combatDirector->RemovePlayer(s->playerName);
     }
 
     RemoveSession(token);
 }
 
+// session-expired hook: the player leaves the game like on logout, unless a
+// newer session (re-login) still has the same character selected
+void OnSessionExpired(const std::string&, const SessionPtr& s)
+{
+    if (s->playerName.empty() || g_sessionStore.IsPlayerBound(s->playerName)) return;
+
+    DaraLog("SESSION", "Expired: " + s->userName + " " + s->playerName);
+    g_combatDirector->RemovePlayer(s->playerName);
+}
+
+// sessions restored from the snapshot: their players were in the game before
+// the restart, put them back (clients treat "Player not found" as logged out).
+// Characters the warm-up did not cache rejoin on their first /state or /action
+// (EnsurePlayerJoined).
+void RejoinRestoredPlayers()
+{
+    std::unordered_set<std::string> joined;
+    size_t missing = 0;
+    g_sessionStore.ForEach([&](const std::string&, const SessionPtr& s)
+    {
+        if (s->characterId.empty() || s->playerName.empty() || !joined.insert(s->playerName).second) return;
+
+        if (auto c = g_charCache.FindCharacter(s->eMail, s->characterId))
+            NewPlayer(s->eMail, c->characterName, std::move(*c));
+        else
+            missing++;
+    });
+    DaraLog("SESSION", "Rejoined " + std::to_string(joined.size() - missing) + " players of restored sessions"
+        + (missing ? " (" + std::to_string(missing) + " characters not cached, rejoin on request)" : ""));
+}
+
+// the session's player is in the game. Only logout and expiry remove a player,
+// so a missing one with a selected character is a session restored after a
+// restart: it rejoins from the cache, loading the user first if needed.
+// false: res is answered (503 while loading, 401 if the character is gone)
+static bool EnsurePlayerJoined(const RequestContext& ctx, httplib::Response& res)
+{
+    const SessionPtr& s = ctx.session;
+    if (ctx.room->HasPlayer(s->playerName)) return true;
+
+    if (!s->characterId.empty() && !s->playerName.empty())
+    {
+        if (auto c = g_charCache.FindCharacter(s->eMail, s->characterId)) {
+            NewPlayer(s->eMail, c->characterName, std::move(*c));
+            return true;
+        }
+        if (!HasCharactersCachedForUser(s->eMail)) {
+            g_dbWorker.RequestLoadUser(s->eMail);   // joins a load already running
+            res.set_header("Retry-After", std::to_string(DARA_HTTP_RETRY_AFTER_SEC));
+            SendError(res, 503, HttpError::PlayerLoading);
+            return false;
+        }
+    }
+
+    SendError(res, 401, HttpError::PlayerNotFound);
+    return false;
+}
+
 int main(int argc, char* argv[])
 {
     g_combatDirector = new CombatDirector("DefaultGame");
     httplib::Server server;
+    InstallRequestPipeline(server, g_combatDirector);
     RegisterAuthRoutes(server);
-    
-    server.Options("/action",
-        [](const httplib::Request&, httplib::Response& res)
-        {
-            AddCorsHeaders(res);
-            res.status = 204; // No Content (Preflight OK)
-        }
-    );
+
+    // the pipeline resolves the session before these handlers run (CurrentRequest)
+    for (const char* path : { "/action", "/state", "/auth/logout", "/leaderboards", "/characters",
+                              "/characters/select", "/characters/create", "/characters/delete",
+                              "/sessions", "/http" })
+        RequireSession(path);
+
+    // bounded workers; routes that may wait on MySQL cannot take them all (HttpLoadControl)
+    server.new_task_queue = []{ return g_httpLoad.NewTaskQueue(); };
+    server.set_keep_alive_timeout(DARA_HTTP_KEEP_ALIVE_TIMEOUT_SEC);
+    for (const char* path : { "/action", "/state" })
+        g_httpLoad.SetRouteClass(path, ERouteClass::Gameplay);
+    for (const char* path : { "/leaderboards", "/characters/select", "/characters/create", "/characters/delete" })
+        g_httpLoad.SetRouteClass(path, ERouteClass::Slow);
 
 server.Post("/action", [](const httplib::Request& req, httplib::Response& res)
 {
-    AddCorsHeaders(res);
-
-    Session session;
-    std::string serr;
-    if (!GetSessionFromRequest(req, session, &serr)) {
-        res.status = 401;
-        res.set_content((json{{"status","error"},{"message",serr}}).dump(), "application/json");
-        return;
-    }
+    const RequestContext& ctx = CurrentRequest();
+    const SessionPtr& session = ctx.session;
 
-    const std::string& characterName = session.characterName;
+    const std::string& characterName = session->characterName;
     if (characterName.empty()) {
-        res.status = 400;
-        res.set_content(R"({"status":"error","message":"Session has no playerName"})", "application/json");
+        SendError(res, 400, HttpError::NoCharacter);
         return;
     }
+    if (!EnsurePlayerJoined(ctx, res)) return;
 
     auto body = json::parse(req.body);
 
@@ -477,12 +572,12 @@ server.Post("/action", [](const httplib::Request& req, httplib::Response& res)
     std::string err;
 
 
-    if(g_combatDirector->GetPhase()==EGamePhase::GameOverPause){
+    if(ctx.room->GetPhase()==EGamePhase::GameOverPause){
         res.status = 200;
         res.set_content((json{{"status","ok"},{"characterName",characterName}}).dump(), "application/json");
         return;
     }
-    bool ok = g_combatDirector->SubmitPlayerAction(characterName, actionId, actionTarget, actionMsg, &err);
+    bool ok = ctx.room->SubmitPlayerAction(characterName, actionId, actionTarget, actionMsg, &err);
 
     if (!ok || !err.empty()) {
         res.status = 400;
@@ -495,36 +590,20 @@ server.Post("/action", [](const httplib::Request& req, httplib::Response& res)
 });
 
 
-server.Get("/state", [](const httplib::Request& req, httplib::Response& res)
+server.Get("/state", [](const httplib::Request&, httplib::Response& res)
 {
-    AddCorsHeaders(res);
     res.status = 200;
 
-    Session session;
-    std::string err;
-    if (!GetSessionFromRequest(req, session, &err)) {
-        res.status = 401;
-        res.set_content(
-            (json{{"status","error"},{"message",err}}).dump(),
-            "application/json"
-        );
-        return;
-    }
+    const RequestContext& ctx = CurrentRequest();
+    const SessionPtr& session = ctx.session;
     // DAS ist jetzt deine Player-Identität
-    const std::string& characterId = session.characterId;
-    const std::string& characterName = session.characterName;
+    const std::string& characterId = session->characterId;
+    const std::string& characterName = session->characterName;
     
-    if(!g_combatDirector->HasPlayer(session.playerName)){
-        res.status = 401;
-        res.set_content(
-            (json{{"status","error"},{"message","Player not found"}}).dump(),
-            "application/json"
-        );
-        return;
-}
+    if (!EnsurePlayerJoined(ctx, res)) return;
 
     
-    json out = g_combatDirector->GetUIStateSnapshotJsonLocked(characterId, characterName);
+    json out = ctx.room->GetUIStateSnapshotJsonLocked(characterId, characterName);
     if(DARA_DEBUG_MOBSTATS) std::cout << "GetUIStateSnapshotJsonLocked: " << out["mobs"].dump(2) <<std::endl;
     if(DARA_DEBUG_PLAYERSTATS) std::cout << "GetUIStateSnapshotJsonLocked: " << out["party"].dump(2) <<std::endl;
     if(DARA_DEBUG_FULLSTATE || g_options.showFullState) std::cout << "/state reply: " << out.dump(2) <<std::endl;
@@ -536,33 +615,16 @@ server.Get("/state", [](const httplib::Request& req, httplib::Response& res)
 
 });
 
-server.Options("/auth/logout", [](const httplib::Request&, httplib::Response& res){
-    AddCorsHeadersAuth(res);
-    res.status = 204;
-});
-
-server.Post("/auth/logout", [](const httplib::Request& req, httplib::Response& res){
-    AddCorsHeadersAuth(res);
+server.Post("/auth/logout", [](const httplib::Request&, httplib::Response& res){
+    const RequestContext& ctx = CurrentRequest();
+    const SessionPtr& s = ctx.session;
 
-    const std::string token = GetBearerToken(req); // use the helper from auth.h/auth.cpp
-    if (token.empty()) {
-        res.status = 401;
-        res.set_content(R"({"status":"error","message":"Missing Authorization Bearer token"})", "application/json");
-        return;
-    }
-
-    Session s;
-    if (!TryGetSession(token, s)) {
-        res.status = 401;
-        res.set_content(R"({"status":"error","message":"Invalid or expired session"})", "application/json");
-        return;
-    }
-    DaraLog("LOGOUT", s.userName+" "+s.playerName);
-    if (!s.playerName.empty()) {
-        g_combatDirector->RemovePlayer(s.playerName);
+    DaraLog("LOGOUT", s->userName+" "+s->playerName);
+    if (!s->playerName.empty()) {
+        ctx.room->RemovePlayer(s->playerName);
     }
 
-    RemoveSession(token);
+    RemoveSession(ctx.token);
 
     res.status = 200;
     res.set_content(R"({"status":"ok"})", "application/json");
@@ -572,7 +634,6 @@ server.Get("/story", [](const httplib::Request& req, httplib::Response& res)
 {
     //ATTENTION REMOVE NEXT LINE WHEN IMPLEMENTING THIS!
     (void)req;
-    AddCorsHeaders(res);
     res.status = 200;
     
     /*
@@ -593,7 +654,6 @@ server.Get("/combatlog", [](const httplib::Request& req, httplib::Response& res)
 {
     //ATTENTION REMOVE NEXT LINE WHEN IMPLEMENTING THIS!
     (void)req;
-    AddCorsHeaders(res);
     res.status = 204;
 
     json out= g_combatDirector->GetCombatState();
@@ -629,64 +689,12 @@ server.Get("/combatlog", [](const httplib::Request& req, httplib::Response& res)
  
 });
 
-server.Options("/register", [](const httplib::Request&, httplib::Response& res){
-    AddCorsHeadersAuth(res);
-    res.status = 204;
-});
-server.Options("/login", [](const httplib::Request&, httplib::Response& res){
-    AddCorsHeadersAuth(res);
-    res.status = 204;
-});
-server.Options("/logout", [](const httplib::Request&, httplib::Response& res){
-    AddCorsHeadersAuth(res);
-    res.status = 204;
-});
-server.Options("/me", [](const httplib::Request&, httplib::Response& res){
-    AddCorsHeadersAuth(res);
-    res.status = 204;
-});
-server.Options("/characters", [](const httplib::Request&, httplib::Response& res){
-    AddCorsHeadersAuth(res);
-    res.status = 204;
-});
-
-server.Options("/characters/create", [](const httplib::Request&, httplib::Response& res){
-    AddCorsHeadersAuth(res);
-    res.status = 204;
-});
-server.Options("/characters/select", [](const httplib::Request&, httplib::Response& res){
-    AddCorsHeadersAuth(res);
-    res.status = 204;
-});
-server.Options("/characters/me", [](const httplib::Request&, httplib::Response& res){
-    AddCorsHeadersAuth(res);
-    res.status = 204;
-});
-server.Options("/characters/delete", [](const httplib::Request&, httplib::Response& res){
-    AddCorsHeadersAuth(res);
-    res.status = 204;
-});
-
-// IMPORTANT: use ONE consistent path. Pick "/leaderboards".
-server.Options("/leaderboards", [](const httplib::Request&, httplib::Response& res){
-    AddCorsHeadersAuth(res);
-    res.status = 204;
-});
-
-server.Get("/leaderboards", [](const httplib::Request& req, httplib::Response& res)
+server.Get("/leaderboards", [](const httplib::Request&, httplib::Response& res)
 {
-    AddCorsHeadersAuth(res);
-
-    Session session;
-    std::string err;
-    if (!GetSessionFromRequest(req, session, &err)) {
-        res.status = 401;
-        res.set_content((json{{"status","error"},{"message",err}}).dump(), "application/json");
-        return;
-    }
+    const SessionPtr& session = CurrentRequest().session;
 
     int status=200;
-    json result= GetLeaderBoardsJson(session.eMail, status);
+    json result= GetLeaderBoardsJson(session->eMail, status);
 
     if(status!=200){
         DaraLog("LEADERBOARDS", "Error: "+result.dump(2));
@@ -702,70 +710,140 @@ server.Get("/leaderboards", [](const httplib::Request& req, httplib::Response& r
 
 }); // end leaderboards
 
-server.Get("/characters", [](const httplib::Request& req, httplib::Response& res)
+// readiness (load balancers, deploy scripts): 503 until the startup warm-up finished
+server.Get("/ready", [](const httplib::Request&, httplib::Response& res)
 {
-    AddCorsHeadersAuth(res);
+    const bool ready = g_warmup.IsReady();
+    const CacheWarmupStats s = g_warmup.GetStats();
 
-    Session session;
-    std::string err;
-    if (!GetSessionFromRequest(req, session, &err)) {
-        res.status = 401;
-        res.set_content((json{{"status","error"},{"message",err}}).dump(), "application/json");
-        return;
-    }
+    json out;
+    out["ready"]        = ready;
+    out["users"]        = s.users;
+    out["characters"]   = s.characters;
+    out["leaderboards"] = s.leaderboardsLoaded;
+    out["warmupMs"]     = s.ms;
+    out["googleKeys"]   = g_googleKeys.GetStats().keys;   // 0: logins answer 503 until loaded
+
+    res.status = ready ? 200 : 503;
+    if (!ready) res.set_header("Retry-After", "1");
+    res.set_content(out.dump(), "application/json");
+});
 
-    // session.eMail = userKey (email or google sub)
-    const std::string userKey = session.eMail;
+// session counts (monitoring; signed-in callers only, the server listens on 0.0.0.0)
+server.Get("/sessions", [](const httplib::Request&, httplib::Response& res)
+{
+    const SessionStoreStats s = g_sessionStore.GetStats();
 
     json out;
-    out["status"] = "ok";
-    if (!HasCharactersCachedForUser(userKey)) {
-        g_dbWorker.RequestLoadUser(userKey);
-        out["charactersLoading"] = true;
-        out["characters"] = json::array();
-        out["isPremium"] = true;
-    } else {
-        out["charactersLoading"] = false;
-        out["characters"] = SerializeCharactersForUser(userKey);
-        if(DARA_DEBUG_FULLSTATE) std::cout<< out["characters"].dump(2);
-    }
+    out["live"]    = s.live;
+    out["expired"] = s.expired;
+    out["indexed"] = s.indexed;
 
-    res.status = 200;
     res.set_content(out.dump(), "application/json");
 });
 
-server.Post("/characters/select", [](const httplib::Request& req, httplib::Response& res)
+// worker pool and per-class latency (monitoring; signed-in callers only)
+server.Get("/http", [](const httplib::Request&, httplib::Response& res)
 {
-    AddCorsHeadersAuth(res);
+    const HttpLoadStats s = g_httpLoad.GetStats();
+    auto perClass = [](const HttpRouteClassStats& c)
+    {
+        json j;
+        j["requests"] = c.requests;
+        j["avgMs"]    = c.avgMs;
+        j["maxMs"]    = c.maxMs;
+        return j;
+    };
+
+    json out;
+    out["threads"]             = s.threads;
+    out["busy"]                = s.busy;
+    out["queued"]              = s.queued;
+    out["queuedPeak"]          = s.queuedPeak;
+    out["connections"]         = s.connections;
+    out["overflowConnections"] = s.overflowConnections;
+    out["rejectedConnections"] = s.rejectedConnections;
+    out["avgQueueWaitMs"]      = s.avgQueueWaitMs;
+    out["maxQueueWaitMs"]      = s.maxQueueWaitMs;
+    out["slowActive"]          = s.slowActive;
+    out["slowWaiting"]         = s.slowWaiting;
+    out["shed"]                = s.shed;
+    out["gameplay"]            = perClass(s.gameplay);
+    out["slow"]                = perClass(s.slow);
+    out["other"]               = perClass(s.other);
+
+    res.set_content(out.dump(), "application/json");
+});
+
+server.Get("/characters", [](const httplib::Request& req, httplib::Response& res)
+{
+    const SessionPtr& session = CurrentRequest().session;
 
-    const std::string token = GetBearerToken(req);
-    if (token.empty()) {
-        res.status = 401;
-        res.set_content(R"({"status":"error","message":"Missing Authorization Bearer token"})", "application/json");
+    // session->eMail = userKey (email or google sub)
+    const std::string userKey = session->eMail;
+
+    // clients poll this while the login prefetch runs: revalidate every time
+    res.set_header("Cache-Control", "no-cache");
+
+    uint64_t version = 0;
+    auto characters = g_charCache.CharactersBody(userKey, &version);
+    if (!characters) {
+        g_dbWorker.RequestLoadUser(userKey);   // joins the login prefetch if still running
+        res.set_header("ETag", kCharactersLoadingETag);
+        if (ClientHasETag(req, kCharactersLoadingETag)) {
+            res.status = 304;
+            return;
+        }
+        json out;
+        out["status"] = "ok";
+        out["charactersLoading"] = true;
+        out["retryAfterMs"] = DARA_CHARACTERS_POLL_MS;
+        out["characters"] = json::array();
+        out["isPremium"] = true;
+
+        res.status = 200;
+        res.set_content(out.dump(), "application/json");
         return;
     }
 
-    Session session;
-    if (!TryGetSession(token, session)) {
-        res.status = 401;
-        res.set_content(R"({"status":"error","message":"Invalid or expired session"})", "application/json");
+    // the cache version changes with every modification of this user's characters
+    const std::string etag = kCharactersETagPrefix + std::to_string(version) + "\"";
+    res.set_header("ETag", etag);
+    if (ClientHasETag(req, etag)) {
+        res.status = 304;
         return;
     }
+    if(DARA_DEBUG_FULLSTATE) std::cout<< *characters << std::endl;
+
+    // the array is serialized once per version by the cache
+    std::string body;
+    body.reserve(characters->size() + 64);
+    body += R"({"characters":)";
+    body += *characters;
+    body += R"(,"charactersLoading":false,"status":"ok"})";
+
+    res.status = 200;
+    res.set_content(body, "application/json");
+});
+
+server.Post("/characters/select", [](const httplib::Request& req, httplib::Response& res)
+{
+    const RequestContext& ctx = CurrentRequest();
+    const SessionPtr& session = ctx.session;
 
     json body;
     try { body = json::parse(req.body); }
     catch (...) {
-        res.status = 400;
-        res.set_content(R"({"status":"error","message":"Invalid JSON body"})", "application/json");
+        SendError(res, 400, HttpError::InvalidJson);
         return;
     }
 
     //cached access of usermails characters
     // Ensure characters are cached for this user (key = email)
-    if (!HasCharactersCachedForUser(session.eMail))
+    if (!HasCharactersCachedForUser(session->eMail))
     {
         // async request to load from DB; client can retry shortly
-        g_dbWorker.RequestLoadUser(session.eMail);
+        g_dbWorker.RequestLoadUser(session->eMail);
 
         json out;
         out["status"] = "loading";
@@ -788,49 +866,43 @@ server.Post("/characters/select", [](const httplib::Request& req, httplib::Respo
         res.set_content(R"({"status":"error","message":"characterId is required"})", "application/json");
         return;
     }else{
-        DaraLog("LOGIN", session.userName+" has chosen characterId:"+characterId);
-        DaraLog("LOGIN", "Session.sub:"+session.sub);
-        DaraLog("LOGIN", "Session.userName:"+session.userName);
-        DaraLog("LOGIN", "Session.eMail:"+session.eMail);
-        DaraLog("LOGIN", "Session.name:"+session.name);
+        DaraLog("LOGIN", session->userName+" has chosen characterId:"+characterId);
+        DaraLog("LOGIN", "Session.sub:"+session->sub);
+        DaraLog("LOGIN", "Session.userName:"+session->userName);
+        DaraLog("LOGIN", "Session.eMail:"+session->eMail);
+        DaraLog("LOGIN", "Session.name:"+session->name);
     }
 
     Character chosen;
     bool found = false;
     
-    {
-        std::lock_guard<std::mutex> lock(g_charsMutex);
-        auto it = g_charsByUser.find(session.eMail);
-        if (it != g_charsByUser.end()) {
-            auto& vec = it->second;
-            Character* c = FindCharacterLocked(vec, characterId);
-            if (c) { 
-                chosen = *c; 
-                found = true; 
-            }
-        }
+    if (auto c = g_charCache.FindCharacter(session->eMail, characterId)) {
+        chosen = std::move(*c);
+        found = true;
     }
 
     if (!found) {
         res.status = 404;
         res.set_content(R"({"status":"error","message":"Character not found"})", "application/json");
-        DaraLog("ALARM", "Possible hacker trying to get character from other user ? Character: "+characterId+" User: "+session.eMail);
+        DaraLog("ALARM", "Possible hacker trying to get character from other user ? Character: "+characterId+" User: "+session->eMail);
         return;
     }
 
 
-    // IMPORTANT: you must update your session store for this token.
-    UpdateSessionByToken(token, session);
-    SetSessionCharacter(token, chosen.characterId, chosen.characterName);
+    // IMPORTANT: you must update your session store for this token (copy-on-write,
+    // so writing back the whole session read above could undo a concurrent update)
+    std::string reissued;   // signed tokens carry the selection, the client switches to the new one
+    SetSessionCharacter(ctx.token, chosen.characterId, chosen.characterName, &reissued);
 
     // Now that a character is selected, you can join combat as that character:
-    NewPlayer(session.userName, chosen.characterName, chosen);
+    NewPlayer(session->eMail, chosen.characterName, chosen);
 
     json out;
     out["status"] = "ok";
     out["selectedCharacterId"] = chosen.characterId;
     out["characterName"]= chosen.characterName;
-    out["character"] = SerializeSelectedCharacterLockedForUser(session.eMail, chosen.characterId);
+    out["character"] = SerializeSelectedCharacterForUser(session->eMail, chosen.characterId);
+    if (!reissued.empty()) out["token"] = reissued;
 
 
     res.status = 200;
@@ -839,31 +911,17 @@ server.Post("/characters/select", [](const httplib::Request& req, httplib::Respo
 
 server.Post("/characters/create", [](const httplib::Request& req, httplib::Response& res)
 {
-    AddCorsHeadersAuth(res);
-
-    const std::string token = GetBearerToken(req);
-    if (token.empty()) {
-        res.status = 401;
-        res.set_content(R"({"status":"error","message":"Missing Authorization Bearer token"})", "application/json");
-        return;
-    }
-
-    Session session;
-    if (!TryGetSession(token, session)) {
-        res.status = 401;
-        res.set_content(R"({"status":"error","message":"Invalid or expired session"})", "application/json");
-        return;
-    }
+    const RequestContext& ctx = CurrentRequest();
+    const SessionPtr& session = ctx.session;
 
     json body;
     try { body = json::parse(req.body); }
     catch (...) {
-        res.status = 400;
-        res.set_content(R"({"status":"error","message":"Invalid JSON body"})", "application/json");
+        SendError(res, 400, HttpError::InvalidJson);
         return;
     }
 
-    DaraLog("CREATECHAR", "eMail "+ session.eMail+ " Response.body="+body.dump(2));
+    DaraLog("CREATECHAR", "eMail "+ session->eMail+ " Response.body="+body.dump(2));
 
     // Validate request fields
     const std::string charactername  = body.value("characterName", "unknown");
@@ -874,9 +932,9 @@ server.Post("/characters/create", [](const httplib::Request& req, httplib::Respo
         throw std::runtime_error("Missing characterName or characterClass");
 
     // DB write (safe here: character screen, not in match tick)
-    auto created= CreateCharacterForUserAndCache(session.userName, session.eMail, charactername, characterclass, characteravatar);
+    auto created= CreateCharacterForUserAndCache(session->userName, session->eMail, charactername, characterclass, characteravatar);
     if (created) {
-            DaraLog("CREATECHAR", "Created successfully: eMail"+ session.eMail+ "CharacterName:"+charactername+" New Id:"+created->characterId);
+            DaraLog("CREATECHAR", "Created successfully: eMail"+ session->eMail+ "CharacterName:"+charactername+" New Id:"+created->characterId);
             // you can immediately return created->characterId to the client if you want
             json out;
             out["ok"] = true;
@@ -903,27 +961,13 @@ server.Post("/characters/create", [](const httplib::Request& req, httplib::Respo
 
 server.Post("/characters/delete", [](const httplib::Request& req, httplib::Response& res)
 {
-    AddCorsHeadersAuth(res);
-
-    const std::string token = GetBearerToken(req);
-    if (token.empty()) {
-        res.status = 401;
-        res.set_content(R"({"status":"error","message":"Missing Authorization Bearer token"})", "application/json");
-        return;
-    }
-
-    Session session;
-    if (!TryGetSession(token, session)) {
-        res.status = 401;
-        res.set_content(R"({"status":"error","message":"Invalid or expired session"})", "application/json");
-        return;
-    }
+    const RequestContext& ctx = CurrentRequest();
+    const SessionPtr& session = ctx.session;
 
     json body;
     try { body = json::parse(req.body); }
     catch (...) {
-        res.status = 400;
-        res.set_content(R"({"status":"error","message":"Invalid JSON body"})", "application/json");
+        SendError(res, 400, HttpError::InvalidJson);
         return;
     }
 
@@ -935,20 +979,14 @@ server.Post("/characters/delete", [](const httplib::Request& req, httplib::Respo
     }
 
     // IMPORTANT: pick the SAME key you used on CreateCharacter / cache.
-    // If your DB column UserId contains session.userName, use that here too.
-    const std::string userKey = session.userName;   // or session.userId (but be consistent!)
+    // If your DB column UserId contains session->userName, use that here too.
+    const std::string userKey = session->userName;   // or session->userId (but be consistent!)
 
-    DaraLog("DELETECHAR", "Requested by eMail: " + session.eMail);
+    DaraLog("DELETECHAR", "Requested by eMail: " + session->eMail);
     DaraLog("DELETECHAR", "UserKey: " + userKey + " CharacterId: " + characterId);
 
     bool deleted = RemoveCharacter(userKey, characterId);
-    {
-        std::lock_guard<std::mutex> lock(g_charsMutex);
-        auto& vec = g_charsByUser[userKey];
-        vec.erase(std::remove_if(vec.begin(), vec.end(),
-            [&](const Character& c){ return c.characterId == characterId; }),
-            vec.end());
-    }
+    g_charCache.RemoveCharacter(userKey, characterId);
 
     json out;
     out["ok"] = deleted;
@@ -960,15 +998,77 @@ server.Post("/characters/delete", [](const httplib::Request& req, httplib::Respo
 
     g_options = ParseCommandLine(argc, argv);
 
+    if (g_options.signedSessions) {
+        const char* keys = std::getenv("DARA_SESSION_KEYS");
+        std::string kerr;
+        if (!g_tokenSigner.Configure(keys ? keys : "", &kerr)) {
+            DaraLog("ERROR", "--signed-sessions: " + kerr);
+            return 1;
+        }
+        DaraLog("SESSION", "Issuing signed session tokens");
+    }
+
+    // Google signing keys, fetched in the background: the first login needs them
+    g_googleKeys.Start();
+
+    if (g_options.noPersistence) {
+        auto local = std::make_unique<LocalCharacterStore>();
+        std::string serr;
+        if (!local->Open(g_options.storeFile, &serr)) {
+            DaraLog("ERROR", "Cannot open the embedded character store: " + serr);
+            return 1;
+        }
+        g_characterStore = std::move(local);
+    } else {
+        g_characterStore = std::make_unique<MySqlCharacterStore>();
+    }
+    DaraLog("STORE", std::string("Characters are stored in ") + g_characterStore->Name());
+
+    // progress the DB did not confirm before the last shutdown/crash
+    std::string jerr;
+    if (g_progressJournal.Open((std::string)DARA_JOURNAL_PATH, &jerr)) {
+        for (const CharacterSave& s : g_progressJournal.Pending())
+            g_dbWorker.RequestSaveCharacter(std::to_string(s.characterId), s.level, s.xp, s.credits, s.potions, s.highestWave);
+        g_progressJournal.Start();
+    } else {
+        DaraLog("ERROR", "Progress journal disabled: " + jerr);
+    }
+
+    // leaderboards + recently active users, while the rest starts up
+    g_warmup.Start();
+
+    // sessions of the last run: players keep their tokens across the restart
+    size_t restored = 0;
+    std::string snapErr;
+    const std::string snapshotPath = (std::string)DARA_SESSION_SNAPSHOT_PATH;
+    if (LoadSessionSnapshot(snapshotPath, &restored, &snapErr))
+        DaraLog("SESSION", "Restored " + std::to_string(restored) + " sessions from " + snapshotPath);
+    else
+        DaraLog("ERROR", "Session snapshot not loaded: " + snapErr);
+    g_sessionSweeper.SetSnapshotPath(snapshotPath);
+
     SetPostLoginHook(PostLoginInit);
+    SetSessionExpiredHook(OnSessionExpired);
     InitializeMobStore();
     g_combatDirector->Start();
     g_dbWorker.Start();
+    g_checkpointer.Start();
+    g_sessionSweeper.Start();
 
     InitialActions();
+    if (!g_warmup.WaitFor(DARA_WARMUP_WAIT_MS))
+        DaraLog("WARMUP", "Still running, accepting requests meanwhile (see /ready)");
+    if (restored) RejoinRestoredPlayers();
     DaraLog("SERVER", "REST API on http://0.0.0.0:"+ std::to_string(g_options.port)+"  e.g. /action");
     server.listen("0.0.0.0", g_options.port);
 
+    g_warmup.Join();
+    g_sessionSweeper.Stop();   // its hook checkpoints leaving players
+    g_googleKeys.Stop();
+    g_checkpointer.Stop();   // final checkpoint goes to the worker, which flushes it on Stop
     g_dbWorker.Stop();
+    g_progressJournal.Stop();   // after the worker's last flush marked its rows saved
+    g_dbPool.Shutdown();
+    g_mobTemplates.StopWatching();
 
 }
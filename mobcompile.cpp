@@ -0,0 +1,47 @@
+// mobcompile: compiles mobs/mobdb.json into the binary template image the
+// server mmaps at startup (see MobTemplateImage.h).
+//
+//   mobcompile [in.json] [out.bin]
+//
+// Defaults to DARA_MOB_STORE and the .bin next to it. Re-run it after editing
+// the json; the server falls back to the json while the image is older.
+#include <iostream>
+#include <string>
+
+#include "MobTemplateStore.h"
+#include "ServerOptions.h"
+#include "DaraConfig.h"
+
+// combatant.cpp reads the server options, the defaults are fine here
+ServerOptions g_options;
+
+int main(int argc, char** argv)
+{
+    if (argc > 3 || (argc > 1 && (std::string(argv[1]) == "--help" || std::string(argv[1]) == "-h"))) {
+        std::cout << "Usage: " << argv[0] << " [in.json] [out.bin]\n"
+                  << "  default in:  " << DARA_MOB_STORE << "\n"
+                  << "  default out: " << MobTemplateStore::ImagePathFor(std::string(DARA_MOB_STORE)) << "\n";
+        return argc > 3 ? 1 : 0;
+    }
+
+    const std::string jsonPath  = argc > 1 ? argv[1] : std::string(DARA_MOB_STORE);
+    const std::string imagePath = argc > 2 ? argv[2] : MobTemplateStore::ImagePathFor(jsonPath);
+
+    std::string err;
+    if (!MobTemplateStore::CompileJsonToImage(jsonPath, imagePath, &err)) {
+        std::cerr << "mobcompile failed: " << err << "\n";
+        return 1;
+    }
+
+    // map the file just written and check it the same way the server does
+    size_t templates = 0;
+    if (!MobTemplateStore::CheckImage(imagePath, &templates, &err)) {
+        std::cerr << "mobcompile: written image does not load: " << err << "\n";
+        return 1;
+    }
+
+    std::cout << "Compiled " << templates << " mob templates: " << jsonPath << " -> " << imagePath << "\n";
+    if (imagePath != MobTemplateStore::ImagePathFor(jsonPath))
+        std::cout << "Note: the server maps " << MobTemplateStore::ImagePathFor(jsonPath) << ", not this file\n";
+    return 0;
+}
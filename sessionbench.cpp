@@ -0,0 +1,184 @@
+// Session store contention benchmark: reader threads look sessions up while
+// writer threads select characters (Update) and log in (Put), once against the
+// sharded copy-on-write SessionStore and once against the single mutex + copy
+// map it replaced. Run it on a machine with many cores, e.g.
+//   sessionbench [threads=64] [writers=4] [lookupsPerReader=200000] [sessions=10000]
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <functional>
+#include <chrono>
+#include <cstdlib>
+#include "sessions.h"
+
+namespace
+{
+    // what sessions.cpp did before the SessionStore: one mutex, Sessions copied out
+    class GlobalMutexSessions
+    {
+    public:
+        void Put(const std::string& token, Session s)
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            sessions_[token] = std::move(s);
+        }
+        bool TryGet(const std::string& token, Session& out)
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            auto it = sessions_.find(token);
+            if (it == sessions_.end()) return false;
+            out = it->second;
+            return true;
+        }
+        bool Update(const std::string& token, const std::function<void(Session&)>& fn)
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            auto it = sessions_.find(token);
+            if (it == sessions_.end()) return false;
+            fn(it->second);
+            return true;
+        }
+
+    private:
+        std::mutex mtx_;
+        std::unordered_map<std::string, Session> sessions_;
+    };
+
+    struct Config
+    {
+        int threads = 64;
+        int writers = 4;
+        int lookups = 200000;   // per reader
+        int sessions = 10000;
+    };
+
+    struct Result
+    {
+        double seconds = 0.0;
+        uint64_t writes = 0;
+    };
+
+    std::string Token(int i) { return "token-" + std::to_string(i) + "-0123456789abcdef0123456789abcdef"; }
+
+    Session MakeSession(int i)
+    {
+        Session s;
+        s.sub = "1098765432109876543210";
+        s.eMail = "user" + std::to_string(i) + "@example.com";
+        s.userName = s.eMail;
+        s.name = "Player Number " + std::to_string(i);
+        s.characterId = std::to_string(1000 + i);
+        s.characterName = "Character" + std::to_string(i);
+        s.playerName = s.characterName;
+        s.expiresAt = std::chrono::system_clock::now() + std::chrono::hours(1);
+        return s;
+    }
+
+    // readers: `lookups` lookups each; writers: Update / Put until the readers finish
+    template <class Lookup, class Write>
+    Result Run(const Config& cfg, Lookup lookup, Write write)
+    {
+        const int readers = cfg.threads - cfg.writers;
+        std::atomic<int> ready{0};
+        std::atomic<bool> go{false};
+        std::atomic<bool> readersDone{false};
+        std::atomic<uint64_t> writes{0};
+        std::atomic<size_t> sink{0};
+
+        std::vector<std::thread> writerThreads;
+        for (int w = 0; w < cfg.writers; ++w)
+            writerThreads.emplace_back([&, w]
+            {
+                ready++;
+                while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+                uint64_t n = 0;
+                for (int i = w; !readersDone.load(std::memory_order_relaxed); i += cfg.writers, ++n)
+                    write(i % cfg.sessions, n);
+                writes += n;
+            });
+
+        std::vector<std::thread> readerThreads;
+        for (int r = 0; r < readers; ++r)
+            readerThreads.emplace_back([&, r]
+            {
+                ready++;
+                while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+                size_t bytes = 0;
+                for (int i = 0; i < cfg.lookups; ++i)
+                    bytes += lookup((r * 7919 + i * 31) % cfg.sessions);
+                sink += bytes;
+            });
+
+        while (ready.load() < cfg.threads) std::this_thread::yield();
+        const auto t0 = std::chrono::steady_clock::now();
+        go.store(true, std::memory_order_release);
+        for (auto& t : readerThreads) t.join();
+        const auto t1 = std::chrono::steady_clock::now();
+        readersDone = true;
+        for (auto& t : writerThreads) t.join();
+
+        if (sink.load() == 0) std::cerr << "no session found\n";
+        return { std::chrono::duration<double>(t1 - t0).count(), writes.load() };
+    }
+
+    void Print(const char* name, const Config& cfg, const Result& r)
+    {
+        const double lookups = double(cfg.threads - cfg.writers) * cfg.lookups;
+        std::cout << std::left << std::setw(28) << name << std::right << std::fixed
+                  << std::setprecision(3) << r.seconds << " s  "
+                  << std::setprecision(2) << std::setw(8) << lookups / r.seconds / 1e6 << " M lookups/s  "
+                  << std::setw(10) << r.writes << " writes\n";
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Config cfg;
+    if (argc > 1) cfg.threads  = std::atoi(argv[1]);
+    if (argc > 2) cfg.writers  = std::atoi(argv[2]);
+    if (argc > 3) cfg.lookups  = std::atoi(argv[3]);
+    if (argc > 4) cfg.sessions = std::atoi(argv[4]);
+    if (cfg.threads < 1 || cfg.writers < 0 || cfg.writers >= cfg.threads || cfg.lookups < 1 || cfg.sessions < 1) {
+        std::cerr << "usage: sessionbench [threads>0] [writers<threads] [lookupsPerReader>0] [sessions>0]\n";
+        return 1;
+    }
+
+    std::vector<std::string> tokens;
+    tokens.reserve(cfg.sessions);
+    GlobalMutexSessions baseline;
+    SessionStore store;
+    for (int i = 0; i < cfg.sessions; ++i) {
+        tokens.push_back(Token(i));
+        baseline.Put(tokens.back(), MakeSession(i));
+        store.Put(tokens.back(), MakeSession(i));
+    }
+
+    std::cout << cfg.threads << " threads (" << cfg.writers << " writing), " << cfg.lookups
+              << " lookups per reader, " << cfg.sessions << " sessions, "
+              << std::thread::hardware_concurrency() << " hardware threads\n";
+
+    // every 8th write is a re-login (Put), the rest select a character (Update)
+    const Result before = Run(cfg,
+        [&](int i){ Session s; return baseline.TryGet(tokens[i], s) ? s.eMail.size() : 0; },
+        [&](int i, uint64_t n){
+            if (n % 8 == 0) baseline.Put(tokens[i], MakeSession(i));
+            else baseline.Update(tokens[i], [&](Session& s){ s.characterId = std::to_string(n); });
+        });
+    Print("global mutex + copy", cfg, before);
+
+    const Result after = Run(cfg,
+        [&](int i){ SessionPtr s = store.Find(tokens[i]); return s ? s->eMail.size() : 0; },
+        [&](int i, uint64_t n){
+            if (n % 8 == 0) store.Put(tokens[i], MakeSession(i));
+            else store.Update(tokens[i], [&](Session& s){ s.characterId = std::to_string(n); });
+        });
+    Print("SessionStore (sharded COW)", cfg, after);
+
+    std::cout << "speedup " << std::setprecision(2) << before.seconds / after.seconds << "x\n";
+    return 0;
+}
@@ -1,20 +1,241 @@
 #include "sessions.h"
+#include "SessionToken.h"
 #include <functional>
+#include <algorithm>
+#include <utility>
 
-std::unordered_map<std::string, Session> g_sessions;
-std::mutex g_sessionsMutex;
+SessionStore g_sessionStore;
+
+// -------------------------------
+// SessionStore
+// -------------------------------
+SessionStore::SessionStore(size_t shards)
+{
+    shards_.reserve(std::max<size_t>(shards, 1));
+    for (size_t i = 0; i < std::max<size_t>(shards, 1); ++i)
+        shards_.push_back(std::make_unique<Shard>());
+}
+
+SessionStore::Shard& SessionStore::ShardFor(const std::string& token) const
+{
+    return *shards_[std::hash<std::string>{}(token) % shards_.size()];
+}
+
+SessionPtr SessionStore::Find(const std::string& token) const
+{
+    const Shard& shard = ShardFor(token);
+    std::shared_lock<std::shared_mutex> lk(shard.mtx);
+    auto it = shard.sessions.find(token);
+    return it == shard.sessions.end() ? nullptr : it->second;
+}
+
+void SessionStore::Put(const std::string& token, Session s)
+{
+    auto session = std::make_shared<const Session>(std::move(s));
+    Shard& shard = ShardFor(token);
+    SessionPtr old;   // released outside the lock
+    std::unique_lock<std::shared_mutex> lk(shard.mtx);
+    SessionPtr& slot = shard.sessions[token];
+    old = std::move(slot);
+    RebindLocked(old ? old->playerName : std::string(), session->playerName);
+    IndexLocked(shard, token, session->expiresAt);
+    slot = std::move(session);
+    version_.fetch_add(1, std::memory_order_release);
+}
+
+bool SessionStore::Update(const std::string& token, const std::function<void(Session&)>& fn)
+{
+    Shard& shard = ShardFor(token);
+    SessionPtr old;
+    std::unique_lock<std::shared_mutex> lk(shard.mtx);
+    auto it = shard.sessions.find(token);
+    if (it == shard.sessions.end()) return false;
+    auto patched = std::make_shared<Session>(*it->second);
+    fn(*patched);
+    if (patched->expiresAt != it->second->expiresAt)
+        IndexLocked(shard, token, patched->expiresAt);
+    RebindLocked(it->second->playerName, patched->playerName);
+    old = std::exchange(it->second, std::move(patched));
+    version_.fetch_add(1, std::memory_order_release);
+    return true;
+}
+
+bool SessionStore::Remove(const std::string& token)
+{
+    Shard& shard = ShardFor(token);
+    SessionPtr old;
+    std::unique_lock<std::shared_mutex> lk(shard.mtx);
+    auto it = shard.sessions.find(token);
+    if (it == shard.sessions.end()) return false;
+    old = std::move(it->second);
+    shard.sessions.erase(it);
+    RebindLocked(old->playerName, {});
+    version_.fetch_add(1, std::memory_order_release);
+    return true;
+}
+
+bool SessionStore::RemoveExpired(const std::string& token, const SessionPtr& expected)
+{
+    Shard& shard = ShardFor(token);
+    SessionPtr old;
+    std::unique_lock<std::shared_mutex> lk(shard.mtx);
+    auto it = shard.sessions.find(token);
+    if (it == shard.sessions.end() || it->second != expected) return false;
+    old = std::move(it->second);
+    shard.sessions.erase(it);
+    RebindLocked(old->playerName, {});
+    expired_.fetch_add(1, std::memory_order_relaxed);
+    version_.fetch_add(1, std::memory_order_release);
+    return true;
+}
+
+void SessionStore::IndexLocked(Shard& shard, const std::string& token,
+                               std::chrono::system_clock::time_point at)
+{
+    shard.expiry.push_back({ at, token });
+    std::push_heap(shard.expiry.begin(), shard.expiry.end(), std::greater<>{});
+
+    // mostly logged-out/re-put leftovers: rebuild from the live sessions
+    if (shard.expiry.size() > 2 * shard.sessions.size() + 64)
+    {
+        shard.expiry.clear();
+        // `token`'s slot is not written yet (empty in Put, the old session in Update)
+        for (const auto& [t, s] : shard.sessions)
+            shard.expiry.push_back({ t == token ? at : s->expiresAt, t });
+        std::make_heap(shard.expiry.begin(), shard.expiry.end(), std::greater<>{});
+    }
+}
+
+size_t SessionStore::SweepExpired(std::chrono::system_clock::time_point now, size_t maxPerShard,
+                                  std::vector<std::pair<std::string, SessionPtr>>& out)
+{
+    const size_t before = out.size();
+    for (auto& shard : shards_)
+    {
+        {
+            // cheap check first: most rounds find nothing due
+            std::shared_lock<std::shared_mutex> lk(shard->mtx);
+            if (shard->expiry.empty() || shard->expiry.front().at > now) continue;
+        }
+
+        std::unique_lock<std::shared_mutex> lk(shard->mtx);
+        auto& heap = shard->expiry;
+        for (size_t n = 0; n < maxPerShard && !heap.empty() && heap.front().at <= now; ++n)
+        {
+            std::pop_heap(heap.begin(), heap.end(), std::greater<>{});
+            ExpiryEntry e = std::move(heap.back());
+            heap.pop_back();
+
+            auto it = shard->sessions.find(e.token);
+            // gone, or re-put/extended since this entry was pushed
+            if (it == shard->sessions.end() || it->second->expiresAt > now) continue;
+
+            out.emplace_back(std::move(e.token), std::move(it->second));
+            shard->sessions.erase(it);
+            RebindLocked(out.back().second->playerName, {});
+        }
+    }
+
+    const size_t removed = out.size() - before;
+    expired_.fetch_add(removed, std::memory_order_relaxed);
+    if (removed) version_.fetch_add(1, std::memory_order_release);
+    return removed;
+}
+
+void SessionStore::RebindLocked(const std::string& from, const std::string& to)
+{
+    if (from == to) return;
+    std::lock_guard<std::mutex> lk(boundMtx_);
+    if (!from.empty()) {
+        auto it = bound_.find(from);
+        if (it != bound_.end() && --it->second == 0) bound_.erase(it);
+    }
+    if (!to.empty()) ++bound_[to];
+}
+
+bool SessionStore::IsPlayerBound(const std::string& playerName) const
+{
+    std::lock_guard<std::mutex> lk(boundMtx_);
+    return bound_.count(playerName) != 0;
+}
+
+void SessionStore::ForEach(const std::function<void(const std::string&, const SessionPtr&)>& fn) const
+{
+    std::vector<std::pair<std::string, SessionPtr>> batch;
+    for (const auto& shard : shards_)
+    {
+        batch.clear();
+        {
+            std::shared_lock<std::shared_mutex> lk(shard->mtx);
+            batch.assign(shard->sessions.begin(), shard->sessions.end());
+        }
+        for (const auto& [token, s] : batch) fn(token, s);
+    }
+}
+
+size_t SessionStore::Size() const
+{
+    size_t n = 0;
+    for (const auto& shard : shards_)
+    {
+        std::shared_lock<std::shared_mutex> lk(shard->mtx);
+        n += shard->sessions.size();
+    }
+    return n;
+}
+
+SessionStoreStats SessionStore::GetStats() const
+{
+    SessionStoreStats st;
+    for (const auto& shard : shards_)
+    {
+        std::shared_lock<std::shared_mutex> lk(shard->mtx);
+        st.live += shard->sessions.size();
+        st.indexed += shard->expiry.size();
+    }
+    st.expired = expired_.load(std::memory_order_relaxed);
+    return st;
+}
+
+// -------------------------------
+// helpers
+// -------------------------------
+SessionPtr FindSession(const std::string& token) {
+  if (SessionTokenSigner::IsSignedToken(token)) return g_tokenSigner.Verify(token);
+  return g_sessionStore.Find(token);
+}
 
 bool TryGetSession(const std::string& token, Session& out) {
-  std::lock_guard<std::mutex> lk(g_sessionsMutex);
-  auto it = g_sessions.find(token);
-  if (it == g_sessions.end()) return false;
-  out = it->second;
+  SessionPtr s = FindSession(token);
+  if (!s) return false;
+  out = *s;
   return true;
 }
 
 void RemoveSession(const std::string& token) {
-  std::lock_guard<std::mutex> lk(g_sessionsMutex);
-  g_sessions.erase(token);
+  if (SessionTokenSigner::IsSignedToken(token)) g_tokenSigner.Revoke(token);
+  else g_sessionStore.Remove(token);
+}
+
+// -------------------------------
+// expiry
+// -------------------------------
+static SessionExpiredHook g_sessionExpiredHook;
+
+void SetSessionExpiredHook(SessionExpiredHook hook)
+{
+  g_sessionExpiredHook = std::move(hook);
+}
+
+void RunSessionExpiredHook(const std::string& token, const SessionPtr& s)
+{
+  if (g_sessionExpiredHook) g_sessionExpiredHook(token, s);
+}
+
+void ExpireSession(const std::string& token, const SessionPtr& s)
+{
+  if (g_sessionStore.RemoveExpired(token, s))
+    RunSessionExpiredHook(token, s);
 }
 
 // -------------------------------
@@ -22,24 +243,16 @@ void RemoveSession(const std::string& token) {
 // -------------------------------
 bool UpdateSessionByToken(const std::string& token, const Session& updated)
 {
-  std::lock_guard<std::mutex> lk(g_sessionsMutex);
-  auto it = g_sessions.find(token);
-  if (it == g_sessions.end()) return false;
-  it->second = updated;
-  return true;
+  return g_sessionStore.Update(token, [&](Session& s){ s = updated; });
 }
 
 // ----------------------------------------
 // NEW: Patch-style update (recommended)
 // ----------------------------------------
-bool PatchSessionByToken(const std::string& token,
-                         const std::function<void(Session&)>& fn)
+bool UpdateSessionByToken(const std::string& token,
+                          const std::function<void(Session&)>& fn)
 {
-  std::lock_guard<std::mutex> lk(g_sessionsMutex);
-  auto it = g_sessions.find(token);
-  if (it == g_sessions.end()) return false;
-  fn(it->second);
-  return true;
+  return g_sessionStore.Update(token, fn);
 }
 
 // ----------------------------------------
@@ -47,9 +260,23 @@ bool PatchSessionByToken(const std::string& token,
 // ----------------------------------------
 bool SetSessionCharacter(const std::string& token,
                          const std::string& characterId,
-                         const std::string& characterName)
+                         const std::string& characterName,
+                         std::string* reissued)
 {
-  return PatchSessionByToken(token, [&](Session& s){
+  if (SessionTokenSigner::IsSignedToken(token)) {
+    SessionTokenLogin login;
+    SessionPtr cur = g_tokenSigner.Verify(token, &login);
+    if (!cur) return false;
+    Session s = *cur;
+    s.characterId = characterId;
+    s.characterName = characterName;
+    s.playerName = characterName;
+    // same login: logging out with either token ends both
+    if (reissued) *reissued = g_tokenSigner.Issue(s, login);
+    return true;
+  }
+
+  return UpdateSessionByToken(token, [&](Session& s){
     s.characterId = characterId;       // you need these fields in Session
     s.characterName = characterName;   // optional but handy for UI
     s.playerName = characterName;      // if your CombatDirector uses playerName as “active character”
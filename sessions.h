@@ -1,9 +1,16 @@
 #pragma once
 #include <string>
+#include <vector>
 #include <unordered_map>
+#include <memory>
 #include <mutex>
+#include <shared_mutex>
+#include <atomic>
 #include <chrono>
 #include <functional>
+#include <utility>
+#include <cstdint>
+#include "DaraConfig.h"
 
 
 // =======================================================
@@ -13,29 +20,118 @@
 struct Session
 {
     std::string characterId;     // currently selected character
-    std::string characterName;   // convenience: cached from character list 
+    std::string characterName;   // convenience: cached from character list
     std::string sub; // should be the id from google
     std::string userName; // use email as identity if you do not use sub.. sub would be better
-    std::string name; 
+    std::string name;
     std::string eMail; // should be the email
     std::string playerName; // use email as identity
     std::chrono::system_clock::time_point expiresAt;
 };
 
-extern std::unordered_map<std::string, Session> g_sessions;
-extern std::mutex g_sessionsMutex;
+// a published Session is never modified: updates publish a new copy
+using SessionPtr = std::shared_ptr<const Session>;
 
-// helpers
-bool TryGetSession(const std::string& token, Session& out);
-void RemoveSession(const std::string& token);
+// DARA_SESSION_SHARDS shards by token hash, each a token -> SessionPtr map
+// behind its own reader/writer lock. Readers hold the shard lock shared just
+// long enough to copy the pointer (no string copies, readers never block each
+// other); writers build a patched copy of the Session and swap the pointer
+// (copy-on-write), so a reader keeps a consistent snapshot for as long as it
+// holds it. Sessions are read on every request, written on login/select/logout.
+// Each shard also keeps a min-heap of (expiresAt, token) next to its map, so
+// SweepExpired finds the expired sessions without scanning; heap entries of
+// removed or re-put sessions are skipped when they come up. A count of
+// sessions per selected player answers IsPlayerBound without a scan.
+struct SessionStoreStats
+{
+    size_t live = 0;       // sessions in the store
+    size_t expired = 0;    // removed because they expired, since start
+    size_t indexed = 0;    // expiry heap entries, including stale ones
+};
+
+class SessionStore
+{
+public:
+    explicit SessionStore(size_t shards = DARA_SESSION_SHARDS);
+
+    SessionStore(const SessionStore&) = delete;
+    SessionStore& operator=(const SessionStore&) = delete;
+
+    SessionPtr Find(const std::string& token) const;
+    void Put(const std::string& token, Session s);
+    // copy-on-write: fn patches a copy which then replaces the session; false if not found
+    bool Update(const std::string& token, const std::function<void(Session&)>& fn);
+    bool Remove(const std::string& token);
+    // expired `expected`: removed only if still stored (a concurrent re-login wins)
+    bool RemoveExpired(const std::string& token, const SessionPtr& expected);
+    // removes up to maxPerShard expired sessions per shard, appended to out
+    size_t SweepExpired(std::chrono::system_clock::time_point now, size_t maxPerShard,
+                        std::vector<std::pair<std::string, SessionPtr>>& out);
+    // some stored session has this player selected
+    bool IsPlayerBound(const std::string& playerName) const;
+    // every session, shard by shard; fn runs outside the shard locks
+    void ForEach(const std::function<void(const std::string& token, const SessionPtr& s)>& fn) const;
+    // bumped on every change (snapshots skip unchanged stores)
+    uint64_t Version() const { return version_.load(std::memory_order_acquire); }
+    size_t Size() const;
+    SessionStoreStats GetStats() const;
+
+private:
+    struct ExpiryEntry
+    {
+        std::chrono::system_clock::time_point at;
+        std::string token;
+        bool operator>(const ExpiryEntry& o) const { return at > o.at; }
+    };
+
+    struct Shard
+    {
+        mutable std::shared_mutex mtx;
+        std::unordered_map<std::string, SessionPtr> sessions;
+        std::vector<ExpiryEntry> expiry;   // min-heap on `at`
+    };
+
+    Shard& ShardFor(const std::string& token) const;
+    // a session's playerName changes from `from` to `to` ("" = none); under its shard's lock
+    void RebindLocked(const std::string& from, const std::string& to);
+    // under the shard's unique lock, before `token`'s slot is replaced: `at` is its new expiry
+    static void IndexLocked(Shard& shard, const std::string& token, std::chrono::system_clock::time_point at);
+
+    std::vector<std::unique_ptr<Shard>> shards_;
+    // playerName -> stored sessions that have it selected; only touched on
+    // writes (login/select/logout/expiry), so one lock is enough
+    mutable std::mutex boundMtx_;
+    std::unordered_map<std::string, size_t> bound_;
+    std::atomic<size_t> expired_{0};
+    std::atomic<uint64_t> version_{0};
+};
+
+// Session expiry: called with every session that expired (swept or noticed on
+// use) once it is out of the store, e.g. to drop its player from the game
+using SessionExpiredHook = std::function<void(const std::string& token, const SessionPtr& session)>;
+void SetSessionExpiredHook(SessionExpiredHook hook);
+// `s` (found under token) is past expiresAt: remove it and run the hook
+void ExpireSession(const std::string& token, const SessionPtr& s);
+// for sessions already removed (SweepExpired)
+void RunSessionExpiredHook(const std::string& token, const SessionPtr& s);
+
+extern SessionStore g_sessionStore;
+
+// helpers; these also resolve signed tokens (SessionToken.h)
+SessionPtr FindSession(const std::string& token);
+bool TryGetSession(const std::string& token, Session& out);   // copies; prefer FindSession
+void RemoveSession(const std::string& token);   // signed token: revoked
 
-// Update the session stored under token. Returns false if token not found.
+// Update the session stored under token. Returns false if token not found
+// (or signed: those change by reissuing, see SetSessionCharacter).
 bool UpdateSessionByToken(const std::string& token, const Session& updated);
 bool UpdateSessionByToken(const std::string& token,
                           const std::function<void(Session&)>& fn);
 
 
-// Convenience: patch only selected character fields (recommended)
+// Convenience: patch only selected character fields (recommended).
+// A signed token cannot change: *reissued gets the token to use from now on
 bool SetSessionCharacter(const std::string& token,
                          const std::string& characterId,
-                         const std::string& characterName);
+                         const std::string& characterName,
+                         std::string* reissued = nullptr);